@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""Decode binary debug output of the traffic lights firmware.
+
+The firmware built with CONFIG_TRAFFIC_LIGHTS_DEBUG_BINARY=y sends every debug
+message as a record of
+
+    marker | argc          one byte, marker 0xD0, argc 0..4
+    format string address  four bytes, little endian
+    time delta             varint, milliseconds since the previous record
+    arguments              argc varints
+
+The format strings themselves never leave the device, they are looked up from
+the ELF file the firmware was built into. Bytes that are not part of a record,
+such as printk output of the other tasks, are passed through as is.
+
+Usage: debug_decode.py build/traffic_lights/zephyr/zephyr.elf < /dev/ttyACM0
+"""
+
+import argparse
+import re
+import sys
+
+from elftools.elf.elffile import ELFFile
+
+MARKER = 0xD0
+MAX_ARGS = 4
+
+# printk conversions, flags and width are kept, length modifiers dropped
+CONVERSION = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(hh|h|ll|l|z|j|t)?([diuxXcsp%])")
+
+
+class Image:
+    """Read-only view of the loadable sections of an ELF file."""
+
+    def __init__(self, path):
+        self.sections = []
+        with open(path, "rb") as f:
+            elf = ELFFile(f)
+            for section in elf.iter_sections():
+                if section["sh_addr"] and section["sh_type"] == "SHT_PROGBITS":
+                    self.sections.append((section["sh_addr"], section.data()))
+
+    def string(self, address):
+        for start, data in self.sections:
+            if start <= address < start + len(data):
+                end = data.index(b"\0", address - start)
+                return data[address - start:end].decode(errors="replace")
+        return None
+
+
+def format_message(image, fmt, args):
+    args = list(args)
+
+    def convert(match):
+        flags, _, kind = match.groups()
+        if kind == "%":
+            return "%"
+        if not args:
+            return match.group(0)
+        value = args.pop(0)
+        if kind == "s":
+            return ("%" + flags + "s") % (image.string(value) or "<0x%08x>" % value)
+        if kind == "p":
+            return "0x%08x" % value
+        if kind in "di" and value & 0x80000000:
+            value -= 1 << 32
+        if kind == "u":
+            kind = "d"
+        return ("%" + flags + kind) % value
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def read_varint(stream):
+    value = 0
+    shift = 0
+    while True:
+        byte = stream.read(1)
+        if not byte:
+            raise EOFError
+        value |= (byte[0] & 0x7F) << shift
+        shift += 7
+        if not byte[0] & 0x80:
+            return value
+
+
+def decode(image, stream, out):
+    timestamp = 0
+    while True:
+        byte = stream.read(1)
+        if not byte:
+            return
+
+        argc = byte[0] - MARKER
+        if not 0 <= argc <= MAX_ARGS:
+            out.write(byte.decode(errors="replace"))
+            continue
+
+        try:
+            address = int.from_bytes(stream.read(4), "little")
+            timestamp += read_varint(stream)
+            args = [read_varint(stream) for _ in range(argc)]
+        except EOFError:
+            return
+
+        fmt = image.string(address)
+        if fmt is None:
+            out.write("[%u] DEBUG: <unknown format 0x%08x> %s\n" % (timestamp, address, args))
+        else:
+            out.write("[%u] DEBUG: %s\n" % (timestamp, format_message(image, fmt, args)))
+        out.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("elf", help="firmware ELF file holding the format strings")
+    parser.add_argument("input", nargs="?", help="captured output or serial device, standard input by default")
+    options = parser.parse_args()
+
+    image = Image(options.elf)
+    stream = open(options.input, "rb", buffering=0) if options.input else sys.stdin.buffer
+
+    try:
+        decode(image, stream, sys.stdout)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,319 @@
+#!/usr/bin/env python3
+"""Client of the binary robot protocol of the traffic lights firmware.
+
+A zero byte switches the firmware from its text command line to the binary
+protocol. Every request and response is then one COBS encoded frame ending
+with a zero byte:
+
+    id | command | len | payload (len bytes) | CRC-16/CCITT-FALSE, little endian
+
+A response carries the id and command of its request with 0x80 set, its
+payload starts with a status byte and a signed 32-bit result. The firmware
+answers in order, so requests are pipelined: up to `window` of them are in
+flight before the first response is read. See src/robolink.h.
+
+Commands given on the command line are sent in one pipelined batch:
+
+    robolink.py /dev/ttyACM0 time 001000 time 245959 sequence "RG1000" stats
+
+To run against native_sim, give the built executable instead of a port. It is
+started and the client attaches to the pseudoterminal of its UART:
+
+    robolink.py --exe build/zephyr/zephyr.exe time 001000
+
+The class can also be used as a Robot Framework library, see
+tests/timeparser.robot in the repository root.
+"""
+
+import argparse
+import binascii
+import re
+import struct
+import subprocess
+import sys
+import time
+
+import serial
+
+PAYLOAD_MAX = 64
+RESPONSE = 0x80
+
+CMD_PING = 0
+CMD_SEQUENCE = 1
+CMD_TIME = 2
+CMD_STATS = 3
+CMD_DEBUG = 4
+CMD_CLOSE = 5
+
+STATUS_OK = 0
+STATUS_UNKNOWN = 1
+STATUS_ERROR = 2
+STATUS_BUSY = 3
+
+STATUS_NAMES = {STATUS_OK: "ok", STATUS_UNKNOWN: "unknown", STATUS_ERROR: "error", STATUS_BUSY: "busy"}
+
+# Counters of CMD_STATS in their order
+STATS = (
+    "red_toggled",
+    "yellow_toggled",
+    "green_toggled",
+    "buttons_pushed",
+    "debug_dropped",
+    "debug_peak_depth",
+    "uart_dropped",
+    "bad_frames",
+)
+
+
+def crc16(data):
+    return binascii.crc_hqx(data, 0xFFFF)
+
+
+def cobs_encode(data):
+    out = bytearray([0])
+    code_at = 0
+    for byte in data:
+        if byte:
+            out.append(byte)
+        if not byte or len(out) - code_at == 0xFF:
+            out[code_at] = len(out) - code_at
+            code_at = len(out)
+            out.append(0)
+    out[code_at] = len(out) - code_at
+    return bytes(out)
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError("bad COBS block")
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def encode_frame(request_id, command, payload=b""):
+    if len(payload) > PAYLOAD_MAX:
+        raise ValueError("payload of %d bytes is longer than %d" % (len(payload), PAYLOAD_MAX))
+    raw = bytes([request_id, command, len(payload)]) + payload
+    raw += struct.pack("<H", crc16(raw))
+    return b"\0" + cobs_encode(raw) + b"\0"
+
+
+def decode_frame(data):
+    """Decode the bytes between two delimiters, returns (id, command, payload) or None if they are not a frame."""
+    try:
+        raw = cobs_decode(data)
+    except ValueError:
+        return None
+    if len(raw) < 5 or raw[2] + 5 != len(raw):
+        return None
+    if struct.unpack("<H", raw[-2:])[0] != crc16(raw[:-2]):
+        return None
+    return raw[0], raw[1], raw[3:-2]
+
+
+class Response:
+    def __init__(self, command, payload):
+        self.command = command & ~RESPONSE
+        self.status = payload[0]
+        self.result = struct.unpack("<i", payload[1:5])[0]
+        self.data = payload[5:]
+
+    @property
+    def ok(self):
+        return self.status == STATUS_OK
+
+    def __repr__(self):
+        return "%s %d%s" % (STATUS_NAMES.get(self.status, str(self.status)), self.result,
+                            " " + self.data.hex() if self.data else "")
+
+
+class RoboLink:
+    """Pipelined client of the binary protocol on a serial port or pseudoterminal."""
+
+    ROBOT_LIBRARY_SCOPE = "SUITE"
+
+    def __init__(self, port, baudrate=115200, timeout=1.0, window=4):
+        self.serial = serial.Serial(port, int(baudrate), timeout=0.05)
+        self.timeout = float(timeout)
+        self.window = int(window)
+        self.next_id = 0
+        self.buffer = bytearray()
+        # Text the firmware printed between frames, like debug messages from before the switch
+        self.text = bytearray()
+        self.open()
+
+    def open(self):
+        """Switch the firmware to the binary protocol and wait until it answers."""
+        self.serial.reset_input_buffer()
+        for _ in range(3):
+            self.serial.write(b"\0")
+            try:
+                if self.ping(b"sync").ok:
+                    return
+            except TimeoutError:
+                pass
+        raise ConnectionError("no answer from the firmware on %s" % self.serial.port)
+
+    def close(self):
+        """Go back to the text command line and close the port."""
+        try:
+            self.request(CMD_CLOSE)
+        finally:
+            self.serial.close()
+
+    def _read_frame(self, deadline):
+        while True:
+            end = self.buffer.find(b"\0")
+            if end >= 0:
+                chunk = bytes(self.buffer[:end])
+                del self.buffer[:end + 1]
+                if not chunk:
+                    continue
+                frame = decode_frame(chunk)
+                if frame is None:
+                    self.text += chunk
+                    continue
+                return frame
+            if time.monotonic() > deadline:
+                raise TimeoutError("no response within %.1f s" % self.timeout)
+            self.buffer += self.serial.read(max(1, self.serial.in_waiting))
+
+    def pipeline(self, requests):
+        """Send (command, payload) requests with at most `window` in flight, returns their responses in order."""
+        pending = {}
+        responses = [None] * len(requests)
+        sent = 0
+
+        while sent < len(requests) or pending:
+            while sent < len(requests) and len(pending) < self.window:
+                command, payload = requests[sent]
+                request_id = self.next_id
+                self.next_id = (self.next_id + 1) & 0xFF
+                pending[request_id] = sent
+                self.serial.write(encode_frame(request_id, command, payload))
+                sent += 1
+
+            request_id, command, payload = self._read_frame(time.monotonic() + self.timeout)
+            index = pending.pop(request_id, None)
+            if index is None or command != requests[index][0] | RESPONSE:
+                # A response to a request that already timed out
+                continue
+            responses[index] = Response(command, payload)
+
+        return responses
+
+    def request(self, command, payload=b""):
+        return self.pipeline([(command, payload)])[0]
+
+    # Keywords
+
+    def ping(self, payload=b""):
+        return self.request(CMD_PING, payload)
+
+    def parse_time(self, text):
+        """Parse a time on the device, returns the seconds or the negative error flags. A time of day given with
+        a leading @ gives its seconds too, see is_time_of_day."""
+        return self.request(CMD_TIME, text.encode()).result
+
+    def is_time_of_day(self, text):
+        """Whether the device parses the time as a time of day rather than a delay."""
+        return struct.unpack("<I", self.request(CMD_TIME, text.encode()).data[:4])[0] == 1
+
+    def parse_times(self, *texts):
+        """Parse many times in one pipelined batch."""
+        return [response.result for response in self.pipeline([(CMD_TIME, t.encode()) for t in texts])]
+
+    def run_sequence(self, text):
+        """Compile and run a light sequence, returns 0 or the negative error flags of the parser."""
+        return self.request(CMD_SEQUENCE, text.encode()).result
+
+    def stats(self):
+        response = self.request(CMD_STATS)
+        values = struct.unpack("<%dI" % (len(response.data) // 4), response.data)
+        return dict(zip(STATS, values))
+
+    def toggle_debug(self):
+        """Toggle the debug messages that show once the text command line is back, returns the new state."""
+        return bool(self.request(CMD_DEBUG).result)
+
+
+def start_native_sim(exe):
+    """Start a native_sim executable and return it with the pseudoterminal of its UART."""
+    process = subprocess.Popen([exe], stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    for line in process.stdout:
+        match = re.search(r"connected to pseudotty: (\S+)", line)
+        if match:
+            return process, match.group(1)
+    raise RuntimeError("%s did not report its UART" % exe)
+
+
+COMMANDS = {
+    "ping": (CMD_PING, True),
+    "sequence": (CMD_SEQUENCE, True),
+    "time": (CMD_TIME, True),
+    "stats": (CMD_STATS, False),
+    "debug": (CMD_DEBUG, False),
+}
+
+
+def parse_commands(words):
+    """Turn command line words into (name, (command, payload)) pairs."""
+    requests = []
+    words = list(words)
+    while words:
+        name = words.pop(0)
+        if name not in COMMANDS:
+            raise SystemExit("unknown command %s, expected one of %s" % (name, ", ".join(COMMANDS)))
+        command, has_argument = COMMANDS[name]
+        if has_argument and not words:
+            raise SystemExit("%s needs an argument" % name)
+        requests.append((name, (command, words.pop(0).encode() if has_argument else b"")))
+    return requests
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port", nargs="?", help="serial port or pseudoterminal of the firmware")
+    parser.add_argument("--exe", help="native_sim executable to start and attach to instead of a port")
+    parser.add_argument("--window", type=int, default=4, help="requests in flight at once")
+    parser.add_argument("--timeout", type=float, default=1.0, help="seconds to wait for a response")
+    parser.add_argument("commands", nargs=argparse.REMAINDER, help="ping TEXT | sequence TEXT | time TEXT | stats | debug")
+    options = parser.parse_args()
+
+    if not options.exe and not options.port:
+        parser.error("give a port or --exe")
+
+    process = None
+    port = options.port
+    commands = options.commands
+    if options.exe:
+        # Without a port the first word is already a command
+        if port is not None:
+            commands = [port] + commands
+        process, port = start_native_sim(options.exe)
+
+    try:
+        link = RoboLink(port, timeout=options.timeout, window=options.window)
+        requests = parse_commands(commands)
+        responses = link.pipeline([request for _, request in requests])
+        for (name, _), response in zip(requests, responses):
+            if name == "stats" and response.ok:
+                values = struct.unpack("<%dI" % (len(response.data) // 4), response.data)
+                print("stats", " ".join("%s=%d" % item for item in zip(STATS, values)))
+            else:
+                print(name, response)
+        link.close()
+    finally:
+        if process is not None:
+            process.terminate()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,197 @@
+/* Alarms of the schedule. They all wait in one min-heap ordered by deadline and a single kernel timer is armed for the
+ * earliest of them. The timer runs in the system clock interrupt: it takes every alarm that is due, runs its action
+ * and arms itself for the next one. The actions only post to the led engine and to the dispatcher, which is safe from
+ * an interrupt.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/timing/timing.h>
+
+#include "alarm.h"
+#include "alarmheap.h"
+#include "ledctl.h"
+#include "dispatcher.h"
+#include "debug.h"
+
+BUILD_ASSERT(CONFIG_TRAFFIC_LIGHTS_ALARMS <= ALARM_HEAP_MAX, "The alarm heap numbers its slots with 16 bits");
+BUILD_ASSERT(CONFIG_TRAFFIC_LIGHTS_STORED_SEQUENCES <= UINT8_MAX, "The sequence number of an alarm is one byte");
+
+static struct alarm_t alarms[CONFIG_TRAFFIC_LIGHTS_ALARMS];
+static uint16_t alarm_order[CONFIG_TRAFFIC_LIGHTS_ALARMS];
+
+// The heap, the stored sequences, the counters and the deadline the timer is armed for are guarded by `alarm_lock`
+static struct alarm_heap_t heap;
+static struct led_control_t stored[CONFIG_TRAFFIC_LIGHTS_STORED_SEQUENCES];
+static struct alarm_stats_t stats;
+static int64_t armed = INT64_MAX;
+static struct k_spinlock alarm_lock;
+
+static void alarm_expired(struct k_timer *timer);
+
+K_TIMER_DEFINE(alarm_timer, alarm_expired, NULL);
+
+// Arm the timer for the earliest alarm if it is not already. Called with the lock held.
+static void arm(void)
+{
+    int64_t next;
+
+    if (!alarm_heap_next(&heap, &next)) {
+        next = INT64_MAX;
+    }
+
+    if (next == armed) {
+        return;
+    }
+
+    armed = next;
+
+    if (next == INT64_MAX) {
+        k_timer_stop(&alarm_timer);
+    } else {
+        k_timer_start(&alarm_timer, K_TIMEOUT_ABS_MS(next), K_NO_WAIT);
+    }
+}
+
+static void run(const struct alarm_t *alarm, const struct led_control_t *seq)
+{
+    switch (alarm->action) {
+        case ALARM_BLINK:
+            ledctl_post(LED_EV_BLINK, CMD_SRC_TIMER, NULL);
+            break;
+
+        case ALARM_AUTO:
+            ledctl_post(LED_EV_RESUME, CMD_SRC_TIMER, NULL);
+            break;
+
+        case ALARM_SEQUENCE:
+            if (seq->len == 0) {
+                debug("No sequence %u stored", alarm->arg);
+            } else if (dispatcher_submit(seq, CMD_SRC_TIMER, timing_counter_get(), K_NO_WAIT) != 0) {
+                debug("Busy, sequence %u of an alarm dropped", alarm->arg);
+            }
+            break;
+    }
+}
+
+static void alarm_expired(struct k_timer *timer)
+{
+    struct alarm_t alarm;
+    struct led_control_t seq;
+
+    while (true) {
+        int64_t now = k_uptime_get();
+        k_spinlock_key_t key = k_spin_lock(&alarm_lock);
+        int32_t id = alarm_heap_pop_due(&heap, now, &alarm);
+
+        if (id < 0) {
+            // The timer stopped when it expired, arm it again even for the same deadline
+            armed = INT64_MAX;
+            arm();
+            k_spin_unlock(&alarm_lock, key);
+            return;
+        }
+
+        uint32_t late_ms = (uint32_t)(now - alarm.deadline);
+
+        stats.dispatched++;
+        stats.late += late_ms > 0;
+        stats.max_late_ms = MAX(stats.max_late_ms, late_ms);
+        stats.total_late_ms += late_ms;
+
+        if (alarm.action == ALARM_SEQUENCE) {
+            seq = stored[alarm.arg];
+        }
+        k_spin_unlock(&alarm_lock, key);
+
+        debug("Alarm %d went off %u ms late", id, late_ms);
+        run(&alarm, &seq);
+    }
+}
+
+int alarm_add(int64_t deadline, enum alarm_action action, uint32_t sequence)
+{
+    if (action >= ALARM_ACTION_COUNT) {
+        return -EINVAL;
+    }
+
+    if (action != ALARM_SEQUENCE) {
+        sequence = 0;
+    } else if (sequence >= CONFIG_TRAFFIC_LIGHTS_STORED_SEQUENCES) {
+        return -EINVAL;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&alarm_lock);
+    int32_t id = alarm_heap_add(&heap, deadline, action, (uint8_t)sequence);
+
+    if (id >= 0) {
+        arm();
+    }
+    k_spin_unlock(&alarm_lock, key);
+
+    return id == ALARM_FULL ? -ENOMEM : id;
+}
+
+int alarm_cancel(int id)
+{
+    k_spinlock_key_t key = k_spin_lock(&alarm_lock);
+    bool found = alarm_heap_cancel(&heap, id);
+
+    if (found) {
+        arm();
+    }
+    k_spin_unlock(&alarm_lock, key);
+
+    return found ? 0 : -ENOENT;
+}
+
+int alarm_store_sequence(uint32_t n, const struct led_control_t *seq)
+{
+    if (n >= CONFIG_TRAFFIC_LIGHTS_STORED_SEQUENCES) {
+        return -EINVAL;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&alarm_lock);
+
+    stored[n] = *seq;
+    k_spin_unlock(&alarm_lock, key);
+
+    return 0;
+}
+
+void alarm_stats_get(struct alarm_stats_t *out)
+{
+    k_spinlock_key_t key = k_spin_lock(&alarm_lock);
+
+    *out = stats;
+    out->pending = heap.count;
+    k_spin_unlock(&alarm_lock, key);
+}
+
+void alarm_stats_reset(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&alarm_lock);
+
+    memset(&stats, 0, sizeof(stats));
+    k_spin_unlock(&alarm_lock, key);
+}
+
+void alarm_print_csv(void)
+{
+    struct alarm_stats_t copy;
+
+    alarm_stats_get(&copy);
+    printk("alarms,%u,%u,%u,%u,%u\n", copy.pending, copy.dispatched, copy.late, copy.max_late_ms,
+        copy.dispatched ? (uint32_t)(copy.total_late_ms / copy.dispatched) : 0);
+}
+
+static int alarm_init(void)
+{
+    alarm_heap_init(&heap, alarms, alarm_order, CONFIG_TRAFFIC_LIGHTS_ALARMS);
+    return 0;
+}
+
+SYS_INIT(alarm_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,50 @@
+#ifndef ALARM_H
+#define ALARM_H
+
+#include <stdint.h>
+
+#include "seqvm.h"
+
+// What an alarm does when it goes off
+enum alarm_action {
+    // Start blinking yellow
+    ALARM_BLINK,
+    // Resume the automatic sequence
+    ALARM_AUTO,
+    // Run a stored sequence, see `alarm_store_sequence`
+    ALARM_SEQUENCE,
+    ALARM_ACTION_COUNT
+};
+
+struct alarm_stats_t {
+    uint32_t pending;
+    uint32_t dispatched;
+    // Alarms that went off later than their deadline, and by how much
+    uint32_t late;
+    uint32_t max_late_ms;
+    uint64_t total_late_ms;
+};
+
+/*
+    Schedule an alarm at `deadline`, in ms of uptime. A deadline that has passed goes off right away. `sequence` is the
+    number of the stored sequence to run, only used by ALARM_SEQUENCE. Returns the id of the alarm, zero or more,
+    -EINVAL for an unknown action or sequence number or -ENOMEM if CONFIG_TRAFFIC_LIGHTS_ALARMS are pending already.
+*/
+int alarm_add(int64_t deadline, enum alarm_action action, uint32_t sequence);
+
+// Cancel a pending alarm. Returns 0 or -ENOENT if there is none with the id.
+int alarm_cancel(int id);
+
+/*
+    Keep a copy of a sequence as number `n` for the alarms to run, in place of the one stored before. The number is
+    below CONFIG_TRAFFIC_LIGHTS_STORED_SEQUENCES. Returns 0 or -EINVAL.
+*/
+int alarm_store_sequence(uint32_t n, const struct led_control_t *seq);
+
+void alarm_stats_get(struct alarm_stats_t *stats);
+void alarm_stats_reset(void);
+
+// Print the alarm counters as one CSV line: alarms,<pending>,<dispatched>,<late>,<max late ms>,<mean late ms>
+void alarm_print_csv(void);
+
+#endif // ALARM_H
@@ -0,0 +1,131 @@
+#include <string.h>
+#include "alarmheap.h"
+
+void alarm_heap_init(struct alarm_heap_t *heap, struct alarm_t *alarms, uint16_t *order, uint32_t capacity) {
+	memset(heap, 0, sizeof(*heap));
+	memset(alarms, 0, capacity * sizeof(*alarms));
+	heap->alarms = alarms;
+	heap->order = order;
+	heap->capacity = capacity;
+	heap->gen_limit = INT32_MAX / capacity;
+
+	for (uint32_t slot = 0; slot < capacity; slot++) {
+		order[slot] = slot;
+		alarms[slot].pos = slot;
+	}
+}
+
+static int32_t id_of(const struct alarm_heap_t *heap, uint16_t slot) {
+	return (int32_t)(heap->alarms[slot].gen * heap->capacity + slot);
+}
+
+// Whether the alarm in slot `a` goes off before the one in slot `b`
+static bool before(const struct alarm_heap_t *heap, uint16_t a, uint16_t b) {
+	const struct alarm_t *x = &heap->alarms[a];
+	const struct alarm_t *y = &heap->alarms[b];
+
+	return x->deadline < y->deadline || (x->deadline == y->deadline && (int32_t)(x->seq - y->seq) < 0);
+}
+
+static void place(struct alarm_heap_t *heap, uint32_t pos, uint16_t slot) {
+	heap->order[pos] = slot;
+	heap->alarms[slot].pos = pos;
+}
+
+static void sift_up(struct alarm_heap_t *heap, uint32_t pos) {
+	uint16_t slot = heap->order[pos];
+
+	while (pos > 0) {
+		uint32_t parent = (pos - 1) / 2;
+
+		if (!before(heap, slot, heap->order[parent])) break;
+		place(heap, pos, heap->order[parent]);
+		pos = parent;
+	}
+
+	place(heap, pos, slot);
+}
+
+static void sift_down(struct alarm_heap_t *heap, uint32_t pos) {
+	uint16_t slot = heap->order[pos];
+
+	while (true) {
+		uint32_t child = 2 * pos + 1;
+
+		if (child >= heap->count) break;
+		if (child + 1 < heap->count && before(heap, heap->order[child + 1], heap->order[child])) child++;
+		if (!before(heap, heap->order[child], slot)) break;
+		place(heap, pos, heap->order[child]);
+		pos = child;
+	}
+
+	place(heap, pos, slot);
+}
+
+int32_t alarm_heap_add(struct alarm_heap_t *heap, int64_t deadline, uint8_t action, uint8_t arg) {
+	if (heap->count == heap->capacity) return ALARM_FULL;
+
+	// The first free slot is right after the pending alarms
+	uint16_t slot = heap->order[heap->count];
+	struct alarm_t *alarm = &heap->alarms[slot];
+
+	alarm->deadline = deadline;
+	alarm->seq = heap->added++;
+	alarm->action = action;
+	alarm->arg = arg;
+
+	heap->count++;
+	sift_up(heap, heap->count - 1);
+	return id_of(heap, slot);
+}
+
+// Free the slot of the alarm at `pos` and fill the hole with the last alarm
+static void remove_at(struct alarm_heap_t *heap, uint32_t pos) {
+	uint16_t slot = heap->order[pos];
+
+	heap->count--;
+
+	if (pos != heap->count) {
+		uint16_t last = heap->order[heap->count];
+
+		// The last alarm may belong above or below the hole
+		place(heap, pos, last);
+		sift_up(heap, pos);
+		sift_down(heap, heap->alarms[last].pos);
+	}
+
+	place(heap, heap->count, slot);
+	heap->alarms[slot].gen = heap->alarms[slot].gen + 1 == heap->gen_limit ? 0 : heap->alarms[slot].gen + 1;
+}
+
+bool alarm_heap_cancel(struct alarm_heap_t *heap, int32_t id) {
+	if (id < 0) return false;
+
+	uint32_t slot = (uint32_t)id % heap->capacity;
+	const struct alarm_t *alarm = &heap->alarms[slot];
+
+	if (alarm->pos >= heap->count || alarm->gen != (uint32_t)id / heap->capacity) return false;
+
+	remove_at(heap, alarm->pos);
+	return true;
+}
+
+bool alarm_heap_next(const struct alarm_heap_t *heap, int64_t *deadline) {
+	if (heap->count == 0) return false;
+
+	*deadline = heap->alarms[heap->order[0]].deadline;
+	return true;
+}
+
+int32_t alarm_heap_pop_due(struct alarm_heap_t *heap, int64_t now, struct alarm_t *out) {
+	if (heap->count == 0) return -1;
+
+	uint16_t slot = heap->order[0];
+	int32_t id = id_of(heap, slot);
+
+	if (heap->alarms[slot].deadline > now) return -1;
+
+	*out = heap->alarms[slot];
+	remove_at(heap, 0);
+	return id;
+}
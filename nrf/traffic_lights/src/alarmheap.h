@@ -0,0 +1,70 @@
+#ifndef ALARMHEAP_H
+#define ALARMHEAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Return value of `alarm_heap_add` when every slot holds a pending alarm
+#define ALARM_FULL                (-1)
+
+// Most alarms a heap can hold, the slots are numbered with 16 bits
+#define ALARM_HEAP_MAX            UINT16_MAX
+
+struct alarm_t {
+    // When the alarm is due, in ms of uptime
+    int64_t deadline;
+    // Order the alarms were added in, alarms due at the same time go off in this order
+    uint32_t seq;
+    // Times the slot has been reused, part of the id so that an old id does not match the next alarm of the slot
+    uint32_t gen;
+    // Index in the heap order, the count of pending alarms or more while the slot is free
+    uint16_t pos;
+    // Carried as is for the owner of the heap
+    uint8_t action;
+    uint8_t arg;
+};
+
+/*
+    Pending alarms in a binary min-heap ordered by deadline, in slots given by the owner. Adding and cancelling take
+    O(log n), the earliest alarm is always first. An alarm keeps its slot until it is taken or cancelled and is known
+    by an id made of the slot and its reuse count. It does no locking of its own, the owner serializes the calls.
+*/
+struct alarm_heap_t {
+    struct alarm_t *alarms;
+    // Slots of the pending alarms in heap order, then the free slots
+    uint16_t *order;
+    uint32_t capacity;
+    uint32_t count;
+    // Alarms added so far, for their `seq`
+    uint32_t added;
+    // Reuse counts wrap here, so that ids stay positive
+    uint32_t gen_limit;
+};
+
+// Set up an empty heap over `capacity` alarms and as many order entries, at most ALARM_HEAP_MAX
+void alarm_heap_init(struct alarm_heap_t *heap, struct alarm_t *alarms, uint16_t *order, uint32_t capacity);
+
+// Add an alarm due at `deadline`. Returns its id, zero or more, or ALARM_FULL.
+int32_t alarm_heap_add(struct alarm_heap_t *heap, int64_t deadline, uint8_t action, uint8_t arg);
+
+// Remove a pending alarm. Returns false if there is none with the id, it has gone off or been cancelled already.
+bool alarm_heap_cancel(struct alarm_heap_t *heap, int32_t id);
+
+// Deadline of the earliest alarm. Returns false if none is pending.
+bool alarm_heap_next(const struct alarm_heap_t *heap, int64_t *deadline);
+
+/*
+    Take the earliest alarm if it is due at `now` or before. Returns its id and copies it to `out`, or returns -1 if
+    none is due.
+*/
+int32_t alarm_heap_pop_due(struct alarm_heap_t *heap, int64_t now, struct alarm_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ALARMHEAP_H
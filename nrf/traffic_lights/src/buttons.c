@@ -1,9 +1,16 @@
+/* Buttons. The interrupts stay enabled on both edges of every button and only push the edge into a lock-free ring, a
+ * debounce state machine per button in one shared delayable work item decides when a button has really been pressed.
+ * A press acts right away on its first edge, the bounces after it are counted as ripple until the button has been
+ * quiet for the debounce time.
+ */
+
 #include <zephyr/kernel.h>
 #include <zephyr/drivers/gpio.h>
+#include <zephyr/timing/timing.h>
 
 #include "buttons.h"
 #include "ledctl.h"
-#include "mux.h"
+#include "latency.h"
 #include "debug.h"
 
 // Manual drive button is button 0
@@ -15,204 +22,204 @@
 // Toggle blink yellow on manual drive
 #define YBLINK_TOGGLE DT_ALIAS(sw4)
 
-// Prevent noise and constant interruptions from button presses
-#define DEBOUNCE_TIME_MS 200
+// A button has settled when it has not changed for this long
+#define DEBOUNCE_TIME_US (CONFIG_TRAFFIC_LIGHTS_DEBOUNCE_MS * 1000)
+
+// Edges waiting for the debounce work, a power of two
+#define EDGE_RING_SIZE 32
+#define EDGE_RING_MASK (EDGE_RING_SIZE - 1)
+
+struct button_t {
+    const struct gpio_dt_spec spec;
+    struct gpio_callback cb;
+    // What a press does
+    enum led_event event;
+    enum latency_source source;
+    struct btn_stat_t *stat;
+
+    // Debounce state, only touched by the debounce work
+    bool settling;
+    bool pressed;
+    uint32_t ripple;
+    timing_t quiet_since;
+};
+
+#define BUTTON(node, ev, src, st) { \
+    .spec = GPIO_DT_SPEC_GET(node, gpios), \
+    .event = ev, \
+    .source = src, \
+    .stat = &statistics.btns.st, \
+}
 
-K_TIMER_DEFINE(button_db, interrupt_enable, NULL);
+static struct button_t buttons[] = {
+    BUTTON(MANUAL, LED_EV_MANUAL, LAT_SRC_MANUAL, button_manual_toggle),
+    BUTTON(RED_TOGGLE, LED_EV_RED, LAT_SRC_RED, button_red_toggle),
+    BUTTON(YELLOW_TOGGLE, LED_EV_YELLOW, LAT_SRC_YELLOW, button_yellow_toggle),
+    BUTTON(GREEN_TOGGLE, LED_EV_GREEN, LAT_SRC_GREEN, button_green_toggle),
+    BUTTON(YBLINK_TOGGLE, LED_EV_BLINK_TOGGLE, LAT_SRC_BLINK, button_yellow_blink_toggle),
+};
 
-// Bind manual drive state to button 0 and create a callback structure
-static const struct gpio_dt_spec manual_button = GPIO_DT_SPEC_GET(MANUAL, gpios);
-static struct gpio_callback manual_cb_data;
+struct button_edge_t {
+    uint8_t button;
+    timing_t stamp;
+};
 
-// Bind manual toggle color buttons to buttons 2, 3, 4 and 5 and create callback structures
-static const struct gpio_dt_spec red_toggle = GPIO_DT_SPEC_GET(RED_TOGGLE, gpios);
-static struct gpio_callback red_cb_data;
-static const struct gpio_dt_spec yellow_toggle = GPIO_DT_SPEC_GET(YELLOW_TOGGLE, gpios);
-static struct gpio_callback yellow_cb_data;
-static const struct gpio_dt_spec green_toggle = GPIO_DT_SPEC_GET(GREEN_TOGGLE, gpios);
-static struct gpio_callback green_cb_data;
-static const struct gpio_dt_spec yblink_toggle = GPIO_DT_SPEC_GET(YBLINK_TOGGLE, gpios);
-static struct gpio_callback yblink_cb_data;
+/*
+    Single producer, single consumer ring from the button interrupts to the debounce work. All button callbacks are
+    called from the interrupt of the GPIO controller, so they never run concurrently with each other and count as one
+    producer. The interrupt only writes `edge_head` and the work only writes `edge_tail`.
+*/
+static struct button_edge_t edge_ring[EDGE_RING_SIZE];
+static atomic_t edge_head = ATOMIC_INIT(0);
+static atomic_t edge_tail = ATOMIC_INIT(0);
 
-static bool interrupt_enabled = true;
+// Edges lost because the ring was full. Reading the pin back when the button settles still catches the final level.
+atomic_t button_edges_dropped = ATOMIC_INIT(0);
 
-bool init_buttons(void)
+static void debounce(struct k_work *work);
+
+K_WORK_DELAYABLE_DEFINE(debounce_work, debounce);
+
+static void button_isr(const struct device *dev, struct gpio_callback *cb, uint32_t pins)
 {
-    // Check that buttons are ready
-    if (!gpio_is_ready_dt(&manual_button) || !gpio_is_ready_dt(&red_toggle) ||
-    !gpio_is_ready_dt(&yellow_toggle) || !gpio_is_ready_dt(&green_toggle) ||
-    !gpio_is_ready_dt(&yblink_toggle)) {
-        debug("Error: Button device not ready\n");
-        return false;
-    }
+    timing_t start = timing_counter_get();
+    struct button_t *button = CONTAINER_OF(cb, struct button_t, cb);
+    atomic_val_t head = atomic_get(&edge_head);
 
-    // Set led pins as output and buttons as input
-	if (gpio_pin_configure_dt(&manual_button, GPIO_INPUT | GPIO_PULL_UP) < 0
-        || gpio_pin_configure_dt(&red_toggle, GPIO_INPUT | GPIO_PULL_UP) < 0
-        || gpio_pin_configure_dt(&yellow_toggle, GPIO_INPUT | GPIO_PULL_UP) < 0
-        || gpio_pin_configure_dt(&green_toggle, GPIO_INPUT | GPIO_PULL_UP) < 0
-        || gpio_pin_configure_dt(&yblink_toggle, GPIO_INPUT | GPIO_PULL_UP) < 0) {
-        debug("Error: Failed to configure IO\n");
-		return false;
-	}
-
-    // Finally configure the button to interrupt and..
-    if (gpio_pin_interrupt_configure_dt(&manual_button, GPIO_INT_EDGE_TO_INACTIVE) < 0 ||
-    gpio_pin_interrupt_configure_dt(&red_toggle, GPIO_INT_EDGE_TO_ACTIVE) < 0 ||
-    gpio_pin_interrupt_configure_dt(&yellow_toggle, GPIO_INT_EDGE_TO_ACTIVE) < 0 ||
-    gpio_pin_interrupt_configure_dt(&green_toggle, GPIO_INT_EDGE_TO_ACTIVE) < 0 ||
-    gpio_pin_interrupt_configure_dt(&yblink_toggle, GPIO_INT_EDGE_TO_ACTIVE) < 0) {
-        debug("Error: Failed to configure button interrupt\n");
-        return false;
+    if (head - atomic_get(&edge_tail) >= EDGE_RING_SIZE) {
+        atomic_inc(&button_edges_dropped);
+    } else {
+        edge_ring[head & EDGE_RING_MASK] = (struct button_edge_t){ .button = button - buttons, .stamp = start };
+        atomic_set(&edge_head, head + 1);
     }
 
-    // ..add the interrupt handlers
-    gpio_init_callback(&manual_cb_data, manual_isr, BIT(manual_button.pin));
-    gpio_init_callback(&red_cb_data, red_toggle_isr, BIT(red_toggle.pin));
-    gpio_init_callback(&yellow_cb_data, yellow_toggle_isr, BIT(yellow_toggle.pin));
-    gpio_init_callback(&green_cb_data, green_toggle_isr, BIT(green_toggle.pin));
-    gpio_init_callback(&yblink_cb_data, yblink_toggle_isr, BIT(yblink_toggle.pin));
-
-    if (gpio_add_callback(manual_button.port, &manual_cb_data) < 0 ||
-    gpio_add_callback(red_toggle.port, &red_cb_data) < 0 || 
-    gpio_add_callback(yellow_toggle.port, &yellow_cb_data) < 0 ||
-    gpio_add_callback(green_toggle.port, &green_cb_data) < 0 ||
-    gpio_add_callback(yblink_toggle.port, &yblink_cb_data) < 0) {
-        debug("Error: Failed to add button callback(s)\n");
+    k_work_reschedule(&debounce_work, K_NO_WAIT);
+    stat_add(&button->stat->isr, start, timing_counter_get());
+}
+
+// Take one edge from the ring, returns false if it is empty
+static bool edge_get(struct button_edge_t *edge)
+{
+    atomic_val_t tail = atomic_get(&edge_tail);
+
+    if (tail == atomic_get(&edge_head)) {
         return false;
     }
 
+    *edge = edge_ring[tail & EDGE_RING_MASK];
+    atomic_set(&edge_tail, tail + 1);
     return true;
 }
 
-void interrupt_enable(void)
+static uint64_t elapsed_us(timing_t since, timing_t now)
 {
-    interrupt_enabled = true;
-    gpio_pin_interrupt_configure_dt(&manual_button, GPIO_INT_EDGE_TO_ACTIVE);
-
-    if (paused) {
-        // If we are in manual mode, we need to reconfigure the toggles
-        gpio_pin_interrupt_configure_dt(&red_toggle, GPIO_INT_EDGE_TO_ACTIVE);
-        gpio_pin_interrupt_configure_dt(&yellow_toggle, GPIO_INT_EDGE_TO_ACTIVE);
-        gpio_pin_interrupt_configure_dt(&green_toggle, GPIO_INT_EDGE_TO_ACTIVE);
-        gpio_pin_interrupt_configure_dt(&yblink_toggle, GPIO_INT_EDGE_TO_ACTIVE);
-    }
-
-    debug("Interrupts enabled\n");
+    return timing_cycles_to_ns(timing_cycles_get(&since, &now)) / 1000;
 }
 
-void interrupt_disable(void)
+static void press(struct button_t *button, timing_t stamp)
 {
-    interrupt_enabled = false;
-    gpio_pin_interrupt_configure_dt(&manual_button, GPIO_INT_DISABLE);
-    gpio_pin_interrupt_configure_dt(&red_toggle, GPIO_INT_DISABLE);
-    gpio_pin_interrupt_configure_dt(&yellow_toggle, GPIO_INT_DISABLE);
-    gpio_pin_interrupt_configure_dt(&green_toggle, GPIO_INT_DISABLE);
-    gpio_pin_interrupt_configure_dt(&yblink_toggle, GPIO_INT_DISABLE);
-    k_timer_start(&button_db, K_MSEC(DEBOUNCE_TIME_MS), K_NO_WAIT);
+    button->stat->pushed++;
+
+    if (ledctl_post_from(button->event, CMD_SRC_BUTTON, button->source, stamp) != 0) {
+        debug("Try again. Led engine is busy");
+    }
 }
 
-void manual_isr(void)
+/*
+    Run the state machine of every button. A button is either stable or settling. The first edge of a stable button
+    flips it and a flip to pressed acts immediately, so the latency of a press is not delayed by the debounce time.
+    Further edges only count as ripple and push the end of settling forward. Once the button has been quiet for the
+    debounce time, the pin is read to catch a flip that happened while settling, like a release shorter than the ripple.
+*/
+static void debounce(struct k_work *work)
 {
-    interrupt_disable();
-    paused = !paused;
-
-    // If we are pausing, save the current state and set state to MANUAL
-    if (paused) {
-        // Save the current color
-        cont = color;
-        state = Manual;
-        debug("Manual control\n");
-    // If we are unpausing, restore the saved state
-    } else {
-        if (k_mutex_lock(&lmux, K_NO_WAIT) == 0) {
-            state = Auto;
-            color = cont;
-
-            switch (color) {
-                case Red:
-                    k_condvar_signal(&rsig);
-                    break;
-                case Yellow:
-                    k_condvar_signal(&ysig);
-                    break;
-                default:
-                    k_condvar_signal(&gsig);
-                    break;
+    struct button_edge_t edge;
+    uint64_t next_us = UINT64_MAX;
+
+    while (edge_get(&edge)) {
+        struct button_t *button = &buttons[edge.button];
+
+        if (!button->settling) {
+            button->settling = true;
+            button->ripple = 0;
+            button->pressed = !button->pressed;
+
+            if (button->pressed) {
+                press(button, edge.stamp);
             }
-        } else {
-            debug("Try again. Mutex is busy\n");
         }
 
-        k_mutex_unlock(&lmux);
+        button->ripple++;
+        button->quiet_since = edge.stamp;
     }
-}
 
-void red_toggle_isr(void)
-{
-    interrupt_disable();
+    timing_t now = timing_counter_get();
+
+    for (int i = 0; i < ARRAY_SIZE(buttons); i++) {
+        struct button_t *button = &buttons[i];
 
-    // Only do something if we are paused
-    if (paused) {
-        if (state == Blink) {
-            state = Manual;
-            debug("Toggling YELLOW BLINK OFF\n");
+        if (!button->settling) {
+            continue;
         }
 
-        // Send signal to red task
-        k_condvar_signal(&rsig);
-        debug("Toggling RED\n");
-    }
-}
+        uint64_t quiet_us = elapsed_us(button->quiet_since, now);
 
-void yellow_toggle_isr(void)
-{
-    interrupt_disable();
+        if (quiet_us < DEBOUNCE_TIME_US) {
+            next_us = MIN(next_us, DEBOUNCE_TIME_US - quiet_us);
+            continue;
+        }
 
-    if (paused) {
-        if (state == Blink) {
-            state = Manual;
-            debug("Toggling YELLOW BLINK OFF\n");
+        button->settling = false;
+
+        bool level = gpio_pin_get_dt(&button->spec) > 0;
+
+        if (level != button->pressed) {
+            button->pressed = level;
+
+            if (level) {
+                press(button, button->quiet_since);
+            }
         }
 
-        // Send signal to yellow task
-        k_condvar_signal(&ysig);
-        debug("Toggling YELLOW\n");
+        // Ripple is the number of edges per settled change, averaged over the recent presses
+        struct btn_stat_t *stat = button->stat;
+        stat->typical_ripple = stat->typical_ripple == 0 ? button->ripple : (3 * stat->typical_ripple + button->ripple + 2) / 4;
+
+        debug("Button %d settled after %d edges", i, button->ripple);
     }
 
+    if (next_us != UINT64_MAX) {
+        k_work_reschedule(&debounce_work, K_USEC(next_us));
+    }
 }
 
-void green_toggle_isr(void)
+bool init_buttons(void)
 {
-    interrupt_disable();
+    for (int i = 0; i < ARRAY_SIZE(buttons); i++) {
+        struct button_t *button = &buttons[i];
 
-    if (paused) {
-        if (state == Blink) {
-            state = Manual;
-            debug("Toggling YELLOW BLINK OFF\n");
+        // Check that buttons are ready
+        if (!gpio_is_ready_dt(&button->spec)) {
+            debug("Error: Button device not ready");
+            return false;
         }
-        
-        // Send signal to green task
-        k_condvar_signal(&gsig);
-        debug("Toggling GREEN\n");
-    }
-}
 
-void yblink_toggle_isr(void)
-{
-    interrupt_disable();
-
-    if (paused) {
-        // Toggle blinking yellow mode
-        if (state != Blink) {
-            state = Blink;
-            debug("Toggling YELLOW BLINK ON\n");
-        } else {
-            state = Manual;
-            debug("Toggling YELLOW BLINK OFF\n");
+        if (gpio_pin_configure_dt(&button->spec, GPIO_INPUT | GPIO_PULL_UP) < 0) {
+            debug("Error: Failed to configure IO");
+            return false;
+        }
+
+        button->pressed = gpio_pin_get_dt(&button->spec) > 0;
+
+        // Both edges interrupt so that the debounce sees releases too
+        gpio_init_callback(&button->cb, button_isr, BIT(button->spec.pin));
+
+        if (gpio_add_callback(button->spec.port, &button->cb) < 0 ||
+        gpio_pin_interrupt_configure_dt(&button->spec, GPIO_INT_EDGE_BOTH) < 0) {
+            debug("Error: Failed to configure button interrupt");
+            return false;
         }
     }
 
-    // Send signal to yellow task
-    k_condvar_signal(&ysig);
-}
\ No newline at end of file
+    return true;
+}
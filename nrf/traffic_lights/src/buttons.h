@@ -1,18 +1,15 @@
 #ifndef BUTTONS_H
 #define BUTTONS_H
 
-// Interrupt callback for the buttons
-void manual_isr(void);
-void red_toggle_isr(void);
-void yellow_toggle_isr(void);
-void green_toggle_isr(void);
-void yblink_toggle_isr(void);
-
-// Helper functions and variable to enable an disable interrupts for pause button
-// and to detect if the interrupts are enabled or disabled
-void interrupt_enable(void); 
-void interrupt_disable(void);
+#include <zephyr/sys/atomic.h>
 
+/*
+    Configure the buttons and enable their interrupts. Every press is debounced and posted to the led engine, the
+    manual button pauses or resumes and the others toggle colors and blinking while paused.
+*/
 bool init_buttons(void);
 
-#endif
\ No newline at end of file
+// Button edges lost because the debounce work fell behind
+extern atomic_t button_edges_dropped;
+
+#endif
@@ -0,0 +1,85 @@
+#include <string.h>
+#include "cmdbus.h"
+
+// Priority of each source. Buttons come right after the system so that a person is never kept waiting by the UART.
+static const uint8_t source_priority[CMD_SRC_COUNT] = {
+	[CMD_SRC_SYSTEM] = 0,
+	[CMD_SRC_BUTTON] = 0,
+	[CMD_SRC_TIMER] = 1,
+	[CMD_SRC_UART] = 2,
+	[CMD_SRC_DISPATCHER] = 3,
+};
+
+#define RING_MASK (CMD_BUS_DEPTH - 1)
+
+void cmd_bus_init(struct cmd_bus_t *bus, const uint8_t *event_flags, uint32_t event_count) {
+	memset(bus, 0, sizeof(*bus));
+	bus->event_flags = event_flags;
+	bus->event_count = event_count;
+}
+
+static uint8_t flags_of(const struct cmd_bus_t *bus, const struct command_t *cmd) {
+	return cmd->event < bus->event_count ? bus->event_flags[cmd->event] : 0;
+}
+
+// Try to fold the command into the ones waiting in the ring. Returns true if nothing needs to be queued.
+static bool coalesce(struct cmd_ring_t *ring, uint8_t flags, const struct command_t *cmd) {
+	if (flags == 0 || cmd->done != NULL || ring->head == ring->tail) return false;
+
+	// Only the newest command can absorb this one, anything in between could undo it
+	const struct command_t *newest = &ring->commands[(ring->head - 1) & RING_MASK];
+
+	if (newest->event != cmd->event || newest->done != NULL) return false;
+
+	// A repeat does nothing more than the first, a toggle cancels the same toggle
+	if (!(flags & CMD_IDEMPOTENT)) ring->head--;
+	return true;
+}
+
+int cmd_bus_push(struct cmd_bus_t *bus, const struct command_t *cmd) {
+	uint8_t priority = cmd->source < CMD_SRC_COUNT ? source_priority[cmd->source] : CMD_BUS_PRIORITIES - 1;
+	struct cmd_ring_t *ring = &bus->rings[priority];
+
+	if (coalesce(ring, flags_of(bus, cmd), cmd)) {
+		bus->coalesced++;
+		return CMD_COALESCED;
+	}
+
+	if (ring->head - ring->tail >= CMD_BUS_DEPTH) {
+		bus->dropped++;
+		return CMD_FULL;
+	}
+
+	ring->commands[ring->head & RING_MASK] = *cmd;
+	ring->head++;
+	bus->queued++;
+
+	uint32_t depth = cmd_bus_depth(bus);
+	if (depth > bus->peak_depth) bus->peak_depth = depth;
+
+	return CMD_QUEUED;
+}
+
+bool cmd_bus_pop(struct cmd_bus_t *bus, struct command_t *out) {
+	for (int priority = 0; priority < CMD_BUS_PRIORITIES; priority++) {
+		struct cmd_ring_t *ring = &bus->rings[priority];
+
+		if (ring->head != ring->tail) {
+			*out = ring->commands[ring->tail & RING_MASK];
+			ring->tail++;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+uint32_t cmd_bus_depth(const struct cmd_bus_t *bus) {
+	uint32_t depth = 0;
+
+	for (int priority = 0; priority < CMD_BUS_PRIORITIES; priority++) {
+		depth += bus->rings[priority].head - bus->rings[priority].tail;
+	}
+
+	return depth;
+}
@@ -0,0 +1,97 @@
+#ifndef CMDBUS_H
+#define CMDBUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Commands waiting at each priority, a power of two
+#define CMD_BUS_DEPTH 8
+
+// Who posted a command. Each source has a fixed priority, see `cmd_bus_pop`.
+enum cmd_source {
+    // Boot and other internal commands
+    CMD_SRC_SYSTEM,
+    CMD_SRC_BUTTON,
+    CMD_SRC_TIMER,
+    CMD_SRC_UART,
+    CMD_SRC_DISPATCHER,
+    CMD_SRC_COUNT
+};
+
+// Priority levels, 0 is served first
+#define CMD_BUS_PRIORITIES 4
+
+// How the bus may coalesce an event, given per event to `cmd_bus_init`
+// Copies right after each other do the same as one
+#define CMD_IDEMPOTENT            1
+// Two copies right after each other cancel out
+#define CMD_TOGGLE                2
+
+// Return codes of `cmd_bus_push`
+// The command was queued
+#define CMD_QUEUED                0
+// The command was merged with or cancelled out a pending one and does not need to be handled
+#define CMD_COALESCED             1
+// The queue of the priority of the command is full
+#define CMD_FULL                  (-1)
+
+/*
+    One command for the led engine. The bus only looks at `event`, `source` and `done`, the rest is carried as is.
+    `done` is an opaque pointer given back to the consumer, commands that have one are never coalesced so that the
+    poster is always answered.
+*/
+struct command_t {
+    uint8_t event;
+    uint8_t source;
+    // Latency histogram of the input, see latency.h
+    uint8_t latency;
+    void *done;
+    const void *sequence;
+    // When the input arrived and when the command was posted, in timing counter cycles
+    uint64_t stamp;
+    uint64_t posted;
+};
+
+struct cmd_ring_t {
+    uint32_t head;
+    uint32_t tail;
+    struct command_t commands[CMD_BUS_DEPTH];
+};
+
+/*
+    Fixed size queue of commands with one ring per priority. It does no locking of its own, the owner serializes
+    the calls.
+*/
+struct cmd_bus_t {
+    struct cmd_ring_t rings[CMD_BUS_PRIORITIES];
+    // CMD_IDEMPOTENT and CMD_TOGGLE flags of each event, indexed by event. The owner may switch tables between calls.
+    const uint8_t *event_flags;
+    uint32_t event_count;
+
+    // Counters for the statistics
+    uint32_t queued;
+    uint32_t coalesced;
+    uint32_t dropped;
+    uint32_t peak_depth;
+};
+
+void cmd_bus_init(struct cmd_bus_t *bus, const uint8_t *event_flags, uint32_t event_count);
+
+// Queue a command. Returns CMD_QUEUED, CMD_COALESCED or CMD_FULL.
+int cmd_bus_push(struct cmd_bus_t *bus, const struct command_t *cmd);
+
+// Take the oldest command of the highest priority that has one. Returns false if the bus is empty.
+bool cmd_bus_pop(struct cmd_bus_t *bus, struct command_t *out);
+
+// Commands waiting in all priorities
+uint32_t cmd_bus_depth(const struct cmd_bus_t *bus);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CMDBUS_H
@@ -2,157 +2,327 @@
  *  learn how to actually pass variable amount of arguments to other tasks, so that other tasks don't have
  *  to format the debug messages themselves and can just immediately carry on as usual.
  * 
- *  This is how this is supposed to work: A normal working thread calls debug function with some debug message and
- *  formatting variables, like any other formatting print function. This debug function quickly allocates memory
- *  from memory slabs for the fifo messages, and for the arguments from a dedicated slab.
+ *  This is how this is supposed to work: A normal working thread, or an interrupt, calls debug function with some
+ *  debug message and formatting variables, like any other formatting print function. The debug function claims a slot
+ *  in a lock-free ring with a single atomic compare-and-swap, copies the format string pointer and the arguments into it
+ *  and marks it ready. Formatting is left to the debug task. In binary mode it does not even format, but sends the
+ *  address of the format string and the raw arguments, which scripts/debug_decode.py turns back into text with the
+ *  help of the firmware ELF file.
  */
 
+#include <string.h>
+
 #include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/uart.h>
 #include <zephyr/timing/timing.h>
 
 #include "debug.h"
 #include "mux.h"
 
-// Argument amount that can be stored in one memory slab block.
-#define ARGS_PER_BLOCK 4
-#define MAX_ARGS 4
-// Block amount in one memory slab.
-#define MEM_SLAB_BLOCKS 32
+#define RING_SIZE CONFIG_TRAFFIC_LIGHTS_DEBUG_RING_SIZE
+#define RING_MASK (RING_SIZE - 1)
 
-void debug_task(void *, void*, void *);
+BUILD_ASSERT((RING_SIZE & RING_MASK) == 0, "Debug ring size must be a power of two");
 
-/* 
-    Holds a tight, non-fragmentable memory block for debug messages. Each message may only be 128 characters long.
-    There is room for 16 simultaneous messages in total. Use `k_mem_slab_alloc(&debug_messages, (void **)&fifodata, some_wait_time)`
-    to allocate a slab block for a debug message. 
-*/
-struct k_mem_slab debug_messages;
+// Binary records start with this marker OR'd with the argument count
+#define BINARY_MARKER 0xD0
 
-/*
-    FIFO queue for debug messages. Expects `struct debug_fifo_t` type data.
-*/
-struct k_fifo debug_fifo;
+void debug_task(void *, void*, void *);
 
 /*
-    Store one single argument and point to next four argument block, which is unnlikely. Usually 4 is quite enough for any debug message.
+    One debug message waiting to be printed. `seq` tells whose turn it is to use the slot: it equals the ring position
+    when the slot is free for a producer and the position plus one when the record is ready for the debug task.
 */
-struct debug_t {
+struct debug_record_t {
+    atomic_t seq;
+    uint32_t timestamp;
     const char *fmt;
     size_t argc;
-    uintptr_t args[MAX_ARGS];
+    uintptr_t args[DEBUG_MAX_ARGS];
 };
 
-/* 
-    Each debug fifo element holds a string pointer to arbitrary sized string that needs to be formatted.
+static struct debug_record_t ring[RING_SIZE];
+// Next position to claim for producers and to print for the debug task
+static atomic_t ring_head = ATOMIC_INIT(0);
+static atomic_t ring_tail = ATOMIC_INIT(0);
+
+// Messages lost because the ring was full
+atomic_t debug_dropped = ATOMIC_INIT(0);
+// Most messages waiting in the ring at once
+atomic_t debug_peak_depth = ATOMIC_INIT(0);
+// Mean time from schedule_printk to the message being printed, in microseconds
+atomic_t debug_mean_latency_us = ATOMIC_INIT(0);
+
+/*
+    The debug task sleeps until either the ring fills up to the high-water mark or the oldest waiting message has waited
+    for the maximum latency, and then prints everything in one batch. `timer_armed` makes sure that only the first
+    message of a batch starts the latency timer, so later messages can not keep pushing the deadline forward.
 */
-struct debug_fifo_t {
-    void *fifo_reserved;
-    struct debug_t dbg;
-};
+static void latency_expired(struct k_timer *timer);
 
-// Initialize statistics
-struct statistics statistics = {
-    .btns = {
-        .button_manual_toggle = 0,
-        .button_red_toggle = 0,
-        .button_yellow_toggle = 0,
-        .button_green_toggle = 0,
-        .button_yellow_blink_toggle = 0
-    },
-
-    .leds = {
-        .red.toggled = 0,
-        .blue.toggled = 0
-    },
-
-    .threads = {
-        .main = {
-            .typical_signal_wait_time_ms = 0,
-            .typical_runtime_ns = 0
-        },
-
-        .red = {
-            .typical_signal_wait_time_ms = 0,
-            .typical_runtime_ns = 0
-        },
-
-        .yellow = {
-            .typical_signal_wait_time_ms = 0,
-            .typical_runtime_ns = 0
-        },
-
-        .green = {
-            .typical_signal_wait_time_ms = 0,
-            .typical_runtime_ns = 0
-        },
-        
-        .uart = {
-            .typical_signal_wait_time_ms = 0,
-            .typical_runtime_ns = 0
-        },
-        
-        .dispatcher = {
-            .typical_signal_wait_time_ms = 0,
-            .typical_runtime_ns = 0
-        },
-
-        .debug = {
-            .typical_signal_wait_time_ms = 0,
-            .typical_runtime_ns = 0
-        }
-    }
-};
+K_SEM_DEFINE(debug_wakeup, 0, 1);
+K_TIMER_DEFINE(debug_latency_timer, latency_expired, NULL);
+static atomic_t timer_armed = ATOMIC_INIT(0);
+
+#ifdef CONFIG_TRAFFIC_LIGHTS_DEBUG_BINARY
+static const struct device *const console = DEVICE_DT_GET(DT_CHOSEN(zephyr_console));
+#endif
+
+// Statistics start from zero, the first sample of each one sets its minimum and average
+struct statistics statistics;
 
 volatile bool print_debug_messages = false;
 
-K_FIFO_DEFINE(debug_fifo);
 K_THREAD_DEFINE(debugth, 1024, debug_task, NULL, NULL, NULL, 10, 0, 0);
-K_MEM_SLAB_DEFINE(debug_messages, sizeof(struct debug_t), MEM_SLAB_BLOCKS, 4);
 
+static int ring_init(void)
+{
+    for (int i = 0; i < RING_SIZE; i++) {
+        atomic_set(&ring[i].seq, i);
+    }
 
-void debug_task(void *, void *, void *) {
-    struct debug_fifo_t *data;
+    return 0;
+}
 
+SYS_INIT(ring_init, PRE_KERNEL_1, 0);
+
+void schedule_printk(const char *fmt, size_t argc, uintptr_t *args) {
+    struct debug_record_t *rec;
+    atomic_val_t pos = atomic_get(&ring_head);
+
+    // Claim a slot. Another producer, possibly an interrupt, may claim the same position first, so retry until the
+    // compare-and-swap wins or the ring turns out to be full.
     while (1) {
-        // Check the fifo queue for available messages and parse them until none are left. Yield for a longer period after the queue has been
-        // processed to give room for more important tasks.
-        while ((data = k_fifo_get(&debug_fifo, K_NO_WAIT)) != NULL) {
-            printk("DEBUG: ");
-            switch (data->dbg.argc) {
-                case 0:
-                    printk(data->dbg.fmt);
-                    break;
-                case 1:
-                    printk(data->dbg.fmt, data->dbg.args[0]);
-                    break;
-                case 2:
-                    printk(data->dbg.fmt, data->dbg.args[0], data->dbg.args[1]);
-                    break;
-                case 3:
-                    printk(data->dbg.fmt, data->dbg.args[0], data->dbg.args[1], data->dbg.args[2]);
-                    break;
-                case 4:
-                    printk(data->dbg.fmt, data->dbg.args[0], data->dbg.args[1], data->dbg.args[2], data->dbg.args[3]);
-                    break;
-            }
+        rec = &ring[pos & RING_MASK];
+        atomic_val_t dif = atomic_get(&rec->seq) - pos;
 
-            printk("\n");
-            k_mem_slab_free(&debug_messages, data);
+        if (dif == 0) {
+            if (atomic_cas(&ring_head, pos, pos + 1)) {
+                break;
+            }
+        } else if (dif < 0) {
+            atomic_inc(&debug_dropped);
+            return;
         }
 
-        k_msleep(200);
+        pos = atomic_get(&ring_head);
+    }
+
+    rec->timestamp = k_cycle_get_32();
+    rec->fmt = fmt;
+    rec->argc = MIN(argc, DEBUG_MAX_ARGS);
+    memcpy(rec->args, args, rec->argc * sizeof(uintptr_t));
+
+    // Publish the record to the debug task
+    atomic_set(&rec->seq, pos + 1);
+
+    atomic_val_t depth = pos + 1 - atomic_get(&ring_tail);
+    atomic_val_t peak = atomic_get(&debug_peak_depth);
+
+    while (depth > peak && !atomic_cas(&debug_peak_depth, peak, depth)) {
+        peak = atomic_get(&debug_peak_depth);
+    }
+
+    if (depth >= CONFIG_TRAFFIC_LIGHTS_DEBUG_HIGH_WATER) {
+        k_sem_give(&debug_wakeup);
+    } else if (atomic_cas(&timer_armed, 0, 1)) {
+        k_timer_start(&debug_latency_timer, K_MSEC(CONFIG_TRAFFIC_LIGHTS_DEBUG_MAX_LATENCY_MS), K_NO_WAIT);
     }
 }
 
-void schedule_printk(const char *fmt, size_t argc, uintptr_t *args) {
-    struct debug_fifo_t *data;
+void stat_add(struct timing_stat_t *stat, timing_t start, timing_t end) {
+    uint64_t cycles64 = timing_cycles_get(&start, &end);
+    uint32_t cycles = MIN(cycles64, UINT32_MAX);
 
-    if (k_mem_slab_alloc(&debug_messages, (void **)&data, K_NO_WAIT) == 0) {
-        data->dbg.fmt = fmt;
-        data->dbg.argc = argc;
-        memcpy(data->dbg.args, args, argc * sizeof(uintptr_t));
-        k_fifo_put(&debug_fifo, data);
+    if (stat->count == 0) {
+        stat->avg_cycles = cycles;
+        stat->min_cycles = cycles;
+        stat->max_cycles = cycles;
     } else {
-        printk("I die :(\n");
+        // Each new sample weighs 1/8, enough to smooth out single outliers while still following changes quickly
+        stat->avg_cycles = (int64_t)stat->avg_cycles + ((int64_t)cycles - stat->avg_cycles) / 8;
+        stat->min_cycles = MIN(stat->min_cycles, cycles);
+        stat->max_cycles = MAX(stat->max_cycles, cycles);
+    }
+
+    stat->count++;
+}
+
+static uint32_t cycles_to_ns(uint32_t cycles) {
+    return MIN(timing_cycles_to_ns(cycles), UINT32_MAX);
+}
+
+static void print_led(const char *name, const struct led_stat_t *led) {
+    const struct timing_stat_t *set = &led->set;
+
+    printk("led,%s,%u,%u,%u,%u,%u\n", name, led->toggled, set->count,
+        cycles_to_ns(set->avg_cycles), cycles_to_ns(set->min_cycles), cycles_to_ns(set->max_cycles));
+}
+
+static void print_btn(const char *name, const struct btn_stat_t *btn) {
+    const struct timing_stat_t *isr = &btn->isr;
+
+    printk("btn,%s,%u,%u,%u,%u,%u,%u\n", name, btn->pushed, btn->typical_ripple, isr->count,
+        cycles_to_ns(isr->avg_cycles), cycles_to_ns(isr->min_cycles), cycles_to_ns(isr->max_cycles));
+}
+
+static void print_thread(const char *name, const struct thread_stat_t *thread) {
+    const struct timing_stat_t *wait = &thread->signal_wait;
+    const struct timing_stat_t *run = &thread->runtime;
+
+    // Waits are long, so they are printed in microseconds. Converting the cycles directly keeps them from saturating.
+    printk("thread,%s,%u,%u,%u,%u,%u,%u,%u\n", name, wait->count,
+        (uint32_t)(timing_cycles_to_ns(wait->avg_cycles) / 1000), (uint32_t)(timing_cycles_to_ns(wait->max_cycles) / 1000),
+        run->count, cycles_to_ns(run->avg_cycles), cycles_to_ns(run->min_cycles), cycles_to_ns(run->max_cycles));
+}
+
+static void print_boot(const char *name, const struct timing_stat_t *stat) {
+    printk("boot,%s,%u,%u,%u,%u\n", name, stat->count, (uint32_t)(timing_cycles_to_ns(stat->avg_cycles) / 1000),
+        (uint32_t)(timing_cycles_to_ns(stat->min_cycles) / 1000), (uint32_t)(timing_cycles_to_ns(stat->max_cycles) / 1000));
+}
+
+void stats_print_csv(void) {
+    print_led("red", &statistics.leds.red);
+    print_led("yellow", &statistics.leds.yellow);
+    print_led("green", &statistics.leds.green);
+
+    print_btn("manual", &statistics.btns.button_manual_toggle);
+    print_btn("red", &statistics.btns.button_red_toggle);
+    print_btn("yellow", &statistics.btns.button_yellow_toggle);
+    print_btn("green", &statistics.btns.button_green_toggle);
+    print_btn("blink", &statistics.btns.button_yellow_blink_toggle);
+
+    print_thread("main", &statistics.threads.main);
+    print_thread("leds", &statistics.threads.leds);
+    print_thread("uart", &statistics.threads.uart);
+    print_thread("dispatcher", &statistics.threads.dispatcher);
+    print_thread("debug", &statistics.threads.debug);
+
+    print_boot("restore", &statistics.boot.restore);
+    print_boot("first_led", &statistics.boot.first_led);
+
+    uint32_t first_led_us = (uint32_t)(timing_cycles_to_ns(statistics.boot.first_led.max_cycles) / 1000);
+
+    printk("boot,reset_to_led,%u\n", statistics.boot.first_led.count ? statistics.boot.reset_to_init_us + first_led_us : 0);
+
+    printk("debug_queue,%u,%u,%u\n", (uint32_t)atomic_get(&debug_dropped), (uint32_t)atomic_get(&debug_peak_depth),
+        (uint32_t)atomic_get(&debug_mean_latency_us));
+}
+
+static void latency_expired(struct k_timer *) {
+    k_sem_give(&debug_wakeup);
+}
+
+void debug_print_queue_stats(void) {
+    printk("Debug queue: %u dropped, peak depth %u/%u, mean latency %u us\n", (uint32_t)atomic_get(&debug_dropped),
+        (uint32_t)atomic_get(&debug_peak_depth), RING_SIZE, (uint32_t)atomic_get(&debug_mean_latency_us));
+}
+
+#ifdef CONFIG_TRAFFIC_LIGHTS_DEBUG_BINARY
+
+// Unsigned LEB128, small values take one byte
+static void put_varint(uint32_t value)
+{
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        uart_poll_out(console, value ? byte | 0x80 : byte);
+    } while (value);
+}
+
+/*
+    Binary record: marker | argc, format string address as four little endian bytes, milliseconds since the previous
+    record and the arguments, both as varints.
+*/
+static void print_record(const struct debug_record_t *rec)
+{
+    static uint32_t previous;
+    uintptr_t id = (uintptr_t)rec->fmt;
+
+    uart_poll_out(console, BINARY_MARKER | rec->argc);
+
+    for (int i = 0; i < 4; i++) {
+        uart_poll_out(console, (id >> (8 * i)) & 0xff);
+    }
+
+    put_varint(k_cyc_to_ms_floor32(rec->timestamp - previous));
+    previous = rec->timestamp;
+
+    for (int i = 0; i < rec->argc; i++) {
+        put_varint(rec->args[i]);
+    }
+}
+
+#else
+
+static void print_record(const struct debug_record_t *rec)
+{
+    printk("[%u] DEBUG: ", k_cyc_to_ms_floor32(rec->timestamp));
+
+    switch (rec->argc) {
+        case 0:
+            printk(rec->fmt);
+            break;
+        case 1:
+            printk(rec->fmt, rec->args[0]);
+            break;
+        case 2:
+            printk(rec->fmt, rec->args[0], rec->args[1]);
+            break;
+        case 3:
+            printk(rec->fmt, rec->args[0], rec->args[1], rec->args[2]);
+            break;
+        case 4:
+            printk(rec->fmt, rec->args[0], rec->args[1], rec->args[2], rec->args[3]);
+            break;
+    }
+
+    printk("\n");
+}
+
+#endif // CONFIG_TRAFFIC_LIGHTS_DEBUG_BINARY
+
+void debug_task(void *, void *, void *) {
+    uint64_t latency_sum = 0;
+    uint32_t printed = 0;
+
+    while (1) {
+        timing_t wait_start = timing_counter_get();
+
+        k_sem_take(&debug_wakeup, K_FOREVER);
+
+        timing_t start = timing_counter_get();
+        stat_add(&statistics.threads.debug.signal_wait, wait_start, start);
+
+        // Messages scheduled from now on belong to the next batch and may start the timer again. The timer is stopped first,
+        // so that a producer in between finds it still armed and its message is printed below, instead of starting the
+        // timer just to have it stopped with the flag left set.
+        k_timer_stop(&debug_latency_timer);
+        atomic_clear(&timer_armed);
+
+        // Print the ready records in order until the next one is still free or being written
+        while (1) {
+            atomic_val_t pos = atomic_get(&ring_tail);
+            struct debug_record_t *rec = &ring[pos & RING_MASK];
+
+            if (atomic_get(&rec->seq) != pos + 1) {
+                break;
+            }
+
+            print_record(rec);
+            latency_sum += k_cycle_get_32() - rec->timestamp;
+            printed++;
+
+            // Hand the slot back to producers for the next round of the ring
+            atomic_set(&ring_tail, pos + 1);
+            atomic_set(&rec->seq, pos + RING_SIZE);
+        }
+
+        if (printed > 0) {
+            atomic_set(&debug_mean_latency_us, k_cyc_to_us_floor64(latency_sum / printed));
+        }
+
+        stat_add(&statistics.threads.debug.runtime, start, timing_counter_get());
     }
-}
\ No newline at end of file
+}
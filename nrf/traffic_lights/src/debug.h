@@ -1,34 +1,75 @@
 #ifndef DEBUG_H
 #define DEBUG_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/timing/timing.h>
+
+// Most arguments a debug message can carry, the rest are ignored
+#define DEBUG_MAX_ARGS 4
+
 extern volatile bool print_debug_messages;
 
+// Debug messages dropped because the ring was full
+extern atomic_t debug_dropped;
+// Most debug messages waiting to be printed at once
+extern atomic_t debug_peak_depth;
+// Mean time from scheduling a debug message to printing it in microseconds
+extern atomic_t debug_mean_latency_us;
+
+// Print the debug queue counters
+void debug_print_queue_stats(void);
+
 /*
-    This function behaves like printk, but instead of printing directly to serial port, it queues the debug string to be printed
-    by the debug task. The formatted string must not exceed 128 characters when included the null character at the end.
+    This function behaves like printk, but instead of printing directly to serial port, it queues the format string and
+    the arguments to be printed by the debug task. It does not block or take locks, so it can be called from interrupts.
+    The format string must live for the whole run time of the program, in practice it is a string literal.
 */
 void schedule_printk(const char *fmt, size_t argc, uintptr_t *args);
 
+#define DEBUG_ARG(arg) (uintptr_t)(arg)
+
 // Schedule printk function to debug task.
 #define debug(fmt, ...) \
     if (print_debug_messages) {\
         do {\
-            uintptr_t args[] = { __VA_OPT__( (uintptr_t)(__VA_ARGS__) ) };\
+            uintptr_t args[] = { __VA_OPT__( FOR_EACH(DEBUG_ARG, (,), __VA_ARGS__) ) };\
             size_t argc = sizeof(args) / sizeof(uintptr_t);\
             schedule_printk(fmt, argc, args);\
         } while (0);\
     }\
 
+/*
+    Timing of one hot path in timer cycles. The average is an exponentially weighted moving average, so it follows the
+    recent samples. Cycles are converted to time only when the statistics are printed.
+*/
+struct timing_stat_t {
+    // How many samples have been recorded.
+    uint32_t count;
+    // Typical, shortest and longest sample.
+    uint32_t avg_cycles;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+};
+
 struct led_stat_t {
     // Keep track of the toggle amount of this led.
     uint32_t toggled;
+    // How long does it take to drive the led pins.
+    struct timing_stat_t set;
 };
 
 struct led_stats {
-    // Statistics for red led.
+    // Statistics for red light.
     struct led_stat_t red;
-    // Statistics for blue led.
-    struct led_stat_t blue;
+    // Statistics for yellow light.
+    struct led_stat_t yellow;
+    // Statistics for green light.
+    struct led_stat_t green;
 };
 
 struct btn_stat_t {
@@ -36,6 +77,8 @@ struct btn_stat_t {
     uint32_t pushed;
     // Typical ripple count for this button, aka how many toggles does it make before settling.
     uint32_t typical_ripple;
+    // How long does the interrupt handler of this button take.
+    struct timing_stat_t isr;
 };
 
 struct btn_stats {
@@ -52,21 +95,17 @@ struct btn_stats {
 };
 
 struct thread_stat_t {
-    // How long does the thread typically wait for a signal in automatic mode.
-    uint64_t typical_signal_wait_time_ms;
+    // How long does the thread typically wait for a signal.
+    struct timing_stat_t signal_wait;
     // How long does the thread typically take to finish the task, when it gets a signal.
-    uint64_t typical_runtime_ns;
+    struct timing_stat_t runtime;
 };
 
 struct thread_stats {
     // Main thread statistics.
     struct thread_stat_t main;
-    // Red led task thread statistics.
-    struct thread_stat_t red;
-    // Yellow led task thread statistics.
-    struct thread_stat_t yellow;
-    // Green led task thread statistics.
-    struct thread_stat_t green;
+    // Led engine work queue statistics. The wait is the time from posting an event to handling it.
+    struct thread_stat_t leds;
     // UART task thread statistics.
     struct thread_stat_t uart;
     // Dispatcher task thread statistics.
@@ -75,6 +114,15 @@ struct thread_stats {
     struct thread_stat_t debug;
 };
 
+struct boot_stats {
+    // How long does restoring the stored configuration from flash take.
+    struct timing_stat_t restore;
+    // Time from the led engine starting to initialize to the first led lighting up.
+    struct timing_stat_t first_led;
+    // Time from reset to the led engine starting to initialize in us.
+    uint32_t reset_to_init_us;
+};
+
 struct statistics {
     // Statistics of leds.
     struct led_stats leds;
@@ -82,7 +130,29 @@ struct statistics {
     struct btn_stats btns;
     // Statistics of threads.
     struct thread_stats threads;
+    // Statistics of booting.
+    struct boot_stats boot;
 };
 
 extern struct statistics statistics;
+
+/*
+    Add the time between two timing_counter_get() values to a statistic. Each statistic must have only one writer,
+    a single thread or a single interrupt.
+*/
+void stat_add(struct timing_stat_t *stat, timing_t start, timing_t end);
+
+/*
+    Print all statistics as comma separated values, one record per line:
+
+        led,<name>,<toggled>,<set count>,<avg ns>,<min ns>,<max ns>
+        btn,<name>,<pushed>,<typical ripple>,<isr count>,<avg ns>,<min ns>,<max ns>
+        thread,<name>,<wait count>,<wait avg us>,<wait max us>,<run count>,<run avg ns>,<run min ns>,<run max ns>
+        boot,<name>,<count>,<avg us>,<min us>,<max us>
+        boot,reset_to_led,<us>
+        debug_queue,<dropped>,<peak depth>,<mean latency us>
+
+    The time from reset to the first led is zero until a led has been lit.
+*/
+void stats_print_csv(void);
 #endif // DEBUG_H
\ No newline at end of file
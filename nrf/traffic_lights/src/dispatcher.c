@@ -10,364 +10,554 @@
 #include "mux.h"
 #include "debug.h"
 #include "timeparser.h"
+#include "uartrx.h"
+#include "latency.h"
+#include "persist.h"
+#include "robolink.h"
+#include "alarm.h"
 
 #define STACK_SIZE 512
-// Define command sequence size once to deflect possible human errors from not remembering to change every occurance
-#define COMSIZ 20
 #define UART_DEVICE DT_CHOSEN(zephyr_shell_uart)
 const struct device *uart_dev = DEVICE_DT_GET(UART_DEVICE);
 
+struct fifo_data_t {
+    void *fifo_reserved;
+    struct led_control_t ledctl;
+    // When the sequence was received
+    timing_t received;
+};
+
 K_FIFO_DEFINE(dispatcher_fifo);
+/*
+    Statically sized storage for sequences waiting in the dispatcher fifo. A sequence holds its slot until the dispatcher
+    has run it to the end, so producers see the queue as full instead of the heap running out.
+*/
+K_MEM_SLAB_DEFINE(dispatcher_slab, sizeof(struct fifo_data_t), CONFIG_TRAFFIC_LIGHTS_DISPATCHER_SLOTS, 4);
 
 K_THREAD_DEFINE(uartth, STACK_SIZE, uart_task, NULL, NULL, NULL, 4, 0, 0);
-K_THREAD_DEFINE(dispatchth, STACK_SIZE, dispatcher_task, &color, NULL, NULL, 3, 0, 0);
+K_THREAD_DEFINE(dispatchth, STACK_SIZE, dispatcher_task, NULL, NULL, NULL, 3, 0, 0);
 
+// Given by the led engine when it is done with a sequence
+K_SEM_DEFINE(sequence_done, 0, 1);
+
+// The robot test interface is in use, the UART speaks the binary protocol of robolink.h instead of text
 volatile bool robomode = false;
 
+// State of the binary protocol, only touched by the UART task
+static struct rl_decoder_t robo_decoder;
+static struct rl_frame_t robo_request;
+static struct rl_frame_t robo_response;
+static uint8_t robo_encoded[RL_ENCODED_MAX];
+// Debug messages would corrupt the frames, they are off while the protocol is in use and this is restored after
+static bool robo_debug;
+static uint32_t robo_bad_frames;
+
 // Prints the information about usage to the UART shell in command line style
 void print_help(void) {
-    printk("\n\nUsage:\n\t[[R | Y | G | O]..INT]..[[T]INT]\tSwitch light in given sequence and loop T times\n\n\tUse D to toggle debug on or off (does not echo)\n\n");
-};
-
-struct led_control_t {
-    int seq_len;
-    char colors[COMSIZ];
-    uint16_t hold_times[COMSIZ];
-    uint16_t loop;
-};
-
-struct fifo_data_t {
-    void *fifo_reserved;
-    struct led_control_t ledctl;
+    printk("\n\nUsage:\n\t[[R | Y | G | O]..INT]..[[T]INT]\tSwitch light in given sequence and loop T times\n\t(...)INT, (...)*\tRepeat a group INT times or until stopped, groups nest\n\tW\tWait for a button press\n\tA<ms>\tSet the hold time of the automatic sequence and blinking\n\tHHMMSS, HH:MM:SS, HH:MM, 1h30m, 90s[,b | ,a | ,INT]\tAlarm after a delay, with a leading @ at a time of day counted from boot. It blinks, resumes the automatic sequence or runs a stored sequence\n\t#INT<sequence>\tStore a sequence for alarms under a number\n\tC<id>\tCancel an alarm\n\n\tUse D to toggle debug on or off (does not echo)\n\tUse Q to print debug queue counters\n\tUse S to print statistics as CSV\n\tUse H to print latency histograms as CSV\n\tUse P to store the hold time, debug flag and last sequence in flash, F to forget them\n\tSend a zero byte to switch to the binary robot protocol, see scripts/robolink.py\n\n");
 };
 
 bool init_uart(void) {
-    if (device_is_ready(uart_dev)) {
+    if (device_is_ready(uart_dev) && uart_rx_init(uart_dev)) {
         return true;
     }
     debug("UART initialization failed");
     return false;
 }
 
-// Helper function to push hold time buffer contents to hold time data array
-void push_ht(uint16_t *ht_dat, uint16_t *ht, int *offset, int *len, bool *pd) {
-    // Update each corresponding hold time of the sequence
-    uint16_t holdfor = *ht;
+int dispatcher_submit(const struct led_control_t *ledctl, enum cmd_source source, timing_t received,
+    k_timeout_t timeout) {
+    struct fifo_data_t *data;
+
+    if (k_mem_slab_alloc(&dispatcher_slab, (void **)&data, timeout) != 0) {
+        debug("Dispatcher queue is full");
+        return -EBUSY;
+    }
+
+    memcpy(&data->ledctl, ledctl, sizeof(struct led_control_t));
+    data->received = received;
+
+    // Any posted event stops the running sequence and pausing does nothing else while one runs, so this lets the new
+    // sequence take over right away. Post it first so that it can not stop the new sequence instead.
+    ledctl_post(LED_EV_PAUSE, source, NULL);
+    k_fifo_put(&dispatcher_fifo, data);
+    return 0;
+}
+
+#define DAY_MS (24 * 3600 * 1000)
+
+// Milliseconds from `now` until the time of day `seconds` comes next. There is no real time clock, the day starts at boot.
+static uint32_t time_of_day_ms(int64_t now, int seconds) {
+    return (uint32_t)(((int64_t)seconds * 1000 - now % DAY_MS + DAY_MS) % DAY_MS);
+}
+
+// Action of the alarm of a time line, given after a ','
+struct time_action_t {
+    // The ',' has been read
+    bool given;
+    // Characters after it
+    uint32_t len;
+    // The alarm action, -EINVAL once it can not be valid
+    int action;
+    // Number of the stored sequence, saturated above the largest one
+    uint32_t sequence;
+};
+
+/*
+    Nothing or 'b' blinks, 'a' resumes the automatic sequence and a number runs the stored sequence of that number. Feed
+    the characters after the ','.
+*/
+static void time_action_feed(struct time_action_t *act, char c) {
+    if (act->len == 0 && c == 'b') {
+        act->action = ALARM_BLINK;
+    } else if (act->len == 0 && c == 'a') {
+        act->action = ALARM_AUTO;
+    } else if (c >= '0' && c <= '9' && (act->len == 0 || act->action == ALARM_SEQUENCE)) {
+        act->action = ALARM_SEQUENCE;
+        act->sequence = MIN(act->sequence * 10 + (c - '0'), CONFIG_TRAFFIC_LIGHTS_STORED_SEQUENCES);
+    } else {
+        act->action = -EINVAL;
+    }
+
+    act->len = MIN(act->len + 1, 2);
+}
+
+// Schedule the alarm of a time line, `time` is what the time parser returned for it
+static void schedule_alarm(int time, const struct time_action_t *act) {
+    int64_t now = k_uptime_get();
+    int64_t deadline;
+
+    if (time & TIME_ABSOLUTE) {
+        int seconds = TIME_SECONDS(time);
+        uint32_t delay_ms = time_of_day_ms(now, seconds);
+
+        printk("Setting up timer at %02d:%02d:%02d, in %u ms\n", seconds / 3600, seconds / 60 % 60, seconds % 60,
+            delay_ms);
+        deadline = now + delay_ms;
+    } else {
+        printk("Setting up timer with %i seconds\n", time);
+        deadline = now + (int64_t)time * 1000;
+    }
+
+    int id = alarm_add(deadline, act->action, act->sequence);
+
+    if (id < 0) {
+        printk("Failed to set up the alarm: %d\n", id);
+    } else {
+        printk("Alarm %d set\n", id);
+    }
+}
+
+// The number of a line starting with A, above UINT16_MAX if it was not a valid number
+static void set_hold_time(uint32_t hold_ms) {
+    bool valid = hold_ms > 0 && hold_ms <= UINT16_MAX;
+
+    if (valid) {
+        ledctl_set_hold_ms(hold_ms);
+        printk("\nHold time set to %u ms\n", hold_ms);
+    } else {
+        printk("\nInvalid hold time\n");
+    }
+}
+
+// The number of a line starting with C, above INT32_MAX if it was not a valid number
+static void cancel_alarm(uint32_t id) {
+    if (id <= INT32_MAX && alarm_cancel((int)id) == 0) {
+        printk("\nAlarm %u cancelled\n", id);
+    } else {
+        printk("\nNo such alarm\n");
+    }
+}
+
+static void robo_open(struct seq_parser_t *parser) {
+    robo_debug = print_debug_messages;
+    print_debug_messages = false;
+    rl_decoder_init(&robo_decoder);
+    // A sequence typed halfway is thrown away
+    seq_parser_init(parser);
+    robomode = true;
+}
+
+static void robo_send(const struct rl_frame_t *frame) {
+    size_t len = rl_encode(frame, robo_encoded);
+
+    for (size_t i = 0; i < len; i++) {
+        uart_poll_out(uart_dev, robo_encoded[i]);
+    }
+}
+
+// Compile the text of a sequence like a line typed on the command line and queue it
+static void robo_sequence(const struct rl_frame_t *req, timing_t received, struct seq_parser_t *parser,
+    struct led_control_t *ledctl) {
+    int ret = SEQ_MORE;
+    int len = req->len;
+
+    // A text client ends the sequence with a line break of its own, the frame ends it already
+    if (len > 0 && req->payload[len - 1] == '\n') {
+        len--;
+    }
+    if (len > 0 && req->payload[len - 1] == '\r') {
+        len--;
+    }
+
+    for (int i = 0; i < len && ret == SEQ_MORE; i++) {
+        ret = seq_parser_feed(parser, req->payload[i], ledctl);
+    }
 
+    // A line break inside the payload would end the sequence early
+    if (ret == SEQ_MORE) {
+        ret = seq_parser_feed(parser, '\n', ledctl);
+    } else {
+        seq_parser_init(parser);
+        ret = ERR_SEQ(FLAG_SEQ_SYNTAX);
+    }
 
-    while (*len > 0) {
-        int ix = *offset;
-        ht_dat[ix] = holdfor;
-        *offset += 1; // One command handled -> increment the offset
-        *len -= 1; // ..and decrement length
+    if (ret != SEQ_READY) {
+        rl_respond(&robo_response, req, RL_STATUS_ERROR, ret == SEQ_MORE ? ERR_SEQ(FLAG_SEQ_SYNTAX) : ret);
+        return;
     }
 
-    *ht = 1000;
-    *pd = false;
+    persist_set_sequence(ledctl);
+
+    if (dispatcher_submit(ledctl, CMD_SRC_UART, received, K_NO_WAIT) != 0) {
+        rl_respond(&robo_response, req, RL_STATUS_BUSY, -EBUSY);
+    } else {
+        rl_respond(&robo_response, req, RL_STATUS_OK, 0);
+    }
 }
 
-// Switch to blink state
-void simple_task() {
-    printk("Timer expired\n");
+static void robo_stats(const struct rl_frame_t *req) {
+    const struct btn_stats *btns = &statistics.btns;
+    uint32_t stats[RL_STAT_COUNT] = {
+        [RL_STAT_RED_TOGGLED] = statistics.leds.red.toggled,
+        [RL_STAT_YELLOW_TOGGLED] = statistics.leds.yellow.toggled,
+        [RL_STAT_GREEN_TOGGLED] = statistics.leds.green.toggled,
+        [RL_STAT_BUTTONS_PUSHED] = btns->button_manual_toggle.pushed + btns->button_red_toggle.pushed +
+            btns->button_yellow_toggle.pushed + btns->button_green_toggle.pushed + btns->button_yellow_blink_toggle.pushed,
+        [RL_STAT_DEBUG_DROPPED] = atomic_get(&debug_dropped),
+        [RL_STAT_DEBUG_PEAK_DEPTH] = atomic_get(&debug_peak_depth),
+        [RL_STAT_UART_DROPPED] = atomic_get(&uart_rx_dropped),
+        [RL_STAT_BAD_FRAMES] = robo_bad_frames,
+    };
+
+    rl_respond(&robo_response, req, RL_STATUS_OK, 0);
 
-    state = Blink;
-    k_condvar_signal(&ysig);
+    for (int i = 0; i < RL_STAT_COUNT; i++) {
+        rl_put_u32(&robo_response, stats[i]);
+    }
 }
 
-K_TIMER_DEFINE(schedule_timer, simple_task, NULL);
+/*
+    Handle one byte of the binary protocol. Every complete frame is answered right away, so requests that arrive while
+    one is handled wait in the receive ring and the host can keep several of them in flight.
+*/
+static void robo_feed(char rechar, timing_t received, struct seq_parser_t *parser, struct led_control_t *ledctl) {
+    int ret = rl_decode_feed(&robo_decoder, (uint8_t)rechar, &robo_request);
+
+    if (ret < 0) {
+        // The id of a broken frame can not be trusted, the host times the request out
+        robo_bad_frames++;
+        return;
+    }
+
+    if (ret != RL_FRAME) {
+        return;
+    }
+
+    const struct rl_frame_t *req = &robo_request;
+    char text[RL_PAYLOAD_MAX + 1];
+
+    switch (req->command) {
+        case RL_CMD_PING:
+            rl_respond(&robo_response, req, RL_STATUS_OK, 0);
+            memcpy(&robo_response.payload[robo_response.len], req->payload, MIN(req->len, RL_PAYLOAD_MAX - RL_RESULT_SIZE));
+            robo_response.len += MIN(req->len, RL_PAYLOAD_MAX - RL_RESULT_SIZE);
+            break;
+
+        case RL_CMD_SEQUENCE:
+            robo_sequence(req, received, parser, ledctl);
+            break;
+
+        case RL_CMD_TIME: {
+            memcpy(text, req->payload, req->len);
+            text[req->len] = '\0';
+
+            int timeout = time_parse(text);
+
+            // TIME_ABSOLUTE is a flag of the parser, on the link it gets a field of its own
+            if (timeout < 0) {
+                rl_respond(&robo_response, req, RL_STATUS_ERROR, timeout);
+                rl_put_u32(&robo_response, 0);
+            } else {
+                rl_respond(&robo_response, req, RL_STATUS_OK, TIME_SECONDS(timeout));
+                rl_put_u32(&robo_response, (timeout & TIME_ABSOLUTE) != 0);
+            }
+            break;
+        }
+
+        case RL_CMD_STATS:
+            robo_stats(req);
+            break;
+
+        case RL_CMD_DEBUG:
+            robo_debug = !robo_debug;
+            rl_respond(&robo_response, req, RL_STATUS_OK, robo_debug);
+            break;
+
+        case RL_CMD_CLOSE:
+            rl_respond(&robo_response, req, RL_STATUS_OK, 0);
+            robo_send(&robo_response);
+            robomode = false;
+            print_debug_messages = robo_debug;
+            return;
+
+        default:
+            rl_respond(&robo_response, req, RL_STATUS_UNKNOWN, 0);
+            break;
+    }
+
+    robo_send(&robo_response);
+}
 
 void uart_task(void *, void *, void *) {
     debug("Started uart task");
     // Holds the received single character
     char rechar = 0;
-    // Holds the count of received characters from UART and also is the index and seqnt counts the commands in sequence
-    int cnt = 0;
-    int seqnt = 0;
-    bool parsing_digits = false;
     bool uart_print = true;
-    // Loop through the given sequence n amount of times
-    uint16_t loop = 1;
-    bool expect_loop = false;
-    // Used to pass the commands and hold times to dispatcher
-    char command_buf[COMSIZ];
-    uint16_t ht_buf[COMSIZ];
-    // Buffer the sequence's hold_time
-    // Default to one second
-    uint16_t seq_time_buf = 1000;
-    // Initialize `command` and `single_command` with zeros
-    memset(command_buf, 0, COMSIZ);
-    memset(ht_buf, (int)&seq_time_buf, sizeof(ht_buf));
-
-    // Infinitely wait for data to be read from UART
-    // ----- Commented out to test time parser uart
-    // while (true) {
-    //     if (uart_print) {
-    //         uart_print = false;
-    //         debug("Waiting for UART");
-    //     }
-    //     // Received a character through UART -> handle it
-    //     if (uart_poll_in(uart_dev, &rechar) == 0) {
-    //         // To add more complexity for me, the message can have letters R, Y, G, O and optional time as an integer for milliseconds.
-    //         // It may contain a sequence of colors and end with the time indicator, in which case the given time is
-    //         // used for every color. If the time setting is given, it is applied to colors preceding it.
-    //         //
-    //         // Example:
-    //         // `RYG500R200G500Y1000O` Changes colors Red, Yellow and Green in sequence, holding each on for 500ms.
-    //         // Then it holds Red for 200ms, Green for 500ms, Yellow for 1s and finally turns leds off.
-
-    //         // Toggle debug messages on and off but do not print anything.
-    //         if (rechar == 'D') {
-    //             print_debug_messages = !print_debug_messages;
-    //             continue;
-    //         }
-            
-    //         printk("%c", rechar);
-    //         if (!paused && state != Manual) {
-    //             paused = true;
-    //             state = Manual;
-    //             cont = color;
-    //         }
-
-    //         if (rechar == '\r') {
-    //             rechar = '\n';
-    //         }
-            
-    //         // Parse newline aka command end
-    //         if (rechar == '\n') {
-    //             printk("\n");
-    //             push_ht(ht_buf, &seq_time_buf, &cnt, &seqnt, &parsing_digits);
-                
-    //             debug("Received: %s", command_buf);
-    //             // Allocate memory for fifo use
-    //             struct fifo_data_t *data = k_malloc(sizeof(struct fifo_data_t));
-                
-    //             if (data == NULL) {
-    //                 debug("Memory allocation error.");
-    //                 return;
-    //             }
-                
-    //             memcpy(data->ledctl.colors, command_buf, COMSIZ);
-    //             memcpy(data->ledctl.hold_times, ht_buf, sizeof(ht_buf));
-    //             data->ledctl.seq_len = cnt;
-    //             data->ledctl.loop = loop;
-    //             k_fifo_put(&dispatcher_fifo, data);
-    //             rechar = 0;
-    //             cnt = 0;
-    //             seqnt = 0;
-    //             memset(command_buf, 0, COMSIZ);
-    //             memset(ht_buf, 1000, sizeof(ht_buf));
-    //             uart_print = true;
-    //             expect_loop = false;
-    //             loop = 1;
-    //         }
-            
-    //         // Parse digits
-    //         else if (rechar > 47 && rechar < 58) {
-    //             if (!parsing_digits) {
-    //                 parsing_digits = true;
-    //                 seq_time_buf = 0;
-    //             }
-
-    //             // Convert to binary integer
-    //             if (expect_loop) {
-    //                 loop = loop * 10 + (rechar - 48);
-    //             } else {
-    //                 seq_time_buf = seq_time_buf * 10 + (rechar - 48);
-    //             }
-    //         }
-            
-    //         // Parse other characters
-    //         else {
-    //             // Commands
-    //             if ((rechar == 'R' || rechar == 'Y' || rechar == 'G' || rechar == 'O') && !expect_loop) {
-    //                 // Write previous sequence time info if present
-    //                 if (parsing_digits) {
-    //                     push_ht(ht_buf, &seq_time_buf, &cnt, &seqnt, &parsing_digits);
-    //                 }
-                    
-    //                 int index = cnt + seqnt;
-    //                 command_buf[index] = rechar;
-    //                 seqnt++; // Increment sequence counter
-    //                 expect_loop = false;
-    //             }
-
-    //             // Parse loop command
-    //             else if (rechar == 'T') {
-    //                 if (parsing_digits) {
-    //                     push_ht(ht_buf, &seq_time_buf, &cnt, &seqnt, &parsing_digits);
-    //                 }
-
-    //                 if (expect_loop) {
-    //                     debug("\nYou cannot define T multiple times!");
-    //                 } else {
-    //                     expect_loop = true;
-    //                     loop = 0;
-    //                 }
-    //             }
-                
-    //             // If no comprehensible command was given or the command was erroneous, print help
-    //             else if (rechar != '\r') {
-    //                 print_help();
-    //                 char discard;
-    //                 while (uart_poll_in(uart_dev, &discard) != -1);
-    //                 rechar = 0;
-    //                 cnt = 0;
-    //                 seqnt = 0;
-    //                 parsing_digits = false;
-    //                 expect_loop = false;
-    //                 loop = 1;
-    //                 seq_time_buf = 0;
-    //                 memset(command_buf, 0, COMSIZ);
-    //                 memset(ht_buf, 1000, sizeof(ht_buf));
-    //             }
-    //         }
-    //     }
-
-    //     k_msleep(100);
-    // }
-    // ----- End comment out
-
-    // This is meant to be a simple implementation to show it has been implemented. I intend to make this implementation better later.
+    // A line starting with a digit or '@' is a time for an alarm, otherwise it is a light sequence
+    bool line_start = true;
+    bool time_line = false;
+    struct time_action_t time_action = { .action = ALARM_BLINK };
+    // A line starting with A sets the hold time and one starting with C cancels an alarm, both are followed by a number
+    char number_line = 0;
+    uint32_t number_limit = 0;
+    uint32_t number_value = 0;
+    bool number_digits = false;
+    // A line starting with #<n> stores the sequence after the number for alarms instead of running it. The number is
+    // -1 until its first digit.
+    bool store_line = false;
+    bool store_number = false;
+    int32_t store_slot = -1;
+    // Times and light sequences are parsed as the characters arrive, a line of any length is never stored
+    struct time_stream_t time;
+    struct seq_parser_t parser;
+    struct led_control_t ledctl;
+
+    time_parse_init(&time);
+    seq_parser_init(&parser);
+
     while (true) {
         if (uart_print) {
             uart_print = false;
             debug("Waiting for UART");
         }
-        // Received a character through UART -> handle it
-        if (uart_poll_in(uart_dev, &rechar) == 0) {            
-            
-            if (rechar == (char)0) {
-                robomode = !robomode;
-                printk("%i\n", robomode);
-                continue;
+        // Block until a character has been received through UART -> handle it
+        timing_t wait_start = timing_counter_get();
+        uart_rx_getc(&rechar);
+        timing_t start = timing_counter_get();
+        stat_add(&statistics.threads.uart.signal_wait, wait_start, start);
+
+        if (robomode) {
+            robo_feed(rechar, start, &parser, &ledctl);
+            stat_add(&statistics.threads.uart.runtime, start, timing_counter_get());
+            continue;
+        }
+
+        // A zero byte switches to the binary protocol. It is also the frame delimiter, so a host can send it any time.
+        if (rechar == (char)0) {
+            robo_open(&parser);
+            line_start = true;
+            time_line = false;
+            number_line = 0;
+            store_line = false;
+            continue;
+        }
+
+        // Toggle debug messages on and off but do not print anything.
+        if (rechar == 'D') {
+            print_debug_messages = !print_debug_messages;
+            continue;
+        }
+
+        // Print the debug queue counters
+        if (rechar == 'Q') {
+            debug_print_queue_stats();
+            continue;
+        }
+
+        // Print the statistics as CSV
+        if (rechar == 'S') {
+            stats_print_csv();
+            ledctl_print_bus_csv();
+            alarm_print_csv();
+            continue;
+        }
+
+        // Print the input to led latency histograms as CSV
+        if (rechar == 'H') {
+            latency_print_csv();
+            continue;
+        }
+
+        // Store the configuration in flash or forget it
+        if (rechar == 'P' || rechar == 'F') {
+            int ret = rechar == 'P' ? persist_save() : persist_forget();
+
+            if (ret != 0) {
+                printk("Failed to update the stored configuration: %d\n", ret);
             } else {
-                // Do not echo characters when on robo mode
-                if (!robomode) printk("%c", rechar);
-                
-                if (!paused && state != Manual) {
-                    paused = true;
-                    state = Manual;
-                    cont = color;
+                printk("Configuration %s\n", rechar == 'P' ? "stored" : "forgotten");
+            }
+            continue;
+        }
+
+        printk("%c", rechar);
+
+        // Stop the automatic sequence while the user is typing
+        if (!ledctl_paused()) {
+            ledctl_post(LED_EV_PAUSE, CMD_SRC_UART, NULL);
+        }
+
+        if (rechar == '\r') {
+            rechar = '\n';
+        }
+
+        // The first character decides what kind of a line this is
+        if (line_start && rechar != '\n') {
+            time_line = (rechar >= '0' && rechar <= '9') || rechar == '@';
+            time_action = (struct time_action_t){ .action = ALARM_BLINK };
+            number_line = rechar == 'A' || rechar == 'C' ? rechar : 0;
+            number_limit = rechar == 'A' ? UINT16_MAX : INT32_MAX;
+            number_value = 0;
+            number_digits = false;
+            store_line = rechar == '#';
+            store_number = store_line;
+            store_slot = -1;
+            line_start = false;
+            time_parse_init(&time);
+
+            if (number_line || store_line) {
+                continue;
+            }
+        }
+
+        if (number_line) {
+            if (rechar == '\n') {
+                // No number is as invalid as a bad one
+                if (!number_digits) {
+                    number_value = number_limit + 1;
                 }
-    
-                if (rechar == '\r') {
-                    rechar = '\n';
+
+                if (number_line == 'A') {
+                    set_hold_time(number_value);
+                } else {
+                    cancel_alarm(number_value);
                 }
-                
-                // Parse newline aka command end
-                if (rechar == '\n') {                        
-                    int timeout = time_parse(command_buf);
-                    
-                    // Print data to robot
-                    if (robomode) {
-                        printk("%i\n", timeout);
-                    }
-                    
-                    // Otherwise schedule task normally
-                    else {
-                        printk("\n");
-                        if (timeout > -1) {
-                            printk("Setting up timer with %i seconds\n", timeout);
-                            k_timer_start(&schedule_timer, K_SECONDS(timeout), K_NO_WAIT);
-                        } else {
-                            printk("Invalid input data. Got error %08x\n", timeout);
-                        }
-                    }
-                    
-                    cnt = 0;
-                    memset(command_buf, 0, COMSIZ);
-    
+
+                number_line = 0;
+                line_start = true;
+                uart_print = true;
+            } else if (rechar >= '0' && rechar <= '9') {
+                // Saturate above the largest valid value, so that long inputs stay invalid
+                number_value = MIN((uint64_t)number_value * 10 + (rechar - '0'), (uint64_t)number_limit + 1);
+                number_digits = true;
+            } else {
+                // Anything else makes the value invalid until the end of the line
+                number_value = number_limit + 1;
+            }
+            continue;
+        }
+
+        if (store_number) {
+            if (rechar >= '0' && rechar <= '9') {
+                store_slot = MIN(MAX(store_slot, 0) * 10 + (rechar - '0'), CONFIG_TRAFFIC_LIGHTS_STORED_SEQUENCES);
+                continue;
+            }
+            store_number = false;
+        }
+
+        if (!time_line) {
+            int ret = seq_parser_feed(&parser, rechar, &ledctl);
+
+            if (ret == SEQ_READY && store_line) {
+                printk("\n");
+                if (store_slot < 0 || alarm_store_sequence(store_slot, &ledctl) != 0) {
+                    printk("Invalid sequence number\n");
                 } else {
-                    command_buf[cnt] = rechar;
-                    cnt++;
+                    printk("Sequence %d stored\n", store_slot);
+                }
+                store_line = false;
+                uart_print = true;
+            } else if (ret == SEQ_READY) {
+                printk("\n");
+                persist_set_sequence(&ledctl);
+                // Do not wait for a free slot, tell the user to try again instead
+                if (dispatcher_submit(&ledctl, CMD_SRC_UART, start, K_NO_WAIT) != 0) {
+                    printk("Busy, sequence dropped\n");
                 }
+                uart_print = true;
+            } else if (ret < 0) {
+                debug("Sequence error %d", ret);
+                print_help();
+                uart_rx_discard();
+                uart_print = true;
+            }
+
+        // Parse newline aka command end
+        } else if (rechar == '\n') {
+            int timeout = time_parse_finish(&time);
+
+            printk("\n");
+            if (timeout < 0) {
+                printk("Invalid input data. Got error %08x\n", timeout);
+            } else if (time_action.action < 0) {
+                printk("Invalid alarm action\n");
+            } else {
+                schedule_alarm(timeout, &time_action);
             }
 
+            time_line = false;
+            uart_print = true;
+
+        } else if (time_action.given) {
+            time_action_feed(&time_action, rechar);
+        } else if (rechar == ',') {
+            time_action.given = true;
+        } else {
+            time_parse_feed(&time, rechar);
+        }
+
+        if (rechar == '\n') {
+            line_start = true;
         }
-        // Causes problems with robot so uncommented it
-        // k_msleep(100);
+
+        stat_add(&statistics.threads.uart.runtime, start, timing_counter_get());
     }
 }
                 
-void dispatcher_task(enum Color *curcol, void *, void *) {
+void dispatcher_task(void *, void *, void *) {
     while (true) {
         debug("Waiting for fifo data");
+        timing_t wait_start = timing_counter_get();
         struct fifo_data_t *rec_data = k_fifo_get(&dispatcher_fifo, K_FOREVER);
 
         // Begin counting
         timing_t start = timing_counter_get();
+        stat_add(&statistics.threads.dispatcher.signal_wait, wait_start, start);
 
-        // Loop through the sequence
-        for (int l = 0; l < rec_data->ledctl.loop; l++) {
-            
-            // Iterate over each command (end with ecountering 0)
-            for (int i = 0; i < rec_data->ledctl.seq_len; i++) {
-                struct holdtime_t *ht = k_malloc(sizeof(struct holdtime_t));
-                memcpy(&ht->time, &rec_data->ledctl.hold_times[i], 2);
-                struct k_condvar *ledsig = NULL;
-    
-                switch (rec_data->ledctl.colors[i]) {
-                    case 'R':
-                        ledsig = &rsig;
-                        debug("Switched led to Red");
-                        break;
-                    case 'Y':
-                        ledsig = &ysig;
-                        debug("Switched led to Yellow");
-                        break;
-                    case 'G':
-                        ledsig = &gsig;
-                        debug("Switched led to Green");
-                        break;
-                    case 'O':
-                        switch (*curcol) {
-                            case Red:
-                                ledsig = &rsig;
-                                break;
-                            case Yellow:
-                                ledsig = &ysig;
-                                break;
-                            case Green:
-                                ledsig = &gsig;
-                                break;
-                            default:
-                                ledsig = NULL;
-                                debug("Can't turn led off if it is already off.");
-                                break;
-                        }
-    
-                        debug("Switched led to Off");
-                        break;
-                    default:
-                        k_oops();
-                }
-                    
-                    // Send the signal if it was set and wait for a generous amount of time for a answer.
-                    if (ledsig != NULL) {
-                        debug("Waiting for lock to release");
-                        if (k_mutex_lock(&lmux, K_MSEC(5000)) == 0) {
-                             k_condvar_signal(ledsig);
-                            // Wait for minimum hold time to pass before continuing
-                            if (k_condvar_wait(&sig_ok, &lmux, K_MSEC(ht->time + HOLD_TIME_MS)) == 0) {
-                                // No reason to wait here if we only toggle one color because it holds
-                                if (rec_data->ledctl.seq_len > 1) k_msleep(ht->time);
-                            } else {
-                                debug("Waiting time expired!");
-                            }
-    
-                        } else {
-                            debug("Mutex timed out");
-                        }
-    
-                        k_mutex_unlock(&lmux);
-                    }
-    
-                    k_free(ht);
-            }
+        // The engine steps through the sequence on its own timers and reads it from the slot until it is done
+        k_sem_reset(&sequence_done);
+
+        if (ledctl_run_sequence(&rec_data->ledctl, &sequence_done, rec_data->received) == 0) {
+            k_sem_take(&sequence_done, K_FOREVER);
+        } else {
+            debug("Led engine is busy");
         }
 
-        debug("Dispatcher done! Execution time: %llu ns", timing_cycles_to_ns(timing_counter_get() - start));
+        timing_t end = timing_counter_get();
+        stat_add(&statistics.threads.dispatcher.runtime, start, end);
+        debug("Dispatcher done! Execution time: %u ms", (uint32_t)(timing_cycles_to_ns(end - start) / 1000000));
 
-        k_free(rec_data);
+        k_mem_slab_free(&dispatcher_slab, rec_data);
     }
-}
\ No newline at end of file
+}
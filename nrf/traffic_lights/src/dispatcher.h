@@ -1,11 +1,25 @@
 #ifndef DISPATCHER_H
 #define DISPATCHER_H
 
+#include <zephyr/timing/timing.h>
+
+#include "seqparser.h"
+#include "cmdbus.h"
+
 extern void uart_task(void *, void *, void *);
-extern void dispatcher_task(enum Color *, void *, void *);
+extern void dispatcher_task(void *, void *, void *);
 
 extern struct k_fifo command_fifo;
 
 bool init_uart(void);
 
+/*
+    Queue a copy of the sequence for the dispatcher. Waits at most `timeout` for a free slot and returns -EBUSY if none
+    became available, so the caller decides how to push back instead of the dispatcher running out of memory.
+    `received` is the timing counter value when the sequence arrived, for the UART latency histogram. The running
+    sequence is stopped with an event from `source`, so that it keeps its order with the other events of the caller.
+*/
+int dispatcher_submit(const struct led_control_t *ledctl, enum cmd_source source, timing_t received,
+    k_timeout_t timeout);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,101 @@
+/* Latency histograms from an input to the leds. The input is stamped with timing_counter_get() where it arrives, a button
+ * interrupt or the UART and dispatcher tasks, and the led engine closes the measurement when it drives the led pins.
+ * Fixed log2 buckets keep recording to a couple of instructions and the memory use constant.
+ */
+
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/timing/timing.h>
+
+#include "latency.h"
+
+static const char *const source_names[LAT_SRC_COUNT] = {
+    [LAT_SRC_MANUAL] = "manual",
+    [LAT_SRC_RED] = "red",
+    [LAT_SRC_YELLOW] = "yellow",
+    [LAT_SRC_GREEN] = "green",
+    [LAT_SRC_BLINK] = "blink",
+    [LAT_SRC_UART] = "uart",
+    [LAT_SRC_DISPATCHER] = "dispatcher",
+};
+
+static struct latency_hist_t histograms[LAT_SRC_COUNT];
+
+static int bucket_of(uint64_t cycles)
+{
+    if (cycles < 2) {
+        return 0;
+    }
+
+    int bucket = 63 - __builtin_clzll(cycles);
+
+    return MIN(bucket, LATENCY_BUCKETS - 1);
+}
+
+void latency_record(enum latency_source source, timing_t stamp, timing_t end)
+{
+    if (source >= LAT_SRC_COUNT) {
+        return;
+    }
+
+    struct latency_hist_t *hist = &histograms[source];
+
+    hist->buckets[bucket_of(timing_cycles_get(&stamp, &end))]++;
+    hist->count++;
+}
+
+uint64_t latency_percentile(enum latency_source source, uint32_t percent)
+{
+    const struct latency_hist_t *hist = &histograms[source];
+
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    // Smallest bucket that holds at least `percent` of the samples, rounding the rank up
+    uint64_t rank = ((uint64_t)hist->count * percent + 99) / 100;
+    uint64_t seen = 0;
+
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += hist->buckets[i];
+
+        if (seen >= rank) {
+            return (2ULL << i) - 1;
+        }
+    }
+
+    return UINT64_MAX;
+}
+
+const struct latency_hist_t *latency_hist(enum latency_source source)
+{
+    return &histograms[source];
+}
+
+void latency_reset(void)
+{
+    memset(histograms, 0, sizeof(histograms));
+}
+
+void latency_print_csv(void)
+{
+    for (int source = 0; source < LAT_SRC_COUNT; source++) {
+        const struct latency_hist_t *hist = &histograms[source];
+        int last = LATENCY_BUCKETS - 1;
+
+        while (last > 0 && hist->buckets[last] == 0) {
+            last--;
+        }
+
+        printk("hist,%s,%u,%u,%u", source_names[source], hist->count,
+            (uint32_t)MIN(timing_cycles_to_ns(latency_percentile(source, 50)), UINT32_MAX),
+            (uint32_t)MIN(timing_cycles_to_ns(latency_percentile(source, 99)), UINT32_MAX));
+
+        for (int i = 0; i <= last; i++) {
+            printk(",%u", hist->buckets[i]);
+        }
+
+        printk("\n");
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <zephyr/timing/timing.h>
+
+// Bucket i counts latencies of [2^i, 2^(i+1)) timer cycles, bucket 0 also counts zero
+#define LATENCY_BUCKETS 32
+
+// Inputs whose latency to the leds is measured
+enum latency_source {
+    LAT_SRC_MANUAL,
+    LAT_SRC_RED,
+    LAT_SRC_YELLOW,
+    LAT_SRC_GREEN,
+    LAT_SRC_BLINK,
+    // From the end of a sequence line on the UART to its first light
+    LAT_SRC_UART,
+    // From the dispatcher taking a sequence to its first light
+    LAT_SRC_DISPATCHER,
+    LAT_SRC_COUNT,
+    // Event that is not measured
+    LAT_SRC_NONE = LAT_SRC_COUNT
+};
+
+struct latency_hist_t {
+    uint32_t count;
+    uint32_t buckets[LATENCY_BUCKETS];
+};
+
+/*
+    Record the latency of one input, from the timestamp taken when it arrived to `end`. Only the led engine records
+    latencies, so the histograms have a single writer.
+*/
+void latency_record(enum latency_source source, timing_t stamp, timing_t end);
+
+// Upper bound in timer cycles below which `percent` percent of the recorded latencies of `source` fall, 0 if none
+uint64_t latency_percentile(enum latency_source source, uint32_t percent);
+
+const struct latency_hist_t *latency_hist(enum latency_source source);
+
+void latency_reset(void);
+
+/*
+    Print the histograms as comma separated values, one source per line:
+
+        hist,<source>,<count>,<p50 ns>,<p99 ns>,<bucket 0>,<bucket 1>,...
+
+    Buckets after the last non-empty one are left out.
+*/
+void latency_print_csv(void);
+
+#endif // LATENCY_H
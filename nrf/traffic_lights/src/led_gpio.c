@@ -0,0 +1,80 @@
+/* GPIO led backend. Every head has a red and a green led and yellow is made by driving both of them fully on. */
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/gpio.h>
+
+#include "ledbackend.h"
+#include "topology.h"
+#include "debug.h"
+
+struct led_head_t {
+    struct gpio_dt_spec red;
+    struct gpio_dt_spec green;
+};
+
+#ifdef TOPOLOGY_NODE
+
+#define HEAD(node) { \
+        .red = GPIO_DT_SPEC_GET(node, red_gpios), \
+        .green = GPIO_DT_SPEC_GET(node, green_gpios), \
+    },
+
+static const struct led_head_t heads[TOPOLOGY_HEADS] = {
+    DT_FOREACH_CHILD(TOPOLOGY_NODE, HEAD)
+};
+
+#else
+
+static const struct led_head_t heads[TOPOLOGY_HEADS] = {
+    { .red = GPIO_DT_SPEC_GET(DT_ALIAS(led0), gpios), .green = GPIO_DT_SPEC_GET(DT_ALIAS(led1), gpios) },
+};
+
+#endif
+
+// Raw port bit of a led that is on or off. Port writes are raw, so active low leds are inverted here.
+static gpio_port_value_t led_raw(const struct gpio_dt_spec *spec, bool on)
+{
+    return on != ((spec->dt_flags & GPIO_ACTIVE_LOW) != 0) ? BIT(spec->pin) : 0;
+}
+
+bool led_backend_init(void)
+{
+    for (int i = 0; i < TOPOLOGY_HEADS; i++) {
+        const struct led_head_t *head = &heads[i];
+
+        // Check that the leds are ready
+        if (!gpio_is_ready_dt(&head->red) || !gpio_is_ready_dt(&head->green)) {
+            debug("Error: LED device(s) not ready");
+            return false;
+        }
+
+        if (gpio_pin_configure_dt(&head->red, GPIO_OUTPUT_ACTIVE) < 0 ||
+            gpio_pin_configure_dt(&head->green, GPIO_OUTPUT_INACTIVE) < 0) {
+            debug("Error: Failed to configure LED pins");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void led_backend_set(uint32_t head, enum Color color)
+{
+    const struct led_head_t *h = &heads[head];
+    bool red = color == Red || color == Yellow;
+    bool green = color == Green || color == Yellow;
+
+    if (h->red.port == h->green.port) {
+        // One write, so there is no moment where only one of the pins has changed
+        gpio_port_set_masked_raw(h->red.port, BIT(h->red.pin) | BIT(h->green.pin),
+            led_raw(&h->red, red) | led_raw(&h->green, green));
+    } else {
+        gpio_pin_set_dt(&h->red, red);
+        gpio_pin_set_dt(&h->green, green);
+    }
+}
+
+bool led_backend_blink(enum Color color, uint32_t on_ms, uint32_t off_ms)
+{
+    return false;
+}
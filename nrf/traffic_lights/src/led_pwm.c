@@ -0,0 +1,142 @@
+/* PWM led backend. Red and green are driven by the PWM channels of the pwm-led0 and pwm-led1 aliases, each color has
+ * its own duty cycle per channel so that yellow can be balanced. Blinking is left to the PWM peripheral when it can
+ * reach the blink period, and color changes can fade over CONFIG_TRAFFIC_LIGHTS_PWM_FADE_MS.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/pwm.h>
+
+#include "ledbackend.h"
+#include "topology.h"
+#include "debug.h"
+
+BUILD_ASSERT(TOPOLOGY_HEADS == 1, "The PWM backend drives a single head");
+
+static const struct pwm_dt_spec red_pwm = PWM_DT_SPEC_GET(DT_ALIAS(pwm_led0));
+static const struct pwm_dt_spec green_pwm = PWM_DT_SPEC_GET(DT_ALIAS(pwm_led1));
+
+#define PERIOD_NS PWM_USEC(CONFIG_TRAFFIC_LIGHTS_PWM_PERIOD_US)
+
+// Duty cycles of the red and green channel for each color in percent
+struct pwm_color_t {
+    uint8_t red;
+    uint8_t green;
+};
+
+static const struct pwm_color_t colors[] = {
+    [Off] = { 0, 0 },
+    [Red] = { CONFIG_TRAFFIC_LIGHTS_PWM_RED_DUTY, 0 },
+    [Yellow] = { CONFIG_TRAFFIC_LIGHTS_PWM_YELLOW_RED_DUTY, CONFIG_TRAFFIC_LIGHTS_PWM_YELLOW_GREEN_DUTY },
+    [Green] = { 0, CONFIG_TRAFFIC_LIGHTS_PWM_GREEN_DUTY },
+};
+
+// Duty updates of one fade
+#define FADE_STEPS 16
+
+/*
+    Duty cycles on the channels now and the ones a fade is heading to. Only touched from the led work queue, which
+    both calls the backend and runs the fade.
+*/
+static struct pwm_color_t shown;
+static struct pwm_color_t target;
+static int fade_step;
+
+static void fade(struct k_work *work);
+
+K_WORK_DELAYABLE_DEFINE(fade_work, fade);
+
+static int set_duty(const struct pwm_dt_spec *spec, uint32_t duty)
+{
+    return pwm_set_dt(spec, PERIOD_NS, (uint32_t)((uint64_t)PERIOD_NS * duty / 100));
+}
+
+static void show(struct pwm_color_t duty)
+{
+    set_duty(&red_pwm, duty.red);
+    set_duty(&green_pwm, duty.green);
+    shown = duty;
+}
+
+static uint8_t fade_toward(uint8_t from, uint8_t to, int remaining)
+{
+    return from + ((int)to - from) / remaining;
+}
+
+/*
+    Move the duty cycles one step closer to the target. Every step covers an equal share of what is left, so a fade
+    that is retargeted midway continues smoothly from where it was.
+*/
+static void fade(struct k_work *work)
+{
+    if (fade_step >= FADE_STEPS) {
+        return;
+    }
+
+    int remaining = FADE_STEPS - fade_step;
+    struct pwm_color_t next = {
+        .red = fade_toward(shown.red, target.red, remaining),
+        .green = fade_toward(shown.green, target.green, remaining),
+    };
+
+    fade_step++;
+    show(next);
+
+    if (fade_step < FADE_STEPS) {
+        k_work_reschedule_for_queue(&led_workq, &fade_work, K_MSEC(CONFIG_TRAFFIC_LIGHTS_PWM_FADE_MS / FADE_STEPS));
+    }
+}
+
+bool led_backend_init(void)
+{
+    if (!pwm_is_ready_dt(&red_pwm) || !pwm_is_ready_dt(&green_pwm)) {
+        debug("Error: PWM device(s) not ready");
+        return false;
+    }
+
+    // Lights start red like the GPIO backend, which configures its pins active
+    target = colors[Red];
+    fade_step = FADE_STEPS;
+    show(target);
+
+    return true;
+}
+
+void led_backend_set(uint32_t head, enum Color color)
+{
+    target = colors[color];
+
+    if (CONFIG_TRAFFIC_LIGHTS_PWM_FADE_MS < FADE_STEPS) {
+        k_work_cancel_delayable(&fade_work);
+        show(target);
+        return;
+    }
+
+    // The first step is taken right away so that the change is seen without delay
+    fade_step = 0;
+    fade(NULL);
+}
+
+/*
+    A blink is one PWM period as long as the whole blink, so the channels are fully on or off and yellow is not balanced
+    while blinking. Most PWM peripherals can not count that long, the driver then refuses the period and the engine
+    blinks instead.
+*/
+bool led_backend_blink(enum Color color, uint32_t on_ms, uint32_t off_ms)
+{
+    const struct pwm_color_t *c = &colors[color];
+    uint32_t period = PWM_MSEC(on_ms + off_ms);
+    uint32_t pulse = PWM_MSEC(on_ms);
+
+    k_work_cancel_delayable(&fade_work);
+    fade_step = FADE_STEPS;
+
+    if (pwm_set_dt(&red_pwm, period, c->red ? pulse : 0) < 0 ||
+        pwm_set_dt(&green_pwm, period, c->green ? pulse : 0) < 0) {
+        debug("Blink period is too long for the PWM, blinking in software");
+        show(shown);
+        return false;
+    }
+
+    shown = *c;
+    return true;
+}
@@ -0,0 +1,25 @@
+#ifndef LEDBACKEND_H
+#define LEDBACKEND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ledctl.h"
+
+/*
+    Driver the led engine shows the colors with. Exactly one backend is built, chosen with
+    CONFIG_TRAFFIC_LIGHTS_LED_BACKEND. Only the led engine calls these.
+*/
+
+bool led_backend_init(void);
+
+// Show a color steadily on one head of the topology, stopping any hardware blinking
+void led_backend_set(uint32_t head, enum Color color);
+
+/*
+    Blink a color on every head in hardware, on for `on_ms` and off for `off_ms`, until the next call. Returns false if the backend
+    can not do it on its own, the engine then blinks by switching colors on its timers.
+*/
+bool led_backend_blink(enum Color color, uint32_t on_ms, uint32_t off_ms);
+
+#endif // LEDBACKEND_H
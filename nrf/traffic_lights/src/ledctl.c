@@ -1,258 +1,590 @@
+/* Led engine. The leds are owned by one work queue that runs every event it receives through a compile time transition
+ * table (state x event -> action, next state, hold time). Hold times, blink periods and the steps of dispatched sequences
+ * are delayable work items on the same queue, so nothing ever sleeps and a posted event is handled as soon as the queue
+ * thread gets to run, even in the middle of a hold time.
+ */
+
 #include <zephyr/kernel.h>
-#include <zephyr/drivers/gpio.h>
 #include <zephyr/timing/timing.h>
 
 #include "ledctl.h"
+#include "ledbackend.h"
+#include "topology.h"
+#include "seqvm.h"
 #include "mux.h"
 #include "debug.h"
+#include "latency.h"
+#include "cmdbus.h"
+#include "persist.h"
+
+// Transition time of the automatic sequence and blinking, changed at runtime
+static atomic_t hold_time_ms = ATOMIC_INIT(LED_HOLD_TIME_MS);
+
+// Statistics of each color that can be lit
+static struct led_stat_t *const color_stats[] = {
+    [Off] = NULL,
+    [Red] = &statistics.leds.red,
+    [Yellow] = &statistics.leds.yellow,
+    [Green] = &statistics.leds.green,
+};
+
+// Current state initialized to red
+atomic_t led_word = ATOMIC_INIT(LED_WORD(Auto, Red, Red));
+
+// Stack size and priority for the engine work queue
+#define STACKSIZE 1024
+#define PRIORITY 2
+/*
+    How the command bus may coalesce each event. Pausing, blinking, turning off, starting and resuming do the same no
+    matter how many times they are repeated. Pausing and resuming right after each other with the manual button changes nothing.
+    The color toggles depend on the color that is on when they run, so they are never coalesced.
+*/
+static const uint8_t event_flags[LED_EV_COUNT] = {
+    [LED_EV_START] = CMD_IDEMPOTENT,
+    [LED_EV_MANUAL] = CMD_TOGGLE,
+    [LED_EV_PAUSE] = CMD_IDEMPOTENT,
+    [LED_EV_OFF] = CMD_IDEMPOTENT,
+    [LED_EV_BLINK] = CMD_IDEMPOTENT,
+    [LED_EV_RESUME] = CMD_IDEMPOTENT,
+};
+
+// While a sequence runs every manual press counts, the first one stops the sequence or continues it at a wait
+static const uint8_t sequence_event_flags[LED_EV_COUNT] = {
+    [LED_EV_START] = CMD_IDEMPOTENT,
+    [LED_EV_PAUSE] = CMD_IDEMPOTENT,
+    [LED_EV_OFF] = CMD_IDEMPOTENT,
+    [LED_EV_BLINK] = CMD_IDEMPOTENT,
+    [LED_EV_RESUME] = CMD_IDEMPOTENT,
+};
+
+// Every input reaches the engine through this bus. It is shared by interrupts and threads, so `bus_lock` guards it.
+static struct cmd_bus_t bus = { .event_flags = event_flags, .event_count = LED_EV_COUNT };
+static struct k_spinlock bus_lock;
+
+K_THREAD_STACK_DEFINE(led_workq_stack, STACKSIZE);
+struct k_work_q led_workq;
+
+static void event_handler(struct k_work *work);
+static void hold_expired(struct k_work *work);
+static void sequence_step(struct k_work *work);
+
+K_WORK_DEFINE(event_work, event_handler);
+K_WORK_DELAYABLE_DEFINE(hold_work, hold_expired);
+K_WORK_DELAYABLE_DEFINE(sequence_work, sequence_step);
+
+// States of the engine. Each one fixes the mode and the color of the lights.
+enum led_state {
+    // Marks an event that is ignored in the state
+    LS_NONE,
+    // Waiting for the start event after boot
+    LS_IDLE,
+    LS_AUTO_RED,
+    LS_AUTO_YELLOW,
+    LS_AUTO_GREEN,
+    LS_MANUAL_OFF,
+    LS_MANUAL_RED,
+    LS_MANUAL_YELLOW,
+    LS_MANUAL_GREEN,
+    LS_BLINK_ON,
+    LS_BLINK_OFF,
+    // Not a real state: continue the automatic sequence from the saved color
+    LS_RESUME,
+    LS_COUNT
+};
+
+// Actions run before entering the next state
+#define ACT_NONE 0
+// Save the current color so that the automatic sequence can be resumed from it
+#define ACT_SAVE 1
+
+struct led_transition_t {
+    uint8_t next;
+    uint8_t action;
+    // How long to stay in the next state before it times out. Zero holds until the next event.
+    uint16_t hold_ms;
+};
+
+struct led_state_info_t {
+    enum State mode;
+    enum Color color;
+};
+
+static const struct led_state_info_t state_info[LS_COUNT] = {
+    [LS_IDLE] =          { Auto,   Red },
+    [LS_AUTO_RED] =      { Auto,   Red },
+    [LS_AUTO_YELLOW] =   { Auto,   Yellow },
+    [LS_AUTO_GREEN] =    { Auto,   Green },
+    [LS_MANUAL_OFF] =    { Manual, Off },
+    [LS_MANUAL_RED] =    { Manual, Red },
+    [LS_MANUAL_YELLOW] = { Manual, Yellow },
+    [LS_MANUAL_GREEN] =  { Manual, Green },
+    [LS_BLINK_ON] =      { Blink,  Yellow },
+    [LS_BLINK_OFF] =     { Blink,  Off },
+};
+
+#define GO(s, h) { .next = (s), .action = ACT_NONE, .hold_ms = (h) }
+#define SAVE_GO(s, h) { .next = (s), .action = ACT_SAVE, .hold_ms = (h) }
+// Hold for the configured hold time
+#define HOLD UINT16_MAX
+
+// Entries of the automatic states. Colors can only be toggled after pausing.
+#define AUTO_STATE(next, paused_state) { \
+        [LED_EV_TIMEOUT] = GO(next, HOLD), \
+        [LED_EV_MANUAL] = SAVE_GO(paused_state, 0), \
+        [LED_EV_PAUSE] = SAVE_GO(paused_state, 0), \
+        [LED_EV_BLINK] = SAVE_GO(LS_BLINK_ON, HOLD), \
+    }
 
-// Set transition time between colors
-const uint32_t HOLD_TIME_MS = 1000;
-volatile bool paused = false;
-
-// Red and Green are on board leds but yellow needs to be created by combining red and green.
-#define RED_L DT_ALIAS(led0)
-#define GREEN_L DT_ALIAS(led1)
+// Entries of the manual states. Toggling the color that is on turns the lights off.
+#define MANUAL_STATE(on_red, on_yellow, on_green) { \
+        [LED_EV_MANUAL] = GO(LS_RESUME, HOLD), \
+        [LED_EV_RED] = GO(on_red, 0), \
+        [LED_EV_YELLOW] = GO(on_yellow, 0), \
+        [LED_EV_GREEN] = GO(on_green, 0), \
+        [LED_EV_OFF] = GO(LS_MANUAL_OFF, 0), \
+        [LED_EV_BLINK] = GO(LS_BLINK_ON, HOLD), \
+        [LED_EV_BLINK_TOGGLE] = GO(LS_BLINK_ON, HOLD), \
+        [LED_EV_RESUME] = GO(LS_RESUME, HOLD), \
+    }
 
-// Bind to leds and tract their state
-static const struct gpio_dt_spec red_led = GPIO_DT_SPEC_GET(RED_L, gpios);
-static const struct gpio_dt_spec green_led = GPIO_DT_SPEC_GET(GREEN_L, gpios);
+// Entries of the blink states. Any color toggle or pause stops blinking and leaves the lights to manual control.
+#define BLINK_STATE(next, stopped, on_red, on_yellow, on_green) { \
+        [LED_EV_TIMEOUT] = GO(next, HOLD), \
+        [LED_EV_MANUAL] = GO(LS_RESUME, HOLD), \
+        [LED_EV_PAUSE] = GO(stopped, 0), \
+        [LED_EV_RED] = GO(on_red, 0), \
+        [LED_EV_YELLOW] = GO(on_yellow, 0), \
+        [LED_EV_GREEN] = GO(on_green, 0), \
+        [LED_EV_OFF] = GO(LS_MANUAL_OFF, 0), \
+        [LED_EV_BLINK_TOGGLE] = GO(stopped, 0), \
+        [LED_EV_RESUME] = GO(LS_RESUME, HOLD), \
+    }
 
-// Current state variables initialized to red
-volatile enum State state = Auto;
-volatile enum Color cont = Red;
-volatile enum Color color = Red;
+static const struct led_transition_t transitions[LS_COUNT][LED_EV_COUNT] = {
+    [LS_IDLE] = {
+        [LED_EV_START] = GO(LS_AUTO_RED, HOLD),
+        [LED_EV_BLINK] = GO(LS_BLINK_ON, HOLD),
+    },
+    [LS_AUTO_RED] = AUTO_STATE(LS_AUTO_YELLOW, LS_MANUAL_RED),
+    [LS_AUTO_YELLOW] = AUTO_STATE(LS_AUTO_GREEN, LS_MANUAL_YELLOW),
+    [LS_AUTO_GREEN] = AUTO_STATE(LS_AUTO_RED, LS_MANUAL_GREEN),
+    [LS_MANUAL_OFF] = MANUAL_STATE(LS_MANUAL_RED, LS_MANUAL_YELLOW, LS_MANUAL_GREEN),
+    [LS_MANUAL_RED] = MANUAL_STATE(LS_MANUAL_OFF, LS_MANUAL_YELLOW, LS_MANUAL_GREEN),
+    [LS_MANUAL_YELLOW] = MANUAL_STATE(LS_MANUAL_RED, LS_MANUAL_OFF, LS_MANUAL_GREEN),
+    [LS_MANUAL_GREEN] = MANUAL_STATE(LS_MANUAL_RED, LS_MANUAL_YELLOW, LS_MANUAL_OFF),
+    [LS_BLINK_ON] = BLINK_STATE(LS_BLINK_OFF, LS_MANUAL_YELLOW, LS_MANUAL_RED, LS_MANUAL_OFF, LS_MANUAL_GREEN),
+    [LS_BLINK_OFF] = BLINK_STATE(LS_BLINK_ON, LS_MANUAL_OFF, LS_MANUAL_RED, LS_MANUAL_YELLOW, LS_MANUAL_GREEN),
+};
+
+BUILD_ASSERT(LS_NONE == 0, "Unlisted table entries must mean an ignored event");
+
+// Helper functions for the engine
+static void set_color(enum State mode, enum Color new_color);
+static bool set_blink(void);
+
+static bool init_leds(void)
+{
+    return topology_init() && led_backend_init();
+}
 
-// Stack size and priority for task threads
-#define STACKSIZE 512
-#define PRIORITY 2
+// Automatic state to continue from after pausing or blinking
+static enum led_state resume_state(void)
+{
+    switch (LED_WORD_GET_SAVED(atomic_get(&led_word))) {
+        case Yellow:
+            return LS_AUTO_YELLOW;
+        case Green:
+            return LS_AUTO_GREEN;
+        default:
+            return LS_AUTO_RED;
+    }
+}
 
-// TODO: Led tasks should wait for a signal `xsig` locked with led mutex `lmux` and release the lock by giving signal
-// to next color or to dispatcher, depending on if mode is automatic or manual. On automatic mode, each task calls the next:
-// Red -> Yellow -> Green -> Red.. and on manual mode each task sends a release signal for dispatcher.
-// Define tasks for each color
-K_THREAD_DEFINE(redth, STACKSIZE,
-		red, &state, &color, NULL,
-		PRIORITY, 0, 0);
-
-K_THREAD_DEFINE(yellowth, STACKSIZE,
-        yellow, &state, &color, NULL,
-        PRIORITY, 0, 0);
-
-K_THREAD_DEFINE(greenth, STACKSIZE,
-        green, &state, &color, NULL,
-        PRIORITY, 0, 0);
-        
-// Helper functions for tasks
-void toggle_led(enum State, enum Color *, enum Color);
-void set_red(void);
-void set_yellow(void);
-void set_green(void);
-void set_off(void);
 /*
-    Add thread execution time on seq_time variable. If ltime_set becomes 7 during this operation, seq_time is scheduled in
-    debugging.
+    Drive the leds for the next state and then publish it. `save` remembers the color that was on to resume from.
+    Returns true if the backend blinks the lights on its own, the engine then has no hold time to run for the state.
 */
-void add_or_send_exec(timing_t, int);
+static bool enter_state(enum led_state next, bool save)
+{
+    enum State mode = state_info[next].mode;
+    enum Color new_color = state_info[next].color;
+    bool hardware = next == LS_BLINK_ON && set_blink();
 
-/*
-    Each led task can set a bit in this atomic variable to signal othre led tasks that it has counted its execution time.
+    if (!hardware) {
+        set_color(mode, new_color);
+    }
 
-    Other ready tasks won't update the seq_time value until last one to update the value clears the flags.
+    atomic_val_t old;
+    atomic_val_t word;
 
-    Value 7 means that all tasks have added their own values.
-*/
-atomic_t ltime_set = 0;
-atomic_t seq_time = 0;
+    do {
+        old = atomic_get(&led_word);
+        enum Color saved = save ? LED_WORD_GET_COLOR(old) : LED_WORD_GET_SAVED(old);
+        word = LED_WORD(mode, new_color, saved);
+    } while (!atomic_cas(&led_word, old, word));
 
+    return hardware;
+}
 
-bool init_leds(void)
+/*
+    State of the engine. Only touched from the led work queue.
+*/
+static enum led_state current = LS_IDLE;
+// Uptime in ms when the current state times out
+static int64_t deadline;
+
+// Sequence being run, the interpreter running it and the semaphore to give when it ends
+static const struct led_control_t *sequence;
+static struct k_sem *sequence_done;
+static struct seq_vm_t seq_vm;
+static int seq_steps;
+static int64_t seq_deadline;
+// Event the sequence waits for, SEQ_WAIT_NONE when it is not waiting
+#define SEQ_WAIT_NONE 0xff
+static uint8_t seq_wait = SEQ_WAIT_NONE;
+
+// When the engine started initializing and whether the leds have been lit since, for the boot statistics
+static timing_t boot_stamp;
+static bool boot_lit;
+
+// Latency measurements waiting for the next time the led pins are driven
+static enum latency_source open_source = LAT_SRC_NONE;
+static timing_t open_stamp;
+static bool dispatch_open;
+static timing_t dispatch_stamp;
+
+static void latency_close(timing_t end)
 {
-    // Check that on-board leds are ready
-    if (!gpio_is_ready_dt(&red_led) || !gpio_is_ready_dt(&green_led)) {
-        debug("Error: LED device(s) not ready");
-        return false;
+    if (open_source != LAT_SRC_NONE) {
+        latency_record(open_source, open_stamp, end);
+        open_source = LAT_SRC_NONE;
     }
 
-    if (gpio_pin_configure_dt(&red_led, GPIO_OUTPUT_ACTIVE) < 0 ||
-        gpio_pin_configure_dt(&green_led, GPIO_OUTPUT_ACTIVE) < 0) {
-        debug("Error: Failed to configure LED pins");
-        return false;
+    if (dispatch_open) {
+        latency_record(LAT_SRC_DISPATCHER, dispatch_stamp, end);
+        dispatch_open = false;
     }
-
-    return true;
 }
 
-void red(enum State *state, enum Color *color, void *)
+static void handle_event(enum led_event event)
 {
-    timing_t start;
-    k_sem_give(&threads_ready);
+    timing_t start = timing_counter_get();
+    const struct led_transition_t *t = &transitions[current][event];
 
-    // Loop forever
-    while (1) {
-        start = timing_counter_get();
-        
-        // Wait for a signal to switch led on and off
-        debug("Waiting for lmux mutex..");
-        k_mutex_lock(&lmux, K_FOREVER);
+    if (t->next == LS_NONE) {
+        return;
+    }
 
-        debug("Done! Waiting for condition variable rsig..");
+    enum led_state next = t->next == LS_RESUME ? resume_state() : t->next;
 
-        if (k_condvar_wait(&rsig, &lmux, K_FOREVER) == 0) {
-            debug("Done!");
+    // The automatic sequence hands over to the next phase when it turns red again
+    if (event == LED_EV_TIMEOUT && next == LS_AUTO_RED) {
+        topology_next_phase();
+    }
 
-            toggle_led(*state, color, Red);
-        }
+    bool hardware = enter_state(next, t->action & ACT_SAVE);
 
-        add_or_send_exec(start, 0);
+    if (t->hold_ms == 0 || hardware) {
+        k_work_cancel_delayable(&hold_work);
+    } else {
+        uint32_t hold_ms = t->hold_ms == HOLD ? atomic_get(&hold_time_ms) : t->hold_ms;
 
-        k_mutex_unlock(&lmux);
-        k_yield();
+        // Chain timeouts from the previous deadline so that the automatic sequence does not drift
+        deadline = (event == LED_EV_TIMEOUT ? deadline : k_uptime_get()) + hold_ms;
+        k_work_reschedule_for_queue(&led_workq, &hold_work, K_TIMEOUT_ABS_MS(deadline));
     }
+
+    debug("Led transition took %d ns", (int)timing_cycles_to_ns(timing_counter_get() - start));
+    current = next;
 }
 
-void yellow(enum State *state, enum Color *color, void *)
+static void hold_expired(struct k_work *work)
 {
-    timing_t start;
-    k_sem_give(&threads_ready);    
-    // Loop forever
-    while (1) {
-        start = timing_counter_get();
-
-        // Wait for a signal to switch led on and off
-        debug("Waiting for lmux mutex..");
-        k_mutex_lock(&lmux, K_FOREVER);
-
-        debug("Done! Waiting for condition variable ysig..");
-
-        if (k_condvar_wait(&ysig, &lmux, K_FOREVER) == 0) {
-            debug("Done!");
-
-            if (*state == Blink) {
-                while (*state == Blink) {
-                    set_yellow();
-                    k_msleep(HOLD_TIME_MS);
-                    set_off();
-                    k_msleep(HOLD_TIME_MS);
-                }
-            } else {
-                toggle_led(*state, color, Yellow);
-            }
-        }
+    handle_event(LED_EV_TIMEOUT);
+}
 
-        add_or_send_exec(start, 1);
-        k_mutex_unlock(&lmux);
-        k_yield();
-    }
+// Switch how the bus coalesces the commands posted from now on
+static void bus_use_flags(const uint8_t *flags)
+{
+    k_spinlock_key_t key = k_spin_lock(&bus_lock);
+
+    bus.event_flags = flags;
+    k_spin_unlock(&bus_lock, key);
 }
 
-void green(enum State *state, enum Color *color, void *)
+static void sequence_end(void)
 {
-    timing_t start;
-    k_sem_give(&threads_ready);
-    // Loop forever
-    while (1) {
-        start = timing_counter_get();
-        
-        // Wait for a signal to switch led on and off
-        debug("Waiting for lmux mutex..");
-        k_mutex_lock(&lmux, K_FOREVER);
-        
-        debug("Done! Waiting for condition variable gsig..");
-        
-        if (k_condvar_wait(&gsig, &lmux, K_FOREVER) == 0) {
-            debug("Done!");
-
-            toggle_led(*state, color, Green);
-        }
+    k_work_cancel_delayable(&sequence_work);
+    seq_wait = SEQ_WAIT_NONE;
 
-        add_or_send_exec(start, 2);
-        k_mutex_unlock(&lmux);
-        k_yield();
+    if (sequence != NULL) {
+        sequence = NULL;
+        bus_use_flags(event_flags);
+        k_sem_give(sequence_done);
     }
 }
 
-void toggle_led(enum State state, enum Color *from_color, enum Color to_color) {
-    // Store the color function to be called and the next led signal if not manual mode
-    void (*set_color)(void);
-    struct k_condvar *next_led_signal = NULL;
+// Engine states the SET steps of a sequence go to. Sequences run paused, so the colors are set in manual mode.
+static const enum led_state set_states[] = {
+    [SEQ_COLOR_OFF] = LS_MANUAL_OFF,
+    [SEQ_COLOR_RED] = LS_MANUAL_RED,
+    [SEQ_COLOR_YELLOW] = LS_MANUAL_YELLOW,
+    [SEQ_COLOR_GREEN] = LS_MANUAL_GREEN,
+};
 
-    switch (to_color) {
-        case Red:
-            set_color = &set_red;
-            next_led_signal = &ysig;
-            break;
-        case Yellow:
-            set_color = &set_yellow;
-            next_led_signal = &gsig;
-            break;
-        case Green:
-            set_color = &set_green;
-            next_led_signal = &rsig;
+BUILD_ASSERT(SEQ_COLOR_OFF == Off && SEQ_COLOR_RED == Red && SEQ_COLOR_YELLOW == Yellow && SEQ_COLOR_GREEN == Green,
+    "Sequence colors must match the led colors");
+
+static void sequence_step(struct k_work *work)
+{
+    struct seq_step_t step;
+
+    if (sequence == NULL || seq_wait != SEQ_WAIT_NONE) {
+        return;
+    }
+
+    switch (seq_vm_run(&seq_vm, &step)) {
+        case SEQ_VM_SET:
+            k_work_cancel_delayable(&hold_work);
+            enter_state(set_states[step.color], false);
+            current = set_states[step.color];
             break;
+
+        case SEQ_VM_WAIT:
+            // The hold times after the wait count from the event that ends it
+            seq_wait = step.event;
+            return;
+
+        case SEQ_VM_ERROR:
+            debug("Stopping a broken sequence at %d", seq_vm.pc);
+            sequence_end();
+            return;
+
         default:
-            set_color = &set_off;
-            debug("Thread was killed");
-            k_oops();
+            sequence_end();
+            return;
+    }
+
+    // Only the first step after the sequence or the event it waited for arrived closes their latency measurements
+    open_source = LAT_SRC_NONE;
+    dispatch_open = false;
+
+    // No reason to wait here if we only set one color because it holds
+    if (++seq_steps == 1 && seq_vm_done(&seq_vm)) {
+        sequence_end();
+        return;
     }
 
-    if (state != Auto) {
-        // Toggle off if already on
-        if (*from_color == to_color) {
-            set_off();
-            *from_color = Off;
-        } else {
-            set_color();
-            *from_color = to_color;
+    seq_deadline += step.hold_ms;
+    k_work_reschedule_for_queue(&led_workq, &sequence_work, K_TIMEOUT_ABS_MS(seq_deadline));
+}
+
+// Whether a command continues a sequence that waits for an event instead of stopping it
+static bool sequence_continues(const struct command_t *cmd)
+{
+    return sequence != NULL && seq_wait != SEQ_WAIT_NONE && cmd->source == CMD_SRC_BUTTON &&
+        (seq_wait == SEQ_WAIT_ANY || seq_wait == cmd->event);
+}
+
+// Take the next command from the bus, returns false if there is none
+static bool take_command(struct command_t *cmd)
+{
+    k_spinlock_key_t key = k_spin_lock(&bus_lock);
+    bool taken = cmd_bus_pop(&bus, cmd);
+
+    k_spin_unlock(&bus_lock, key);
+    return taken;
+}
+
+static void event_handler(struct k_work *work)
+{
+    struct command_t ev;
+
+    while (take_command(&ev)) {
+        timing_t start = timing_counter_get();
+
+        stat_add(&statistics.threads.leds.signal_wait, ev.posted, start);
+
+        open_source = ev.latency;
+        open_stamp = ev.stamp;
+
+        if (sequence_continues(&ev)) {
+            seq_wait = SEQ_WAIT_NONE;
+            seq_deadline = k_uptime_get();
+            k_work_reschedule_for_queue(&led_workq, &sequence_work, K_NO_WAIT);
+            continue;
         }
 
-        
-        // Blink state is handled in the manual_isr in buttons.c
-    } else {
-        set_color();
-        k_msleep(HOLD_TIME_MS);
-        k_condvar_signal(next_led_signal);
+        // Anything else posted from outside takes over from a running sequence
+        sequence_end();
+
+        if (ev.event == LED_EV_SEQUENCE) {
+            // The sequence was posted by the dispatcher right after taking it from its queue
+            dispatch_open = true;
+            dispatch_stamp = ev.posted;
+            sequence = ev.sequence;
+            sequence_done = ev.done;
+            bus_use_flags(sequence_event_flags);
+            seq_vm_init(&seq_vm, sequence);
+            seq_steps = 0;
+            seq_deadline = k_uptime_get();
+            k_work_reschedule_for_queue(&led_workq, &sequence_work, K_NO_WAIT);
+            continue;
+        }
+
+        handle_event(ev.event);
+        stat_add(&statistics.threads.leds.runtime, start, timing_counter_get());
+
+        // An event that did not change the lights has no latency to measure
+        open_source = LAT_SRC_NONE;
+
+        if (ev.done != NULL) {
+            k_sem_give((struct k_sem *)ev.done);
+        }
+    }
+}
+
+static int post(struct command_t *cmd)
+{
+    cmd->posted = timing_counter_get();
+
+    k_spinlock_key_t key = k_spin_lock(&bus_lock);
+    int ret = cmd_bus_push(&bus, cmd);
+
+    k_spin_unlock(&bus_lock, key);
+
+    if (ret == CMD_FULL) {
+        return -ENOMSG;
+    }
+
+    if (ret == CMD_QUEUED) {
+        k_work_submit_to_queue(&led_workq, &event_work);
     }
 
-    k_condvar_signal(&sig_ok);
+    return 0;
+}
+
+int ledctl_post(enum led_event event, enum cmd_source source, struct k_sem *done)
+{
+    struct command_t cmd = { .event = event, .source = source, .latency = LAT_SRC_NONE, .done = done };
+
+    return post(&cmd);
 }
 
-void set_red(void)
+int ledctl_post_from(enum led_event event, enum cmd_source source, enum latency_source latency, timing_t stamp)
 {
-    gpio_pin_set_dt(&red_led, 1);
-    gpio_pin_set_dt(&green_led, 0);
-    color = Red;
+    struct command_t cmd = { .event = event, .source = source, .latency = latency, .stamp = stamp };
+
+    return post(&cmd);
 }
 
-void set_yellow(void)
+int ledctl_run_sequence(const struct led_control_t *seq, struct k_sem *done, timing_t received)
 {
-    gpio_pin_set_dt(&red_led, 1);
-    gpio_pin_set_dt(&green_led, 1);
-    color = Yellow;
+    struct command_t cmd = {
+        .event = LED_EV_SEQUENCE, .source = CMD_SRC_DISPATCHER, .latency = LAT_SRC_UART,
+        .done = done, .sequence = seq, .stamp = received
+    };
+
+    return post(&cmd);
 }
 
-void set_green(void)
+uint32_t ledctl_hold_ms(void)
 {
-    gpio_pin_set_dt(&red_led, 0);
-    gpio_pin_set_dt(&green_led, 1);
-    color = Green;
+    return atomic_get(&hold_time_ms);
 }
 
-void set_off(void)
+void ledctl_set_hold_ms(uint32_t hold_ms)
 {
-    gpio_pin_set_dt(&red_led, 0);
-    gpio_pin_set_dt(&green_led, 0);
-    color = Off;
+    atomic_set(&hold_time_ms, hold_ms);
 }
 
-void add_or_send_exec(timing_t time, int bit) {
-    if (!atomic_test_and_set_bit(&ltime_set, bit)) {
-        atomic_val_t stop = (atomic_val_t)timing_cycles_to_ns(timing_counter_get() - time);
-        atomic_add(&seq_time, stop);
-        debug("Thread time: %d ns", stop);
+void ledctl_print_bus_csv(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&bus_lock);
+    struct cmd_bus_t copy = bus;
+
+    k_spin_unlock(&bus_lock, key);
+    printk("bus,%u,%u,%u,%u\n", copy.queued, copy.coalesced, copy.dropped, copy.peak_depth);
+}
 
-        if (atomic_cas(&ltime_set, 7, 0)) {
-            debug("Sequence execution time: %d ns", atomic_clear(&seq_time));
-        }
+/*
+    Start the engine before main so that events can be posted from the first button press on. The stored configuration
+    is restored first and the leds are set up, then the engine posts its own start event. Nobody has to wait for the
+    engine to be ready and the start can not race with it: the event is queued before the queue thread first runs and
+    the automatic sequence starts as soon as it does. `threads_ready` is only given if all of this worked.
+*/
+static int led_workq_init(void)
+{
+    const struct k_work_queue_config cfg = { .name = "ledq" };
+
+    // The boot is timed, and the timing functions are otherwise only started by main
+    timing_init();
+    timing_start();
+    boot_stamp = timing_counter_get();
+    // Kernel cycles count from when the system clock started, which is as close to reset as the kernel can tell
+    statistics.boot.reset_to_init_us = k_cyc_to_us_floor32(k_cycle_get_32());
+
+    persist_restore();
+
+    if (!init_leds()) {
+        debug("Error: Failed to initialize leds");
+        return -ENODEV;
+    }
+
+    k_work_queue_init(&led_workq);
+    k_work_queue_start(&led_workq, led_workq_stack, K_THREAD_STACK_SIZEOF(led_workq_stack), PRIORITY, &cfg);
+    ledctl_post(LED_EV_START, CMD_SRC_SYSTEM, NULL);
+    k_sem_give(&threads_ready);
+
+    return 0;
+}
+
+SYS_INIT(led_workq_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+/*
+    Show the lights of a mode and color on every head. Lighting a color counts as a toggle of that light and the time it
+    takes is recorded, turning the lights off is neither. Either one closes the latency measurements of the input being
+    handled.
+*/
+static void set_color(enum State mode, enum Color new_color)
+{
+    struct led_stat_t *stat = color_stats[new_color];
+    timing_t start = timing_counter_get();
+
+    topology_show(mode, new_color);
+
+    timing_t end = timing_counter_get();
+
+    latency_close(end);
+
+    if (!boot_lit && new_color != Off) {
+        boot_lit = true;
+        stat_add(&statistics.boot.first_led, boot_stamp, end);
+
+        uint32_t reset_us = statistics.boot.reset_to_init_us + (uint32_t)(timing_cycles_to_ns(end - boot_stamp) / 1000);
+
+        debug("First led on %u us after reset", reset_us);
+    }
+
+    if (stat != NULL) {
+        stat->toggled++;
+        stat_add(&stat->set, start, timing_counter_get());
+    }
+}
+
+// Hand blinking yellow over to the backend, returns false if it can not blink on its own
+static bool set_blink(void)
+{
+    timing_t start = timing_counter_get();
+
+    uint32_t hold_ms = atomic_get(&hold_time_ms);
+
+    if (!led_backend_blink(Yellow, hold_ms, hold_ms)) {
+        return false;
     }
+
+    latency_close(timing_counter_get());
+    statistics.leds.yellow.toggled++;
+    stat_add(&statistics.leds.yellow.set, start, timing_counter_get());
+    return true;
 }
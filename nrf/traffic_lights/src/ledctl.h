@@ -1,8 +1,15 @@
 #ifndef LEDCTL_H
 #define LEDCTL_H
 
-extern const uint32_t HOLD_TIME_MS;
-extern volatile bool paused;
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/timing/timing.h>
+
+#include "latency.h"
+#include "cmdbus.h"
+
+// Transition time between colors of the automatic sequence and of blinking until it is changed
+#define LED_HOLD_TIME_MS 1000
 
 // This simplifies the state machine syntax (instead of using integers)
 enum State { Auto, Manual, Blink };
@@ -10,33 +17,103 @@ enum State { Auto, Manual, Blink };
 // Holds the state of two leds
 enum Color { Off, Red, Yellow, Green };
 
-// Current state variables initialized to red
-extern volatile enum State state;
-extern volatile enum Color cont;
-extern volatile enum Color color;
+/*
+    State of the lights packed into one word: the mode, the color that is on, the color the automatic sequence resumes
+    from and whether the automatic sequence is paused. The led engine updates the whole word with one compare-and-swap
+    after it has driven the leds, so a reader gets a consistent snapshot from a single atomic load and never waits.
+*/
+extern atomic_t led_word;
+
+#define LED_WORD_MODE_MASK        0x03
+#define LED_WORD_COLOR_SHIFT      2
+#define LED_WORD_COLOR_MASK       (0x03 << LED_WORD_COLOR_SHIFT)
+#define LED_WORD_SAVED_SHIFT      4
+#define LED_WORD_SAVED_MASK       (0x03 << LED_WORD_SAVED_SHIFT)
+#define LED_WORD_PAUSED           BIT(6)
+
+#define LED_WORD(mode, color, saved) \
+    ((mode) | ((color) << LED_WORD_COLOR_SHIFT) | ((saved) << LED_WORD_SAVED_SHIFT) | \
+    ((mode) != Auto ? LED_WORD_PAUSED : 0))
+
+// Decode a snapshot of `led_word`
+#define LED_WORD_GET_MODE(word) ((enum State)((word) & LED_WORD_MODE_MASK))
+#define LED_WORD_GET_COLOR(word) ((enum Color)(((word) & LED_WORD_COLOR_MASK) >> LED_WORD_COLOR_SHIFT))
+#define LED_WORD_GET_SAVED(word) ((enum Color)(((word) & LED_WORD_SAVED_MASK) >> LED_WORD_SAVED_SHIFT))
+#define LED_WORD_IS_PAUSED(word) (((word) & LED_WORD_PAUSED) != 0)
 
-// Red thread
-extern const k_tid_t redth;
-// Yellow thread
-extern const k_tid_t yellowth;
-// Green thread
-extern const k_tid_t greenth;
+static inline bool ledctl_paused(void)
+{
+    return LED_WORD_IS_PAUSED(atomic_get(&led_word));
+}
 
-bool init_leds(void);
+static inline enum Color ledctl_color(void)
+{
+    return LED_WORD_GET_COLOR(atomic_get(&led_word));
+}
 
 /*
-    Set red on, if it is not on. Otherwise set it off.
+    Events understood by the led engine. What an event does depends on the state the engine is in, see the transition
+    table in ledctl.c.
 */
-void red(enum State *state, enum Color *color, void *);
+enum led_event {
+    // Start the automatic sequence after boot
+    LED_EV_START,
+    // Hold time of the current state has passed. Only generated by the engine itself.
+    LED_EV_TIMEOUT,
+    // Manual control button: pause the automatic sequence or resume it from the saved color
+    LED_EV_MANUAL,
+    // Pause the automatic sequence, but do not resume if already paused
+    LED_EV_PAUSE,
+    // Toggle a color on or off when paused
+    LED_EV_RED,
+    LED_EV_YELLOW,
+    LED_EV_GREEN,
+    // Turn the lights off when paused
+    LED_EV_OFF,
+    // Start blinking yellow from any state
+    LED_EV_BLINK,
+    // Toggle blinking yellow when paused
+    LED_EV_BLINK_TOGGLE,
+    // Resume the automatic sequence from the saved color when paused or blinking
+    LED_EV_RESUME,
+    // Run a sequence, see `ledctl_run_sequence`. Not part of the transition table.
+    LED_EV_SEQUENCE,
+    LED_EV_COUNT
+};
+
+struct led_control_t;
 
 /*
-    Set yellow on, if it is not on. Otherwise set it off.
+    Work queue that runs the led engine. The engine sets up the leds and starts the automatic sequence on its own before
+    main runs, `threads_ready` from mux.h is given once it has.
 */
-void yellow(enum State *state, enum Color *color, void *);
+extern struct k_work_q led_workq;
 
 /*
-    Set green on, if it is not on. Otherwise set it off.
+    Queue an event for the led engine on the command bus. Safe to call from interrupts. The source decides the priority
+    of the event. If `done` is given, it is given by the engine after the event has been handled. Any handled event
+    stops a running sequence. An event without `done` may be coalesced with a copy of it queued right before it.
+    Returns 0 on success or -ENOMSG if the queue of its priority is full.
 */
-void green(enum State *state, enum Color *color, void *);
+int ledctl_post(enum led_event event, enum cmd_source source, struct k_sem *done);
+
+// Like `ledctl_post`, but measure the latency from `stamp` to the leds changing in the histogram of `latency`
+int ledctl_post_from(enum led_event event, enum cmd_source source, enum latency_source latency, timing_t stamp);
+
+/*
+    Run a sequence program on the led engine, see seqvm.h. Colors are held for their hold times on the engine timers.
+    While the program waits for an event a button press continues it, any other event stops it like it stops a running
+    program. `done` is given when the sequence has ended or has been stopped, and the engine does not touch `seq` after
+    that. `received` is when the sequence arrived on the UART, the first step closes its UART and dispatcher latency
+    measurements.
+*/
+int ledctl_run_sequence(const struct led_control_t *seq, struct k_sem *done, timing_t received);
+
+// Hold time of the automatic sequence and of blinking in ms. A new hold time applies from the next transition.
+uint32_t ledctl_hold_ms(void);
+void ledctl_set_hold_ms(uint32_t hold_ms);
+
+// Print the command bus counters as one CSV line: bus,<queued>,<coalesced>,<dropped>,<peak depth>
+void ledctl_print_bus_csv(void);
 
-#endif
\ No newline at end of file
+#endif
@@ -14,22 +14,22 @@
 #include "dispatcher.h"
 #include "mux.h"
 #include "debug.h"
+#include "persist.h"
 
 int main(void)
 {
     bool initval_debug = print_debug_messages;
     print_debug_messages = true;
-    // Initialize timing timer and start it. Leaving this running does not actually cost anything for us
-    timing_init();
-    timing_start();
-
+    // The led engine has started the timing functions before main. Leaving them running does not cost anything for us.
     timing_t start = timing_counter_get();
 
-    if (!init_leds()) {
+    // The led engine has already started itself, it only failed if it did not give this
+    if (k_sem_take(&threads_ready, K_NO_WAIT) != 0) {
+        debug("Error: Led engine did not start");
         return 0;
     }
-    debug("Initialized leds");
-    
+    debug("Led engine running");
+
     if (!init_buttons()) {
         return 0;
     }
@@ -40,23 +40,17 @@ int main(void)
     }
     debug("Initialized uart");
 
-    for (int i = 0; i < 3; i++) {
-        k_sem_take(&threads_ready, K_FOREVER);
-        debug("Sem: %d", i);
-        k_msleep(100);
-    }
+    // A sequence stored in flash takes over from the automatic sequence
+    const struct led_control_t *stored = persist_boot_sequence();
 
-    // Try to start the sequence until it starts. Do not block because signals are not
-    // preserved if the receiver is not listening yet.
-    debug("Trying to start a sequence");
-    k_mutex_lock(&lmux, K_FOREVER);
-    k_condvar_broadcast(&rsig);
-    k_condvar_wait(&sig_ok, &lmux, K_FOREVER);
-    k_mutex_unlock(&lmux);
+    if (stored != NULL && dispatcher_submit(stored, CMD_SRC_SYSTEM, timing_counter_get(), K_NO_WAIT) == 0) {
+        debug("Running the stored sequence");
+    }
 
-    uint64_t elapsed = timing_cycles_to_ns(timing_counter_get() - start);
-    debug("OK! Main thread done! Took: %lld ns", elapsed);
+    timing_t end = timing_counter_get();
+    stat_add(&statistics.threads.main.runtime, start, end);
+    debug("OK! Main thread done! Took: %u us", (uint32_t)(timing_cycles_to_ns(end - start) / 1000));
 
-    print_debug_messages = initval_debug;
+    print_debug_messages = persist_debug_messages(initval_debug);
     return 0;
 }
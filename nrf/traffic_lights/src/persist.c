@@ -0,0 +1,139 @@
+/* Configuration stored in flash. The whole configuration is a single settings value, so it is replaced atomically and
+ * a reset in the middle of a save leaves the previous record in place. The record carries a version and a CRC of its
+ * own on top of the checks of NVS, a record that does not match is ignored and the defaults are used.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/timing/timing.h>
+
+#include "persist.h"
+#include "ledctl.h"
+#include "debug.h"
+
+#define PERSIST_VERSION 1
+
+// Flags of the record
+#define PERSIST_DEBUG             1
+#define PERSIST_SEQUENCE          2
+
+struct persist_record_t {
+    uint8_t version;
+    uint8_t flags;
+    uint16_t hold_ms;
+    struct led_control_t sequence;
+    // CRC-32 of everything before it
+    uint32_t crc;
+} __packed;
+
+// Record read by the settings handler, only applied once the whole subtree has been loaded
+static struct persist_record_t loaded;
+static bool loaded_valid;
+// Whether the loaded record has been applied. Main prints everything while booting, it applies the debug flag after.
+static bool restored;
+
+// Sequence to run at boot and the one to store with the next save. Both are only written by the UART task after boot.
+static struct led_control_t boot_sequence;
+static bool has_boot_sequence;
+static struct led_control_t last_sequence;
+static bool has_last_sequence;
+
+static uint32_t record_crc(const struct persist_record_t *record)
+{
+    return crc32_ieee((const uint8_t *)record, offsetof(struct persist_record_t, crc));
+}
+
+static int persist_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+    if (!settings_name_steq(name, "cfg", NULL)) {
+        return -ENOENT;
+    }
+
+    if (len != sizeof(loaded) || read_cb(cb_arg, &loaded, sizeof(loaded)) != sizeof(loaded)) {
+        debug("Stored configuration has the wrong size, using defaults");
+        return 0;
+    }
+
+    if (loaded.version != PERSIST_VERSION || loaded.crc != record_crc(&loaded) ||
+        loaded.sequence.len > SEQ_PROGRAM_SIZE || loaded.hold_ms == 0) {
+        debug("Stored configuration is corrupted, using defaults");
+        return 0;
+    }
+
+    loaded_valid = true;
+    return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(traffic_lights, "tl", NULL, persist_set, NULL, NULL);
+
+bool persist_restore(void)
+{
+    timing_t start = timing_counter_get();
+
+    loaded_valid = false;
+    restored = false;
+    has_boot_sequence = false;
+
+    if (settings_subsys_init() != 0 || settings_load_subtree("tl") != 0) {
+        debug("Error: Failed to read the stored configuration");
+        return false;
+    }
+
+    if (loaded_valid) {
+        ledctl_set_hold_ms(loaded.hold_ms);
+
+        has_boot_sequence = (loaded.flags & PERSIST_SEQUENCE) != 0;
+        boot_sequence = loaded.sequence;
+        last_sequence = loaded.sequence;
+        has_last_sequence = has_boot_sequence;
+        restored = true;
+    }
+
+    stat_add(&statistics.boot.restore, start, timing_counter_get());
+    return true;
+}
+
+void persist_set_sequence(const struct led_control_t *seq)
+{
+    last_sequence = *seq;
+    has_last_sequence = true;
+}
+
+int persist_save(void)
+{
+    struct persist_record_t record = {
+        .version = PERSIST_VERSION,
+        .flags = (print_debug_messages ? PERSIST_DEBUG : 0) | (has_last_sequence ? PERSIST_SEQUENCE : 0),
+        .hold_ms = ledctl_hold_ms(),
+    };
+
+    if (has_last_sequence) {
+        record.sequence = last_sequence;
+    }
+
+    record.crc = record_crc(&record);
+
+    // NVS compares with the stored record and skips the write when nothing has changed
+    return settings_save_one("tl/cfg", &record, sizeof(record));
+}
+
+int persist_forget(void)
+{
+    has_last_sequence = false;
+    return settings_delete("tl/cfg");
+}
+
+const struct led_control_t *persist_boot_sequence(void)
+{
+    return has_boot_sequence ? &boot_sequence : NULL;
+}
+
+bool persist_debug_messages(bool fallback)
+{
+    return restored ? (loaded.flags & PERSIST_DEBUG) != 0 : fallback;
+}
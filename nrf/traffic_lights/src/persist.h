@@ -0,0 +1,74 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "seqvm.h"
+
+/*
+    Configuration kept in flash across reboots: the hold time of the automatic sequence, the debug flag and a sequence
+    that runs at boot. It is stored with the settings subsystem on NVS as one CRC-checked record, NVS appends every
+    write and rotates through the sectors of the storage partition, so saving does not wear out a single page.
+*/
+
+#ifdef CONFIG_TRAFFIC_LIGHTS_PERSIST
+
+/*
+    Load the stored configuration and apply it. Called by the led engine before it reports ready, so main and the other
+    tasks start with the restored configuration. A missing or corrupted record leaves the defaults in place. Returns
+    false if the storage could not be read at all.
+*/
+bool persist_restore(void);
+
+// Remember a sequence to store with the next `persist_save`. The last sequence received is the one that is kept.
+void persist_set_sequence(const struct led_control_t *seq);
+
+// Store the current configuration. Returns 0 on success or a negative error code of the settings subsystem.
+int persist_save(void);
+
+// Delete the stored configuration, the next boot uses the defaults
+int persist_forget(void);
+
+// Sequence restored from flash to run at boot, NULL if there is none
+const struct led_control_t *persist_boot_sequence(void);
+
+// Debug flag restored from flash, `fallback` if there was no stored configuration
+bool persist_debug_messages(bool fallback);
+
+#else
+
+static inline bool persist_restore(void)
+{
+    return true;
+}
+
+static inline void persist_set_sequence(const struct led_control_t *seq)
+{
+}
+
+static inline int persist_save(void)
+{
+    return -ENOTSUP;
+}
+
+static inline int persist_forget(void)
+{
+    return -ENOTSUP;
+}
+
+static inline const struct led_control_t *persist_boot_sequence(void)
+{
+    return NULL;
+}
+
+static inline bool persist_debug_messages(bool fallback)
+{
+    return fallback;
+}
+
+#endif // CONFIG_TRAFFIC_LIGHTS_PERSIST
+
+#endif // PERSIST_H
@@ -0,0 +1,135 @@
+#include <string.h>
+#include "robolink.h"
+
+// Offsets of the header bytes in a decoded frame
+#define FRAME_ID 0
+#define FRAME_COMMAND 1
+#define FRAME_LEN 2
+#define FRAME_PAYLOAD 3
+
+uint16_t rl_crc16(const uint8_t *data, size_t len) {
+	uint16_t crc = 0xffff;
+
+	for (size_t i = 0; i < len; i++) {
+		crc ^= (uint16_t)data[i] << 8;
+
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+		}
+	}
+
+	return crc;
+}
+
+void rl_decoder_init(struct rl_decoder_t *dec) {
+	memset(dec, 0, sizeof(*dec));
+}
+
+static void append(struct rl_decoder_t *dec, uint8_t byte) {
+	if (dec->len < sizeof(dec->buf)) {
+		dec->buf[dec->len++] = byte;
+	} else {
+		dec->overflow = true;
+	}
+}
+
+// Check a whole decoded frame and copy it out
+static int finish(const struct rl_decoder_t *dec, struct rl_frame_t *frame) {
+	if (dec->overflow || dec->left != 0 || dec->len < RL_OVERHEAD) return RL_ERR_FRAME;
+
+	uint32_t len = dec->buf[FRAME_LEN];
+
+	if (len > RL_PAYLOAD_MAX || dec->len != len + RL_OVERHEAD) return RL_ERR_LEN;
+
+	uint16_t crc = dec->buf[dec->len - 2] | (uint16_t)(dec->buf[dec->len - 1] << 8);
+
+	if (crc != rl_crc16(dec->buf, dec->len - 2)) return RL_ERR_CRC;
+
+	frame->id = dec->buf[FRAME_ID];
+	frame->command = dec->buf[FRAME_COMMAND];
+	frame->len = (uint8_t)len;
+	memcpy(frame->payload, &dec->buf[FRAME_PAYLOAD], len);
+	return RL_FRAME;
+}
+
+int rl_decode_feed(struct rl_decoder_t *dec, uint8_t byte, struct rl_frame_t *frame) {
+	if (byte == 0) {
+		// Nothing at all between two delimiters is not a frame, only a resynchronization
+		bool empty = dec->len == 0 && dec->left == 0 && !dec->zero && !dec->overflow;
+		int ret = empty ? RL_NONE : finish(dec, frame);
+
+		rl_decoder_init(dec);
+		return ret;
+	}
+
+	if (dec->left > 0) {
+		append(dec, byte);
+		dec->left--;
+		return RL_NONE;
+	}
+
+	// A code byte: the zero the previous block ended with comes first, the zero of the last block is not data
+	if (dec->zero) append(dec, 0);
+
+	dec->left = byte - 1;
+	dec->zero = byte != 0xff;
+	return RL_NONE;
+}
+
+size_t rl_encode(const struct rl_frame_t *frame, uint8_t *out) {
+	uint8_t raw[RL_PAYLOAD_MAX + RL_OVERHEAD];
+	size_t len = (size_t)frame->len + RL_OVERHEAD;
+
+	raw[FRAME_ID] = frame->id;
+	raw[FRAME_COMMAND] = frame->command;
+	raw[FRAME_LEN] = frame->len;
+	memcpy(&raw[FRAME_PAYLOAD], frame->payload, frame->len);
+
+	uint16_t crc = rl_crc16(raw, len - 2);
+
+	raw[len - 2] = (uint8_t)crc;
+	raw[len - 1] = (uint8_t)(crc >> 8);
+
+	size_t n = 0;
+
+	out[n++] = 0;
+
+	// Every block starts with a code byte telling how far the next zero is, or 0xff for 254 bytes without one
+	size_t code_at = n++;
+	uint8_t code = 1;
+
+	for (size_t i = 0; i < len; i++) {
+		if (raw[i] != 0) {
+			out[n++] = raw[i];
+			code++;
+		}
+
+		if (raw[i] == 0 || code == 0xff) {
+			out[code_at] = code;
+			code_at = n++;
+			code = 1;
+		}
+	}
+
+	out[code_at] = code;
+	out[n++] = 0;
+	return n;
+}
+
+void rl_respond(struct rl_frame_t *response, const struct rl_frame_t *request, uint8_t status, int32_t result) {
+	response->id = request->id;
+	response->command = request->command | RL_RESPONSE;
+	response->len = 1;
+	response->payload[0] = status;
+	rl_put_u32(response, (uint32_t)result);
+}
+
+bool rl_put_u32(struct rl_frame_t *frame, uint32_t value) {
+	if (frame->len + 4 > RL_PAYLOAD_MAX) return false;
+
+	for (int i = 0; i < 4; i++) {
+		frame->payload[frame->len++] = (uint8_t)(value >> (8 * i));
+	}
+
+	return true;
+}
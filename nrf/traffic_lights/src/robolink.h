@@ -0,0 +1,133 @@
+#ifndef ROBOLINK_H
+#define ROBOLINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+    Binary protocol of the robot test interface. Every request and response is one frame:
+
+        id | command | len | payload (len bytes) | CRC-16 (little endian)
+
+    The CRC is CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xffff) over everything before it. The frame is
+    COBS encoded and ends with a zero byte, so a zero byte always ends a frame and a receiver that lost track of the
+    stream finds the next frame after the next zero. Frames without a single byte between two zeros are ignored, the
+    device sends a zero before every response to cut off any text that was printed in between.
+
+    The response to a request has the same id and command with RL_RESPONSE set, its payload starts with a status
+    byte and a signed 32-bit result, little endian, followed by data of the command. Requests are answered in the order
+    they arrive, so a host may send many of them before reading the responses.
+*/
+
+// Largest payload of a frame
+#define RL_PAYLOAD_MAX 64
+// Bytes of a frame around the payload: id, command, len and the CRC
+#define RL_OVERHEAD 5
+// Largest encoded frame: one COBS code byte per 254 bytes, the delimiters before and after it
+#define RL_ENCODED_MAX (RL_PAYLOAD_MAX + RL_OVERHEAD + (RL_PAYLOAD_MAX + RL_OVERHEAD) / 254 + 1 + 2)
+
+// Commands
+// Answer with the payload of the request, to check the link
+#define RL_CMD_PING               0
+// Compile a light sequence given as text like on the command line and run it
+#define RL_CMD_SEQUENCE           1
+// Parse a time given as text, the result is the seconds or the negative error flags of `time_parse`. The data is one
+// unsigned 32-bit value, 1 for a time of day given with a leading '@' and 0 otherwise.
+#define RL_CMD_TIME               2
+// Read counters, the data is RL_STAT_COUNT unsigned 32-bit values, little endian
+#define RL_CMD_STATS              3
+// Toggle the debug messages, the result is the new state. Debug output stays off while the link is in use.
+#define RL_CMD_DEBUG              4
+// Answer and go back to the text command line
+#define RL_CMD_CLOSE              5
+
+// Set in the command of a response
+#define RL_RESPONSE               0x80
+
+// Status of a response
+#define RL_STATUS_OK              0
+// The command is not known
+#define RL_STATUS_UNKNOWN         1
+// The command was understood, but failed. The result tells why.
+#define RL_STATUS_ERROR           2
+// No room to queue the command, try again later
+#define RL_STATUS_BUSY            3
+
+// Bytes of a response payload before the data of the command
+#define RL_RESULT_SIZE 5
+
+// Counters of RL_CMD_STATS in their order
+enum rl_stat {
+    RL_STAT_RED_TOGGLED,
+    RL_STAT_YELLOW_TOGGLED,
+    RL_STAT_GREEN_TOGGLED,
+    RL_STAT_BUTTONS_PUSHED,
+    RL_STAT_DEBUG_DROPPED,
+    RL_STAT_DEBUG_PEAK_DEPTH,
+    RL_STAT_UART_DROPPED,
+    RL_STAT_BAD_FRAMES,
+    RL_STAT_COUNT
+};
+
+// Return codes of `rl_decode_feed`
+// More bytes are needed
+#define RL_NONE                   0
+// A frame has been decoded
+#define RL_FRAME                  1
+// The bytes before the delimiter were not valid COBS, were too long or were too short for a frame
+#define RL_ERR_FRAME              (-1)
+// The length byte does not match the length of the frame
+#define RL_ERR_LEN                (-2)
+// The CRC does not match
+#define RL_ERR_CRC                (-3)
+
+struct rl_frame_t {
+    uint8_t id;
+    uint8_t command;
+    uint8_t len;
+    uint8_t payload[RL_PAYLOAD_MAX];
+};
+
+// Decoder state, fed one received byte at a time
+struct rl_decoder_t {
+    uint8_t buf[RL_PAYLOAD_MAX + RL_OVERHEAD];
+    uint32_t len;
+    // Bytes left in the current COBS block and whether a zero follows it
+    uint8_t left;
+    bool zero;
+    bool overflow;
+};
+
+void rl_decoder_init(struct rl_decoder_t *dec);
+
+/*
+    Feed one received byte. Returns RL_FRAME with the frame in `frame` when a delimiter ends a valid frame, RL_NONE
+    while the frame is not complete or when it was empty, or one of the errors when the frame is broken. The decoder
+    is ready for the next frame after any return code.
+*/
+int rl_decode_feed(struct rl_decoder_t *dec, uint8_t byte, struct rl_frame_t *frame);
+
+/*
+    Encode a frame with a delimiter before and after it. Returns the number of bytes written to `out`, which must hold
+    RL_ENCODED_MAX bytes.
+*/
+size_t rl_encode(const struct rl_frame_t *frame, uint8_t *out);
+
+// Start a response to `request` with a status and a result, data is appended with `rl_put_u32`
+void rl_respond(struct rl_frame_t *response, const struct rl_frame_t *request, uint8_t status, int32_t result);
+
+// Append a little endian value to the payload, returns false if it does not fit
+bool rl_put_u32(struct rl_frame_t *frame, uint32_t value);
+
+uint16_t rl_crc16(const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ROBOLINK_H
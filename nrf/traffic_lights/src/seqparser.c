@@ -0,0 +1,285 @@
+#include <string.h>
+#include "seqparser.h"
+
+void seq_parser_init(struct seq_parser_t *parser) {
+	memset(parser, 0, sizeof(*parser));
+	parser->hold = SEQ_DEFAULT_HOLD_MS;
+	parser->groups[0].hold = SEQ_DEFAULT_HOLD_MS;
+	parser->loop = 1;
+}
+
+// Make room for `size` bytes at `at`, moving the code after it. Returns false and flags the sequence if it is full.
+static bool reserve(struct seq_parser_t *parser, int at, int size) {
+	struct led_control_t *ctl = &parser->ctl;
+
+	if (parser->flags & FLAG_SEQ_LEN) return false;
+
+	if (ctl->len + size > SEQ_PROGRAM_SIZE) {
+		parser->flags |= FLAG_SEQ_LEN;
+		return false;
+	}
+
+	memmove(&ctl->code[at + size], &ctl->code[at], ctl->len - at);
+	ctl->len += size;
+	return true;
+}
+
+// Insert a HOLD at `at` unless the hold time there already is `hold`
+static void emit_hold(struct seq_parser_t *parser, int at, uint16_t hold) {
+	uint8_t *code = parser->ctl.code;
+
+	if (hold == parser->hold) return;
+	parser->hold = hold;
+
+	if (hold != 0 && hold % 100 == 0 && hold <= SEQ_HOLD_SHORT_MS) {
+		if (reserve(parser, at, 1)) code[at] = SEQ_INSN(SEQ_OP_HOLD, hold / 100);
+	} else if (reserve(parser, at, 3)) {
+		code[at] = SEQ_INSN(SEQ_OP_HOLD, 0);
+		code[at + 1] = hold & 0xff;
+		code[at + 2] = hold >> 8;
+	}
+}
+
+static void emit(struct seq_parser_t *parser, const uint8_t *insn, int size) {
+	int at = parser->ctl.len;
+
+	if (reserve(parser, at, size)) memcpy(&parser->ctl.code[at], insn, size);
+}
+
+// Give the colors waiting for a hold time `hold`, the HOLD goes in front of them
+static void resolve(struct seq_parser_t *parser, uint16_t hold) {
+	if (parser->pending < parser->ctl.len) emit_hold(parser, parser->pending, hold);
+	parser->pending = parser->ctl.len;
+}
+
+// Run the body of the group at `level` `count` times in total, counting the runs in the loop slot of the level
+static void emit_loop(struct seq_parser_t *parser, int level, uint32_t count) {
+	struct seq_group_t *group = &parser->groups[level];
+
+	if (count == 0) parser->flags |= FLAG_SEQ_LOOP;
+
+	if (count > 1) {
+		// Every run of the body has to start with the hold time of the first run
+		emit_hold(parser, parser->ctl.len, group->hold);
+
+		const uint8_t loop[] = { SEQ_INSN(SEQ_OP_LOOP, level), count & 0xff, count >> 8, group->start };
+		emit(parser, loop, sizeof(loop));
+	}
+
+	parser->pending = parser->ctl.len;
+}
+
+// Repeat the innermost group `count` times in total and go back to its parent
+static void close_group(struct seq_parser_t *parser, uint32_t count) {
+	emit_loop(parser, parser->depth, count);
+	parser->depth--;
+	parser->groups[parser->depth].steps++;
+}
+
+// Apply the accumulated digits to the loop count, the count of a group or the colors waiting for a hold time
+static void end_digits(struct seq_parser_t *parser) {
+	if (parser->in_count) {
+		parser->in_count = false;
+
+		if (!parser->in_digits) {
+			// A group without a count
+			parser->flags |= FLAG_SEQ_LOOP;
+			close_group(parser, 1);
+			return;
+		}
+
+		parser->in_digits = false;
+		close_group(parser, parser->value);
+		return;
+	}
+
+	if (!parser->in_digits) return;
+
+	parser->in_digits = false;
+
+	if (parser->in_loop) {
+		if (parser->value == 0) parser->flags |= FLAG_SEQ_LOOP;
+		parser->loop = (uint16_t)parser->value;
+		return;
+	}
+
+	if (parser->pending == parser->ctl.len) {
+		// No color to apply the time to
+		parser->flags |= FLAG_SEQ_SYNTAX;
+		return;
+	}
+
+	resolve(parser, (uint16_t)parser->value);
+}
+
+// Anything but a color or a time ends the run of colors before it. Returns false if the sequence has already ended.
+static bool end_colors(struct seq_parser_t *parser) {
+	end_digits(parser);
+
+	if (parser->in_loop) {
+		// Nothing is allowed after the loop count
+		parser->flags |= FLAG_SEQ_SYNTAX;
+		return false;
+	}
+
+	resolve(parser, SEQ_DEFAULT_HOLD_MS);
+	return true;
+}
+
+static int end_line(struct seq_parser_t *parser, struct led_control_t *out) {
+	end_digits(parser);
+	resolve(parser, SEQ_DEFAULT_HOLD_MS);
+
+	if (parser->depth > 0) {
+		// Group left open
+		parser->flags |= FLAG_SEQ_SYNTAX;
+	}
+
+	if (parser->in_loop) {
+		// T without a count
+		if (parser->loop == 0) parser->flags |= FLAG_SEQ_LOOP;
+		// Nothing to loop over
+		if (parser->groups[0].steps == 0) parser->flags |= FLAG_SEQ_SYNTAX;
+	}
+
+	int flags = parser->flags;
+	bool empty = parser->ctl.len == 0 && !parser->in_loop;
+
+	if (flags == 0 && empty) {
+		seq_parser_init(parser);
+		return SEQ_MORE;
+	}
+
+	if (flags == 0 && parser->loop > 1) {
+		emit_loop(parser, 0, parser->loop);
+		flags = parser->flags;
+	}
+
+	if (flags == 0) *out = parser->ctl;
+
+	seq_parser_init(parser);
+	return flags == 0 ? SEQ_READY : ERR_SEQ(flags);
+}
+
+int seq_parser_feed(struct seq_parser_t *parser, char c, struct led_control_t *out) {
+	switch (c) {
+		case '\n':
+		case '\r':
+			return end_line(parser, out);
+
+		case '0': case '1': case '2': case '3': case '4':
+		case '5': case '6': case '7': case '8': case '9':
+			if (!parser->in_digits) {
+				parser->in_digits = true;
+				parser->value = 0;
+			}
+
+			parser->value = parser->value * 10 + (uint32_t)(c - '0');
+
+			// Saturate so that a long run of digits can not wrap around into a valid value
+			if (parser->value > UINT16_MAX) {
+				parser->flags |= FLAG_SEQ_VALUE;
+				parser->value = UINT16_MAX;
+			}
+			break;
+
+		case 'R':
+		case 'Y':
+		case 'G':
+		case 'O': {
+			static const uint8_t colors[] = {
+				['O' - 'G'] = SEQ_COLOR_OFF, ['R' - 'G'] = SEQ_COLOR_RED,
+				['Y' - 'G'] = SEQ_COLOR_YELLOW, ['G' - 'G'] = SEQ_COLOR_GREEN,
+			};
+			uint8_t set = SEQ_INSN(SEQ_OP_SET, colors[c - 'G']);
+
+			end_digits(parser);
+
+			if (parser->in_loop) {
+				// Colors are not allowed after the loop count
+				parser->flags |= FLAG_SEQ_SYNTAX;
+				break;
+			}
+
+			emit(parser, &set, 1);
+			parser->groups[parser->depth].steps++;
+			break;
+		}
+
+		case 'W': {
+			const uint8_t wait = SEQ_INSN(SEQ_OP_WAIT, SEQ_WAIT_ANY);
+
+			if (!end_colors(parser)) break;
+
+			emit(parser, &wait, 1);
+			parser->pending = parser->ctl.len;
+			parser->groups[parser->depth].steps++;
+			break;
+		}
+
+		case '(':
+			if (!end_colors(parser)) break;
+
+			if (parser->depth >= SEQ_MAX_DEPTH) {
+				parser->flags |= FLAG_SEQ_LOOP;
+				break;
+			}
+
+			parser->depth++;
+			parser->groups[parser->depth] = (struct seq_group_t){
+				.start = parser->ctl.len, .hold = parser->hold, .steps = 0
+			};
+			break;
+
+		case ')':
+			if (!end_colors(parser)) break;
+
+			if (parser->depth == 0 || parser->groups[parser->depth].steps == 0) {
+				parser->flags |= FLAG_SEQ_SYNTAX;
+				break;
+			}
+
+			parser->in_count = true;
+			break;
+
+		case '*': {
+			struct seq_group_t *group = &parser->groups[parser->depth];
+
+			if (!parser->in_count || parser->in_digits) {
+				parser->flags |= FLAG_SEQ_SYNTAX;
+				break;
+			}
+
+			parser->in_count = false;
+			emit_hold(parser, parser->ctl.len, group->hold);
+
+			const uint8_t jump[] = { SEQ_INSN(SEQ_OP_JUMP, 0), group->start };
+			emit(parser, jump, sizeof(jump));
+
+			parser->pending = parser->ctl.len;
+			parser->depth--;
+			parser->groups[parser->depth].steps++;
+			break;
+		}
+
+		case 'T':
+			end_digits(parser);
+
+			if (parser->in_loop) {
+				parser->flags |= FLAG_SEQ_LOOP;
+			} else if (parser->depth > 0) {
+				parser->flags |= FLAG_SEQ_SYNTAX;
+			} else {
+				resolve(parser, SEQ_DEFAULT_HOLD_MS);
+				parser->in_loop = true;
+				parser->loop = 0;
+			}
+			break;
+
+		default:
+			parser->flags |= FLAG_SEQ_SYNTAX;
+			break;
+	}
+
+	return SEQ_MORE;
+}
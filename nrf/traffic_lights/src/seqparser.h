@@ -0,0 +1,88 @@
+#ifndef SEQPARSER_H
+#define SEQPARSER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "seqvm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Return codes and flags of `seq_parser_feed`. Errors are only reported at the end of the line so that the rest of
+// an erroneous line is swallowed by the parser.
+
+// The parser needs more input
+#define SEQ_MORE                  0
+// A complete sequence has been written to the output
+#define SEQ_READY                 1
+
+// Signals an unexpected character, a hold time without a color or unbalanced or empty groups
+#define FLAG_SEQ_SYNTAX           1
+// Signals that the compiled sequence does not fit in SEQ_PROGRAM_SIZE bytes
+#define FLAG_SEQ_LEN              2
+// Signals a hold time that does not fit in 16 bits
+#define FLAG_SEQ_VALUE            4
+// Signals a repeated, empty or zero loop count or groups nested deeper than SEQ_MAX_DEPTH
+#define FLAG_SEQ_LOOP             8
+
+// Convert OR'd flags into error. Keeps syntax and intent clear.
+#define ERR_SEQ(flags) (-(flags))
+
+// A group of the sequence being compiled
+struct seq_group_t {
+    // Where the body starts in the code
+    uint8_t start;
+    // Hold time in effect when the body starts
+    uint16_t hold;
+    // Colors, waits and groups in the body
+    uint16_t steps;
+};
+
+/*
+    State of the streaming sequence compiler. The grammar is `[ITEM..INT]..[T INT]` terminated by a newline, where an
+    ITEM is one of
+
+        R | Y | G | O       a color
+        W                   wait for a button press
+        (ITEM..)INT         a group run INT times in total, groups nest up to SEQ_MAX_DEPTH deep
+        (ITEM..)*           a group run until another event stops the sequence
+
+    A time applies to every color preceding it that has no time yet, colors followed by anything but a time hold the
+    default time. T gives the loop count of the whole sequence. The colors are compiled into SET steps, and HOLD is
+    emitted only when the hold time changes, so a step usually takes a single byte.
+*/
+struct seq_parser_t {
+    struct led_control_t ctl;
+    // Offset of the first color still waiting for its hold time
+    int pending;
+    // Hold time in effect at the end of the code
+    uint16_t hold;
+    // Open groups, level 0 is the whole sequence
+    struct seq_group_t groups[SEQ_MAX_DEPTH + 1];
+    int depth;
+    // Digits accumulated so far
+    uint32_t value;
+    bool in_digits;
+    // A group has been closed and waits for its count
+    bool in_count;
+    bool in_loop;
+    uint16_t loop;
+    int flags;
+};
+
+void seq_parser_init(struct seq_parser_t *parser);
+
+/*
+    Feed one character to the parser. Returns SEQ_READY and fills `out` at the end of a valid line, ERR_SEQ(flags) at the
+    end of an invalid line and SEQ_MORE otherwise. Empty lines are ignored. The parser is ready for the next line after
+    returning anything but SEQ_MORE.
+*/
+int seq_parser_feed(struct seq_parser_t *parser, char c, struct led_control_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
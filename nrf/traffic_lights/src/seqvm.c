@@ -0,0 +1,77 @@
+#include <string.h>
+#include "seqvm.h"
+
+/*
+    A valid program reaches a step within two passes over its code: every loop body holds a step, so at most the rest of
+    the program and the start of a loop body are run between two steps.
+*/
+#define STEP_BUDGET (2 * SEQ_PROGRAM_SIZE)
+
+void seq_vm_init(struct seq_vm_t *vm, const struct led_control_t *prog) {
+	memset(vm, 0, sizeof(*vm));
+	vm->prog = prog;
+	vm->hold_ms = SEQ_DEFAULT_HOLD_MS;
+}
+
+int seq_vm_run(struct seq_vm_t *vm, struct seq_step_t *step) {
+	const uint8_t *code = vm->prog->code;
+	uint32_t len = vm->prog->len;
+	uint32_t pc = vm->pc;
+
+	if (len > SEQ_PROGRAM_SIZE) return SEQ_VM_ERROR;
+
+	for (int budget = STEP_BUDGET; pc < len; budget--) {
+		if (budget == 0) return SEQ_VM_ERROR;
+
+		uint8_t arg = code[pc] & SEQ_ARG_MASK;
+
+		switch (code[pc++] >> SEQ_OP_SHIFT) {
+			case SEQ_OP_SET:
+				if (arg > SEQ_COLOR_GREEN) return SEQ_VM_ERROR;
+
+				vm->pc = pc;
+				step->color = arg;
+				step->hold_ms = vm->hold_ms;
+				return SEQ_VM_SET;
+
+			case SEQ_OP_HOLD:
+				if (arg != 0) {
+					vm->hold_ms = arg * 100;
+					break;
+				}
+
+				if (pc + 2 > len) return SEQ_VM_ERROR;
+				vm->hold_ms = code[pc] | code[pc + 1] << 8;
+				pc += 2;
+				break;
+
+			case SEQ_OP_LOOP:
+				if (pc + 3 > len || arg >= SEQ_LOOP_SLOTS || code[pc + 2] >= len) return SEQ_VM_ERROR;
+
+				// The counter is back to zero after the last run, ready for the next time the loop is entered
+				if (++vm->counters[arg] < (code[pc] | code[pc + 1] << 8)) {
+					pc = code[pc + 2];
+				} else {
+					vm->counters[arg] = 0;
+					pc += 3;
+				}
+				break;
+
+			case SEQ_OP_JUMP:
+				if (pc + 1 > len || code[pc] >= len) return SEQ_VM_ERROR;
+				pc = code[pc];
+				break;
+
+			case SEQ_OP_WAIT:
+				vm->pc = pc;
+				step->event = arg;
+				return SEQ_VM_WAIT;
+
+			default:
+				return SEQ_VM_ERROR;
+		}
+	}
+
+	vm->pc = pc;
+	return SEQ_VM_END;
+}
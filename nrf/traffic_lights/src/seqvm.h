@@ -0,0 +1,101 @@
+#ifndef SEQVM_H
+#define SEQVM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bytes of bytecode in one sequence program. Jump targets are one byte, so at most 256.
+#define SEQ_PROGRAM_SIZE 64
+
+// Groups that can be nested inside each other. Every level has a loop counter of its own, level 0 is the whole program.
+#define SEQ_MAX_DEPTH 3
+#define SEQ_LOOP_SLOTS (SEQ_MAX_DEPTH + 1)
+
+// Hold time in effect when a program starts
+#define SEQ_DEFAULT_HOLD_MS 1000
+
+/*
+    A sequence compiled into bytecode by the sequence parser. Every instruction starts with one byte holding the opcode
+    in the top three bits and a small argument in the low five bits, some are followed by operand bytes:
+
+        SET color           1 byte    show a color and wait the current hold time, this is one step
+        HOLD ms             1 byte    arg 1..31 sets the hold time to arg * 100 ms
+                            3 bytes   arg 0 sets it to the 16 bit little endian operand
+        LOOP slot n target  4 bytes   run the body starting at `target` n times in total, counted in `slot`
+        JUMP target         2 bytes   continue at `target`
+        WAIT event          1 byte    stop until `event` is posted, SEQ_WAIT_ANY for any button
+
+    A program ends after its last instruction.
+*/
+struct led_control_t {
+    uint8_t len;
+    uint8_t code[SEQ_PROGRAM_SIZE];
+};
+
+enum seq_op {
+    SEQ_OP_SET,
+    SEQ_OP_HOLD,
+    SEQ_OP_LOOP,
+    SEQ_OP_JUMP,
+    SEQ_OP_WAIT,
+};
+
+#define SEQ_OP_SHIFT 5
+#define SEQ_ARG_MASK 0x1f
+#define SEQ_INSN(op, arg) ((uint8_t)(((op) << SEQ_OP_SHIFT) | (arg)))
+
+// Colors of SET, the same values as `enum Color` of the led engine
+#define SEQ_COLOR_OFF             0
+#define SEQ_COLOR_RED             1
+#define SEQ_COLOR_YELLOW          2
+#define SEQ_COLOR_GREEN           3
+
+// Longest hold time that fits the short form of HOLD
+#define SEQ_HOLD_SHORT_MS (SEQ_ARG_MASK * 100)
+
+#define SEQ_WAIT_ANY SEQ_ARG_MASK
+
+// Return codes of `seq_vm_run`
+// The program has ended
+#define SEQ_VM_END                0
+// Show `color` for `hold_ms`
+#define SEQ_VM_SET                1
+// Wait for `event` before running again
+#define SEQ_VM_WAIT               2
+// The bytecode is broken, stop running it
+#define SEQ_VM_ERROR              (-1)
+
+struct seq_step_t {
+    uint8_t color;
+    uint8_t event;
+    uint16_t hold_ms;
+};
+
+struct seq_vm_t {
+    const struct led_control_t *prog;
+    uint16_t pc;
+    uint16_t hold_ms;
+    uint16_t counters[SEQ_LOOP_SLOTS];
+};
+
+void seq_vm_init(struct seq_vm_t *vm, const struct led_control_t *prog);
+
+/*
+    Run the program up to its next step and describe the step in `step`. Returns SEQ_VM_SET or SEQ_VM_WAIT for a step,
+    SEQ_VM_END at the end of the program and SEQ_VM_ERROR for bytecode that is malformed or runs too long without a step.
+*/
+int seq_vm_run(struct seq_vm_t *vm, struct seq_step_t *step);
+
+static inline bool seq_vm_done(const struct seq_vm_t *vm) {
+    return vm->pc >= vm->prog->len;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
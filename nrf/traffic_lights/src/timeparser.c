@@ -1,9 +1,22 @@
-#include <zephyr/kernel.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 #include <ctype.h>
 #include "timeparser.h"
 
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The word at a time time parser expects a little endian target"
+#endif
+
+// One byte value repeated in every byte of a word
+#define BYTES(b) (0x0101010101010101ULL * (b))
+// The six bytes of a time, the two bytes above them are never set
+#define TIME_BYTES 0x0000ffffffffffffULL
+// High bit of the bytes of a word that are `b`, and maybe of bytes above them, which is fine for telling if there are any
+#define HAS_BYTE(word, b) ((((word) ^ BYTES(b)) - BYTES(0x01)) & ~((word) ^ BYTES(b)) & BYTES(0x80))
+
 // time format: HHMMSS (6 characters)
-int time_parse(char *time) {
+int time_parse_scalar(const char *time) {
 
 	// how many seconds, default returns error
 	int seconds = 0;
@@ -16,8 +29,7 @@ int time_parse(char *time) {
 	len = strlen(time);
 	// Check for length correctness but do not return yet
 	if (len != 6) {
-		return ERR_TIME(FLAG_TIME_LEN);
-		// seconds |= FLAG_TIME_LEN;
+		seconds |= FLAG_TIME_LEN;
 	}
 
 	// Check that input contains only digits (ASCII characters between 0x2f and 0x3a exclusive)
@@ -73,3 +85,322 @@ int time_parse(char *time) {
 	// Return error flags or seconds
 	return iserr ? ERR_TIME(seconds) : values[0] * 3600 + values[1] * 60 + values[2];
 }
+
+// Every other format, and HHMMSS with a character that is not a digit, go through the format recognizer
+static int parse_formats(const char *time) {
+	struct time_stream_t ctx;
+
+	time_parse_init(&ctx);
+	for (; *time != '\0'; time++) time_parse_feed(&ctx, *time);
+	return time_parse_finish(&ctx);
+}
+
+/*
+    Six characters are checked and converted as one word. Unless they are in another format the result is the same as
+    from `time_parse_scalar`, bit for bit, for a string of any length: like there, the fields of a string of the wrong
+    length are still checked as far as it has them, and a character after the sixth that is not a digit is a syntax
+    error. The string is never read past its terminator.
+*/
+int time_parse(const char *time) {
+	if (time == NULL) return ERR_TIME(FLAG_TIME_LEN);
+
+	int len = 0;
+
+	while (len < 6 && time[len] != '\0') len++;
+
+	uint64_t word = 0;
+
+	if (len == 6) {
+		// The first hour digit is the lowest byte. Memcpy keeps the loads legal for any alignment, and the two loads
+		// are combined in registers because reading them back through memory as one word would stall the load.
+		uint32_t head;
+		uint16_t tail;
+		memcpy(&head, time, 4);
+		memcpy(&tail, time + 4, 2);
+		word = head | ((uint64_t)tail << 32);
+	} else {
+		memcpy(&word, time, len);
+	}
+
+	// The bytes past the end of a short string and the unused bytes read as '0' so that they pass as digits
+	word |= BYTES('0') & ~(TIME_BYTES >> (8 * (6 - len)));
+
+	// High bit of every byte that is not '0'..'9'. Without their own high bit bytes can not carry into each other.
+	uint64_t low = word & BYTES(0x7f);
+	uint64_t bad = (word | (low + BYTES(0x7f - '9')) | ~(low + BYTES(0x80 - '0'))) & BYTES(0x80);
+
+	// Characters that are not all digits may still be in another format, like 10h30m, if they have one of its
+	// characters. Every format has one in its first six characters. Otherwise they get the same flags as from the
+	// scalar parser.
+	if (bad != 0 && (HAS_BYTE(word, ':') | HAS_BYTE(word, '@') | HAS_BYTE(word, 'h') | HAS_BYTE(word, 'm') |
+			HAS_BYTE(word, 's')) != 0) {
+		return parse_formats(time);
+	}
+
+	int flags = (len != 6) * FLAG_TIME_LEN;
+
+	// The characters after the sixth are only checked for being digits
+	if (len == 6 && time[6] != '\0') {
+		flags = FLAG_TIME_LEN;
+
+		for (const char *c = time + 6; *c != '\0'; c++) {
+			if ((uint8_t)(*c - '0') > 9) {
+				flags |= FLAG_TIME_SYNTAX;
+				break;
+			}
+		}
+	}
+
+	// Digit values. The bytes that are not digits are replaced with '0' first, so they count as zero like the scalar
+	// parser skips them and the subtraction can not borrow from the next byte.
+	uint64_t bad_bytes = (bad >> 7) * 0xff;
+	uint64_t digits = ((word & ~bad_bytes) | (BYTES('0') & bad_bytes)) - BYTES('0');
+
+	// Tens digit times ten plus the ones digit of each field, in bytes 0, 2 and 4
+	uint64_t fields = (digits * 10 + (digits >> 8)) & 0x000000ff00ff00ffULL;
+	uint32_t hours = (uint32_t)fields & 0xff;
+	uint32_t minutes = (uint32_t)(fields >> 16) & 0xff;
+	uint32_t secs = (uint32_t)(fields >> 32) & 0xff;
+
+	// Merge the two bytes of each field into the lower one to see which fields have a bad character
+	uint64_t bad_fields = bad | (bad >> 8);
+
+	flags |= (bad != 0) * FLAG_TIME_SYNTAX;
+	flags |= ((bad_fields & 0x80) != 0 || hours > 23) * FLAG_TIME_VALUE_HOUR;
+	flags |= ((bad_fields & 0x800000) != 0 || minutes > 59) * FLAG_TIME_VALUE_MINUTE;
+	flags |= ((bad_fields & 0x8000000000ULL) != 0 || secs > 59) * FLAG_TIME_VALUE_SECOND;
+
+	return flags ? ERR_TIME(flags) : (int)(hours * 3600 + minutes * 60 + secs);
+}
+
+/*
+    The formats are recognized by one DFA. Its tables are built by the compiler from the entries below, a character
+    costs a class lookup and a transition lookup. The transitions carry what to do with the number being read: add a
+    digit to it, or complete a field with it.
+*/
+
+// Character classes, anything not listed is other
+enum time_class {
+	TC_OTHER,
+	TC_DIGIT,
+	TC_COLON,
+	TC_AT,
+	TC_H,
+	TC_M,
+	TC_S,
+	// The end of the input, only looked at by `time_parse_finish`
+	TC_END,
+	TC_COUNT,
+};
+
+static const uint8_t char_class[256] = {
+	['0'] = TC_DIGIT, ['1'] = TC_DIGIT, ['2'] = TC_DIGIT, ['3'] = TC_DIGIT, ['4'] = TC_DIGIT,
+	['5'] = TC_DIGIT, ['6'] = TC_DIGIT, ['7'] = TC_DIGIT, ['8'] = TC_DIGIT, ['9'] = TC_DIGIT,
+	[':'] = TC_COLON, ['@'] = TC_AT, ['h'] = TC_H, ['m'] = TC_M, ['s'] = TC_S,
+};
+
+enum time_state {
+	// In none of the formats, unlisted transitions lead here and it has none out
+	TS_REJECT,
+	TS_START,
+	TS_AT,
+	// Digits of a clock or of the first field of a delay
+	TS_NUM_1, TS_NUM_2, TS_NUM_3, TS_NUM_4, TS_NUM_5, TS_NUM_6,
+	// Digits of a clock after '@'
+	TS_AT_1, TS_AT_2, TS_AT_3, TS_AT_4, TS_AT_5, TS_AT_6,
+	// HH: and the minutes after it, HH:MM: and the seconds after it
+	TS_COLON_1, TS_MINUTE_1, TS_MINUTE_2,
+	TS_COLON_2, TS_SECOND_1, TS_SECOND_2,
+	// A unit of a delay and the digits of the field after it
+	TS_UNIT_H, TS_AFTER_H_1, TS_AFTER_H_2,
+	TS_UNIT_M, TS_AFTER_M_1, TS_AFTER_M_2,
+	TS_UNIT_S,
+	// The end of an input in one of the formats
+	TS_DONE,
+	TS_COUNT,
+};
+
+enum time_action {
+	ACT_NONE,
+	ACT_DIGIT,
+	ACT_AT,
+	// Six digits, they are in the HHMMSS fields
+	ACT_HHMMSS,
+	// Complete a field with the number, see `fields_info`
+	ACT_HOUR,
+	ACT_MINUTE,
+	ACT_SECOND,
+	ACT_LEAD_MINUTE,
+	ACT_LEAD_SECOND,
+	ACT_COUNT,
+};
+
+struct time_transition_t {
+	uint8_t next;
+	uint8_t action;
+};
+
+// Fields completed by the actions. The first field of a delay holds the whole delay and can be over 59.
+static const struct {
+	uint32_t max;
+	uint32_t seconds;
+	uint8_t flag;
+} fields_info[ACT_COUNT] = {
+	[ACT_HOUR] =        { 23,    3600, FLAG_TIME_VALUE_HOUR },
+	[ACT_MINUTE] =      { 59,    60,   FLAG_TIME_VALUE_MINUTE },
+	[ACT_SECOND] =      { 59,    1,    FLAG_TIME_VALUE_SECOND },
+	[ACT_LEAD_MINUTE] = { 1439,  60,   FLAG_TIME_VALUE_MINUTE },
+	[ACT_LEAD_SECOND] = { 86399, 1,    FLAG_TIME_VALUE_SECOND },
+};
+
+#define DIGIT(s) [TC_DIGIT] = { .next = (s), .action = ACT_DIGIT }
+#define FIELD(s, a) { .next = (s), .action = (a) }
+#define END(a) [TC_END] = { .next = TS_DONE, .action = (a) }
+
+// The first field of a delay, or a clock if there is no unit
+#define NUMBER(next) { \
+		DIGIT(next), \
+		[TC_H] = FIELD(TS_UNIT_H, ACT_HOUR), \
+		[TC_M] = FIELD(TS_UNIT_M, ACT_LEAD_MINUTE), \
+		[TC_S] = FIELD(TS_UNIT_S, ACT_LEAD_SECOND), \
+	}
+
+static const struct time_transition_t transitions[TS_COUNT][TC_COUNT] = {
+	[TS_START] = { DIGIT(TS_NUM_1), [TC_AT] = { .next = TS_AT, .action = ACT_AT } },
+	[TS_AT] = { DIGIT(TS_AT_1) },
+
+	[TS_NUM_1] = NUMBER(TS_NUM_2),
+	[TS_NUM_2] = {
+		DIGIT(TS_NUM_3),
+		[TC_COLON] = FIELD(TS_COLON_1, ACT_HOUR),
+		[TC_H] = FIELD(TS_UNIT_H, ACT_HOUR),
+		[TC_M] = FIELD(TS_UNIT_M, ACT_LEAD_MINUTE),
+		[TC_S] = FIELD(TS_UNIT_S, ACT_LEAD_SECOND),
+	},
+	[TS_NUM_3] = NUMBER(TS_NUM_4),
+	[TS_NUM_4] = NUMBER(TS_NUM_5),
+	[TS_NUM_5] = NUMBER(TS_NUM_6),
+	[TS_NUM_6] = { END(ACT_HHMMSS) },
+
+	[TS_AT_1] = { DIGIT(TS_AT_2) },
+	[TS_AT_2] = { DIGIT(TS_AT_3), [TC_COLON] = FIELD(TS_COLON_1, ACT_HOUR) },
+	[TS_AT_3] = { DIGIT(TS_AT_4) },
+	[TS_AT_4] = { DIGIT(TS_AT_5) },
+	[TS_AT_5] = { DIGIT(TS_AT_6) },
+	[TS_AT_6] = { END(ACT_HHMMSS) },
+
+	[TS_COLON_1] = { DIGIT(TS_MINUTE_1) },
+	[TS_MINUTE_1] = { DIGIT(TS_MINUTE_2) },
+	[TS_MINUTE_2] = { [TC_COLON] = FIELD(TS_COLON_2, ACT_MINUTE), END(ACT_MINUTE) },
+	[TS_COLON_2] = { DIGIT(TS_SECOND_1) },
+	[TS_SECOND_1] = { DIGIT(TS_SECOND_2) },
+	[TS_SECOND_2] = { END(ACT_SECOND) },
+
+	[TS_UNIT_H] = { DIGIT(TS_AFTER_H_1), END(ACT_NONE) },
+	[TS_AFTER_H_1] = {
+		DIGIT(TS_AFTER_H_2),
+		[TC_M] = FIELD(TS_UNIT_M, ACT_MINUTE),
+		[TC_S] = FIELD(TS_UNIT_S, ACT_SECOND),
+	},
+	[TS_AFTER_H_2] = { [TC_M] = FIELD(TS_UNIT_M, ACT_MINUTE), [TC_S] = FIELD(TS_UNIT_S, ACT_SECOND) },
+	[TS_UNIT_M] = { DIGIT(TS_AFTER_M_1), END(ACT_NONE) },
+	[TS_AFTER_M_1] = { DIGIT(TS_AFTER_M_2), [TC_S] = FIELD(TS_UNIT_S, ACT_SECOND) },
+	[TS_AFTER_M_2] = { [TC_S] = FIELD(TS_UNIT_S, ACT_SECOND) },
+	[TS_UNIT_S] = { END(ACT_NONE) },
+};
+
+_Static_assert(TS_REJECT == 0 && TC_OTHER == 0, "Unlisted table entries must mean a character in none of the formats");
+
+// Error flag of the field each character of HHMMSS belongs to
+static const uint8_t field_flags[6] = {
+	FLAG_TIME_VALUE_HOUR, FLAG_TIME_VALUE_HOUR,
+	FLAG_TIME_VALUE_MINUTE, FLAG_TIME_VALUE_MINUTE,
+	FLAG_TIME_VALUE_SECOND, FLAG_TIME_VALUE_SECOND,
+};
+
+// HHMMSS one character at a time, like the scalar parser
+static void hhmmss_feed(struct time_stream_t *ctx, char c) {
+	if (ctx->len >= 6) {
+		// The length is already wrong, like the scalar parser only the syntax is checked from here on
+		ctx->flags |= ((uint8_t)(c - '0') > 9) * FLAG_TIME_SYNTAX;
+		ctx->len = 7;
+		return;
+	}
+
+	uint8_t digit = (uint8_t)(c - '0');
+
+	// Like the scalar parser a bad character counts as zero in its field
+	if (digit > 9) {
+		ctx->flags |= FLAG_TIME_SYNTAX | field_flags[ctx->len];
+		digit = 0;
+	}
+
+	uint8_t *field = &ctx->fields[ctx->len / 2];
+
+	*field = *field * 10 + digit;
+	ctx->len++;
+}
+
+static int hhmmss_finish(const struct time_stream_t *ctx) {
+	uint32_t fields[3] = { ctx->fields[0], ctx->fields[1], ctx->fields[2] };
+
+	// A field cut short after its tens digit, the missing characters count as zero
+	if (ctx->len < 6 && (ctx->len & 1)) fields[ctx->len / 2] *= 10;
+
+	int flags = ctx->flags | (ctx->len != 6) * FLAG_TIME_LEN;
+
+	flags |= (fields[0] > 23) * FLAG_TIME_VALUE_HOUR;
+	flags |= (fields[1] > 59) * FLAG_TIME_VALUE_MINUTE;
+	flags |= (fields[2] > 59) * FLAG_TIME_VALUE_SECOND;
+
+	return flags ? ERR_TIME(flags) : (int)(fields[0] * 3600 + fields[1] * 60 + fields[2]);
+}
+
+void time_parse_init(struct time_stream_t *ctx) {
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->state = TS_START;
+}
+
+void time_parse_feed(struct time_stream_t *ctx, char c) {
+	struct time_transition_t t = transitions[ctx->state][char_class[(uint8_t)c]];
+
+	ctx->state = t.next;
+
+	if (t.action == ACT_DIGIT) {
+		ctx->number = ctx->number * 10 + (uint8_t)(c - '0');
+	} else if (t.action >= ACT_HOUR) {
+		ctx->errors |= (ctx->number > fields_info[t.action].max) * fields_info[t.action].flag;
+		ctx->total += ctx->number * fields_info[t.action].seconds;
+		ctx->number = 0;
+	} else if (t.action == ACT_AT) {
+		// The '@' is not part of the time, not even for the length of HHMMSS
+		ctx->absolute = 1;
+		return;
+	}
+
+	hhmmss_feed(ctx, c);
+}
+
+int time_parse_finish(const struct time_stream_t *ctx) {
+	struct time_transition_t t = transitions[ctx->state][TC_END];
+	int absolute = ctx->absolute ? TIME_ABSOLUTE : 0;
+
+	// Checked as HHMMSS, which gives the flags of what is wrong with it
+	if (t.next == TS_REJECT) return hhmmss_finish(ctx);
+
+	if (t.action == ACT_HHMMSS) {
+		int ret = hhmmss_finish(ctx);
+
+		return ret < 0 ? ret : ret | absolute;
+	}
+
+	int flags = ctx->errors;
+	uint32_t total = ctx->total;
+
+	if (t.action >= ACT_HOUR) {
+		flags |= (ctx->number > fields_info[t.action].max) * fields_info[t.action].flag;
+		total += ctx->number * fields_info[t.action].seconds;
+	}
+
+	return flags ? ERR_TIME(flags) : (int)total | absolute;
+}
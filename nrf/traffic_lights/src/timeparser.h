@@ -1,6 +1,12 @@
 #ifndef TIMEPARSER_H
 #define TIMEPARSER_H
 
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // Return codes and flags to signal multiple errors so the user can try to correct all of them
 
 // Return value for correctly parsed time string (Unused)
@@ -20,6 +26,58 @@
 // Convert OR'd flags into error. Keeps syntax and intent clear.
 #define ERR_TIME(flags) (-(flags))
 
-int time_parse(char *time);
+// Set in a result given with a leading '@': a time of day rather than a delay
+#define TIME_ABSOLUTE             (1 << 17)
+// Seconds of a result without the TIME_ABSOLUTE bit
+#define TIME_SECONDS(result)      ((result) & (TIME_ABSOLUTE - 1))
+
+/*
+    Parse a delay into seconds. It can be given as a clock, HHMMSS, HH:MM:SS or HH:MM, or with units, like 90s, 5m,
+    1h30m or 1h5m3s, at most 23:59:59 in total. A clock with a leading '@' is a time of day instead, the result then
+    has TIME_ABSOLUTE set. Returns the seconds or ERR_TIME of the flags of every error found, a field out of range gets
+    the flag of its field. A string in none of the formats is checked as HHMMSS, after the '@' if it has one: if it is
+    not six characters long it gets FLAG_TIME_LEN, and the flags of the fields it has.
+*/
+int time_parse(const char *time);
+
+// Reference implementation of the HHMMSS format of `time_parse` that checks one character at a time, for tests and
+// benchmarks
+int time_parse_scalar(const char *time);
+
+/*
+    State of a time parsed as its characters arrive. There is no buffer, the format is recognized and the fields are
+    converted and checked on the fly, so any number of characters can be fed and only the length is lost.
+*/
+struct time_stream_t {
+    // State of the format recognizer, see timeparser.c
+    uint8_t state;
+    // A leading '@' was fed
+    uint8_t absolute;
+    // Range errors of the fields completed so far
+    uint8_t errors;
+    // HHMMSS as in `time_parse_scalar`, for a string in none of the formats: characters fed after the '@', counting
+    // stops after the first one too many, the error flags found so far, and the fields as far as they have arrived
+    uint8_t len;
+    uint8_t flags;
+    uint8_t fields[3];
+    // Number being read, and the seconds of the fields before it
+    uint32_t number;
+    uint32_t total;
+};
+
+void time_parse_init(struct time_stream_t *ctx);
+
+// Feed one character of the time
+void time_parse_feed(struct time_stream_t *ctx, char c);
+
+/*
+    Result of the characters fed so far, the same as `time_parse` of them as a string. The state is not changed, more
+    characters can still be fed.
+*/
+int time_parse_finish(const struct time_stream_t *ctx);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
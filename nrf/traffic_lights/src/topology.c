@@ -0,0 +1,120 @@
+/* Topology of the intersection. Every head has a mask of the phases it is green in and a mask of the heads it conflicts
+ * with. The led engine shows one color at a time and this turns it into the color of each head, so adding a head adds
+ * an entry to a table and not a thread.
+ */
+
+#include <zephyr/kernel.h>
+
+#include "topology.h"
+#include "ledbackend.h"
+#include "debug.h"
+
+struct head_t {
+    uint32_t phases;
+    uint32_t conflicts;
+};
+
+#ifdef TOPOLOGY_NODE
+
+#define PHASE_BIT(node, prop, idx) BIT(DT_PROP_BY_IDX(node, prop, idx)) |
+#define CONFLICT_BIT(node, prop, idx) BIT(DT_NODE_CHILD_IDX(DT_PHANDLE_BY_IDX(node, prop, idx))) |
+
+#define HEAD(node) { \
+        .phases = DT_FOREACH_PROP_ELEM(node, phases, PHASE_BIT) 0, \
+        .conflicts = COND_CODE_1(DT_NODE_HAS_PROP(node, conflicts), \
+            (DT_FOREACH_PROP_ELEM(node, conflicts, CONFLICT_BIT)), ()) 0, \
+    },
+
+static const struct head_t heads[TOPOLOGY_HEADS] = {
+    DT_FOREACH_CHILD(TOPOLOGY_NODE, HEAD)
+};
+
+#else
+
+static const struct head_t heads[TOPOLOGY_HEADS] = {
+    { .phases = BIT(0), .conflicts = 0 },
+};
+
+#endif
+
+atomic_t topology_conflicts = ATOMIC_INIT(0);
+
+// Written by the led work queue only, read by anyone
+static atomic_t active_phase = ATOMIC_INIT(0);
+
+bool topology_init(void)
+{
+    for (int phase = 0; phase < TOPOLOGY_PHASES; phase++) {
+        uint32_t members = 0;
+
+        for (int i = 0; i < TOPOLOGY_HEADS; i++) {
+            if (heads[i].phases & BIT(phase)) {
+                members |= BIT(i);
+            }
+        }
+
+        if (members == 0) {
+            debug("Error: Phase %d has no heads", phase);
+            return false;
+        }
+
+        for (int i = 0; i < TOPOLOGY_HEADS; i++) {
+            if ((members & BIT(i)) && (heads[i].conflicts & members)) {
+                debug("Error: Head %d conflicts with a head of phase %d", i, phase);
+                return false;
+            }
+        }
+    }
+
+    for (int i = 0; i < TOPOLOGY_HEADS; i++) {
+        if (heads[i].phases & ~BIT_MASK(TOPOLOGY_PHASES)) {
+            debug("Error: Head %d is in a phase that does not exist", i);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void topology_show(enum State mode, enum Color color)
+{
+    enum Color shown[TOPOLOGY_HEADS];
+    uint32_t phase = BIT(atomic_get(&active_phase));
+    uint32_t going = 0;
+    bool together = mode == Blink || color == Off;
+
+    for (int i = 0; i < TOPOLOGY_HEADS; i++) {
+        shown[i] = together || (heads[i].phases & phase) ? color : Red;
+
+        if (shown[i] == Yellow || shown[i] == Green) {
+            going |= BIT(i);
+        }
+    }
+
+    // Conflict monitor. Blinking yellow everywhere is the safe state of an intersection, so it is never a conflict.
+    for (int i = 0; i < TOPOLOGY_HEADS && !together; i++) {
+        if ((going & BIT(i)) && (heads[i].conflicts & going)) {
+            atomic_inc(&topology_conflicts);
+            debug("Conflict between head %d and mask 0x%x, all heads red", i, heads[i].conflicts & going);
+
+            for (int j = 0; j < TOPOLOGY_HEADS; j++) {
+                shown[j] = Red;
+            }
+            break;
+        }
+    }
+
+    for (int i = 0; i < TOPOLOGY_HEADS; i++) {
+        led_backend_set(i, shown[i]);
+    }
+}
+
+void topology_next_phase(void)
+{
+    atomic_set(&active_phase, (atomic_get(&active_phase) + 1) % TOPOLOGY_PHASES);
+}
+
+uint32_t topology_phase(void)
+{
+    return atomic_get(&active_phase);
+}
@@ -0,0 +1,46 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/sys/atomic.h>
+
+#include "ledctl.h"
+
+/*
+    Signal heads and phases of the intersection, from a "traffic-lights-heads" devicetree node. Without one the lights
+    are a single head on the led0 and led1 aliases that is green in the only phase. The tables are built at compile time
+    and take a couple of words per head, the led engine drives every head from its own work queue.
+*/
+#if DT_HAS_COMPAT_STATUS_OKAY(traffic_lights_heads)
+#define TOPOLOGY_NODE DT_COMPAT_GET_ANY_STATUS_OKAY(traffic_lights_heads)
+#define TOPOLOGY_HEADS DT_CHILD_NUM(TOPOLOGY_NODE)
+#define TOPOLOGY_PHASES DT_PROP(TOPOLOGY_NODE, phase_count)
+#else
+#define TOPOLOGY_HEADS 1
+#define TOPOLOGY_PHASES 1
+#endif
+
+// Conflicts and phases are bit masks
+BUILD_ASSERT(TOPOLOGY_HEADS <= 32, "At most 32 signal heads");
+BUILD_ASSERT(TOPOLOGY_PHASES <= 32, "At most 32 phases");
+
+// Times the conflict monitor forced every head red
+extern atomic_t topology_conflicts;
+
+// Check that no phase lets conflicting heads go together and that every phase has a head
+bool topology_init(void);
+
+/*
+    Show the lights of a mode and color on every head. The heads of the active phase show the color and the rest show
+    red, except when blinking or off, which every head does together. Only called from the led work queue.
+*/
+void topology_show(enum State mode, enum Color color);
+
+// Make the next phase active. Takes effect the next time the lights are shown.
+void topology_next_phase(void);
+
+uint32_t topology_phase(void);
+
+#endif // TOPOLOGY_H
@@ -0,0 +1,128 @@
+/* UART receive path. In interrupt mode the UART ISR only copies bytes into a ring buffer and decides when the
+ * reader should wake up, so the UART task sleeps on a semaphore while nothing is arriving instead of spinning on
+ * `uart_poll_in()`.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/sys/ring_buffer.h>
+
+#include "uartrx.h"
+
+static const struct device *rx_dev;
+
+atomic_t uart_rx_dropped = ATOMIC_INIT(0);
+
+#ifdef CONFIG_TRAFFIC_LIGHTS_UART_IRQ
+
+#define RX_BUF_SIZE CONFIG_TRAFFIC_LIGHTS_UART_RX_BUF_SIZE
+// Wake the reader before the ring is full even if the line is not finished yet
+#define RX_WAKE_SPACE (RX_BUF_SIZE / 4)
+
+RING_BUF_DECLARE(rx_ring, RX_BUF_SIZE);
+
+// Given by the ISR or the idle timer when there is something worth reading
+K_SEM_DEFINE(rx_ready, 0, 1);
+
+static void rx_idle_expired(struct k_timer *timer)
+{
+    k_sem_give(&rx_ready);
+}
+
+K_TIMER_DEFINE(rx_idle_timer, rx_idle_expired, NULL);
+
+// Characters that end a command: line terminators and the robot mode toggle
+static inline bool is_wake_char(uint8_t c)
+{
+    return c == '\n' || c == '\r' || c == '\0';
+}
+
+static void uart_rx_isr(const struct device *dev, void *user_data)
+{
+    uint8_t buf[16];
+    bool wake = false;
+
+    if (!uart_irq_update(dev)) {
+        return;
+    }
+
+    while (uart_irq_rx_ready(dev)) {
+        int len = uart_fifo_read(dev, buf, sizeof(buf));
+
+        if (len <= 0) {
+            break;
+        }
+
+        uint32_t stored = ring_buf_put(&rx_ring, buf, len);
+
+        if (stored < len) {
+            atomic_add(&uart_rx_dropped, len - stored);
+            wake = true;
+        }
+
+        for (int i = 0; i < len && !wake; i++) {
+            wake = is_wake_char(buf[i]);
+        }
+    }
+
+    if (wake || ring_buf_space_get(&rx_ring) < RX_WAKE_SPACE) {
+        k_timer_stop(&rx_idle_timer);
+        k_sem_give(&rx_ready);
+    } else {
+        // Restart the idle timeout on every burst of bytes
+        k_timer_start(&rx_idle_timer, K_MSEC(CONFIG_TRAFFIC_LIGHTS_UART_RX_IDLE_MS), K_NO_WAIT);
+    }
+}
+
+bool uart_rx_init(const struct device *dev)
+{
+    rx_dev = dev;
+
+    if (uart_irq_callback_user_data_set(dev, uart_rx_isr, NULL) < 0) {
+        return false;
+    }
+
+    uart_irq_rx_enable(dev);
+    return true;
+}
+
+void uart_rx_getc(char *c)
+{
+    // The semaphore may have been given more than once for the same data, so check the ring after every wake up
+    while (ring_buf_get(&rx_ring, (uint8_t *)c, 1) == 0) {
+        k_sem_take(&rx_ready, K_FOREVER);
+    }
+}
+
+void uart_rx_discard(void)
+{
+    uart_irq_rx_disable(rx_dev);
+    ring_buf_reset(&rx_ring);
+    k_sem_reset(&rx_ready);
+    uart_irq_rx_enable(rx_dev);
+}
+
+#else
+
+bool uart_rx_init(const struct device *dev)
+{
+    rx_dev = dev;
+    return true;
+}
+
+void uart_rx_getc(char *c)
+{
+    while (uart_poll_in(rx_dev, (unsigned char *)c) != 0) {
+        k_msleep(CONFIG_TRAFFIC_LIGHTS_UART_POLL_MS);
+    }
+}
+
+void uart_rx_discard(void)
+{
+    unsigned char discard;
+
+    while (uart_poll_in(rx_dev, &discard) == 0);
+}
+
+#endif // CONFIG_TRAFFIC_LIGHTS_UART_IRQ
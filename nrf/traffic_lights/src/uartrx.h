@@ -0,0 +1,23 @@
+#ifndef UARTRX_H
+#define UARTRX_H
+
+/*
+    Set up receiving from the given UART. With CONFIG_TRAFFIC_LIGHTS_UART_IRQ the UART interrupt fills a ring buffer and
+    the reader is woken only when a line terminator arrives or the line goes idle. Otherwise the UART is polled.
+*/
+bool uart_rx_init(const struct device *dev);
+
+/*
+    Get the next received character. Blocks the calling thread until one is available.
+*/
+void uart_rx_getc(char *c);
+
+/*
+    Throw away everything that has been received but not yet read.
+*/
+void uart_rx_discard(void);
+
+// Count of bytes lost because the ring buffer was full
+extern atomic_t uart_rx_dropped;
+
+#endif
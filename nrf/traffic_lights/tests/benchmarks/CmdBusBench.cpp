@@ -0,0 +1,98 @@
+// Host benchmark for the command bus. Producer threads stand in for the buttons, the timer, the UART and the
+// dispatcher, one consumer drains the bus like the led engine. A mutex plays the part of the spinlock around the bus in
+// the firmware. Prints throughput and the queue latency of each priority.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../../src/cmdbus.h"
+
+using Clock = std::chrono::steady_clock;
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char **argv) {
+    const int per_producer = argc > 1 ? std::atoi(argv[1]) : 200000;
+    const uint8_t sources[] = { CMD_SRC_BUTTON, CMD_SRC_TIMER, CMD_SRC_UART, CMD_SRC_DISPATCHER };
+    const int producers = sizeof(sources);
+
+    // No coalescing, every command must come through
+    static const uint8_t flags[1] = { 0 };
+    struct cmd_bus_t bus;
+    cmd_bus_init(&bus, flags, 1);
+
+    std::mutex lock;
+    std::atomic<int> running(producers);
+    std::vector<uint64_t> latencies[CMD_SRC_COUNT];
+    uint64_t received = 0;
+
+    auto start = Clock::now();
+
+    std::vector<std::thread> threads;
+    for (uint8_t source : sources) {
+        threads.emplace_back([&, source] {
+            struct command_t cmd = {};
+            cmd.source = source;
+
+            for (int i = 0; i < per_producer; i++) {
+                // A full priority makes the producer give the processor away, like a thread waiting for a slot
+                while (true) {
+                    cmd.posted = now_ns();
+                    {
+                        std::lock_guard<std::mutex> guard(lock);
+                        if (cmd_bus_push(&bus, &cmd) != CMD_FULL) break;
+                    }
+                    std::this_thread::yield();
+                }
+            }
+            running--;
+        });
+    }
+
+    struct command_t cmd;
+    while (true) {
+        bool got;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            got = cmd_bus_pop(&bus, &cmd);
+        }
+
+        if (got) {
+            latencies[cmd.source].push_back(now_ns() - cmd.posted);
+            received++;
+        } else if (running == 0) {
+            std::lock_guard<std::mutex> guard(lock);
+            if (cmd_bus_depth(&bus) == 0) break;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    printf("%llu commands in %.3f s, %.2f M commands/s, %u full retries\n", (unsigned long long)received, seconds,
+        received / seconds / 1e6, bus.dropped);
+
+    static const char *const names[CMD_SRC_COUNT] = { "system", "button", "timer", "uart", "dispatcher" };
+    for (uint8_t source : sources) {
+        std::vector<uint64_t> &samples = latencies[source];
+        std::sort(samples.begin(), samples.end());
+        printf("%-10s p50 %8llu ns  p99 %8llu ns  max %10llu ns\n", names[source],
+            (unsigned long long)samples[samples.size() / 2], (unsigned long long)samples[samples.size() * 99 / 100],
+            (unsigned long long)samples.back());
+    }
+
+    return 0;
+}
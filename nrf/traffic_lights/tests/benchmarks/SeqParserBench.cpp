@@ -0,0 +1,59 @@
+// Host throughput benchmark for the streaming sequence parser. Prints parsed bytes per second.
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "../../src/seqparser.h"
+
+// Colors per generated line, few enough that every line compiles
+#define MAX_COLORS 20
+
+// Build a buffer of random valid sequence lines, roughly the size of `bytes`
+static std::string make_input(size_t bytes) {
+    static const char colors[] = { 'R', 'Y', 'G', 'O' };
+    std::mt19937 rng(1234);
+    std::string input;
+
+    while (input.size() < bytes) {
+        int len = 1 + rng() % MAX_COLORS;
+
+        for (int i = 0; i < len; i++) {
+            input += colors[rng() % 4];
+            if (rng() % 3 == 0) input += std::to_string(rng() % 5000);
+        }
+
+        if (rng() % 4 == 0) input += "T" + std::to_string(1 + rng() % 100);
+        input += '\n';
+    }
+
+    return input;
+}
+
+int main(int argc, char **argv) {
+    const int rounds = argc > 1 ? std::atoi(argv[1]) : 200;
+    const std::string input = make_input(1 << 20);
+
+    struct seq_parser_t parser;
+    struct led_control_t ctl;
+    size_t sequences = 0;
+
+    seq_parser_init(&parser);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int r = 0; r < rounds; r++) {
+        for (char c : input) {
+            if (seq_parser_feed(&parser, c, &ctl) == SEQ_READY) sequences++;
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double bytes = (double)input.size() * rounds;
+
+    std::printf("seq_parser_feed: %.0f bytes in %.3f s, %.1f MB/s, %zu sequences\n",
+        bytes, elapsed.count(), bytes / elapsed.count() / 1e6, sequences);
+
+    return sequences == 0;
+}
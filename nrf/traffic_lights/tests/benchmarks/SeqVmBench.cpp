@@ -0,0 +1,61 @@
+// Host throughput benchmark for the sequence interpreter. Prints interpreter steps per second.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../../src/seqparser.h"
+
+// Flat, looped and nested programs, compiled once like the dispatcher does
+static const char *const sources[] = {
+    "RYG500R200G500Y1000ORYG500R200G500Y1000O\n",
+    "RG250YT1000\n",
+    "R100(G200(Y300O)50)50T20\n",
+    "(R(G(YO100)20)20)20\n",
+};
+
+int main(int argc, char **argv) {
+    const int rounds = argc > 1 ? std::atoi(argv[1]) : 200;
+    struct led_control_t programs[sizeof(sources) / sizeof(sources[0])];
+    struct seq_parser_t parser;
+
+    seq_parser_init(&parser);
+
+    for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); i++) {
+        int ret = SEQ_MORE;
+
+        for (const char *c = sources[i]; *c != '\0'; c++) {
+            ret = seq_parser_feed(&parser, *c, &programs[i]);
+        }
+
+        if (ret != SEQ_READY) {
+            std::printf("Failed to compile %s", sources[i]);
+            return 1;
+        }
+    }
+
+    size_t steps = 0;
+    uint32_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int r = 0; r < rounds; r++) {
+        for (const struct led_control_t &program : programs) {
+            struct seq_vm_t vm;
+            struct seq_step_t step;
+
+            seq_vm_init(&vm, &program);
+
+            while (seq_vm_run(&vm, &step) == SEQ_VM_SET) {
+                checksum += step.color + step.hold_ms;
+                steps++;
+            }
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::printf("seq_vm_run: %zu steps in %.3f s, %.1f M steps/s, checksum %u\n",
+        steps, elapsed.count(), steps / elapsed.count() / 1e6, checksum);
+
+    return steps == 0;
+}
@@ -0,0 +1,175 @@
+// Host throughput benchmark of the time parser. Compares the scalar reference with the SWAR parser and the streaming
+// parser of the UART task in parses per second over valid and adversarial inputs, and checks that all of them give the
+// same result for every input. The other formats are timed on their own, there is no scalar parser for them.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../../src/timeparser.h"
+
+// Inputs per set, cycled through so that the branch predictor can not learn them
+#define INPUTS 4096
+
+typedef int (*parse_fn)(const char *);
+
+static std::string digits(std::mt19937 &rng, int count, int max) {
+    std::string out;
+    char buf[16];
+
+    std::snprintf(buf, sizeof(buf), "%0*d", count, (int)(rng() % (max + 1)));
+    out = buf;
+    return out;
+}
+
+static std::vector<std::string> valid(std::mt19937 &rng) {
+    std::vector<std::string> inputs;
+
+    for (int i = 0; i < INPUTS; i++) {
+        inputs.push_back(digits(rng, 2, 23) + digits(rng, 2, 59) + digits(rng, 2, 59));
+    }
+    return inputs;
+}
+
+// Every field out of range sometimes, so the range checks can not be predicted
+static std::vector<std::string> out_of_range(std::mt19937 &rng) {
+    std::vector<std::string> inputs;
+
+    for (int i = 0; i < INPUTS; i++) {
+        inputs.push_back(digits(rng, 2, 99) + digits(rng, 2, 99) + digits(rng, 2, 99));
+    }
+    return inputs;
+}
+
+// Random bytes in random places, including bytes just outside '0'..'9' and bytes with the high bit set
+static std::vector<std::string> bad_syntax(std::mt19937 &rng) {
+    static const char noise[] = { '/', ':', ' ', 'x', '-', (char)0x80, (char)0xb0, (char)0xff };
+    std::vector<std::string> inputs;
+
+    for (int i = 0; i < INPUTS; i++) {
+        std::string input = digits(rng, 6, 999999);
+        int count = 1 + rng() % 3;
+
+        for (int j = 0; j < count; j++) input[rng() % 6] = noise[rng() % sizeof(noise)];
+        inputs.push_back(input);
+    }
+    return inputs;
+}
+
+static std::vector<std::string> bad_length(std::mt19937 &rng) {
+    std::vector<std::string> inputs;
+
+    for (int i = 0; i < INPUTS; i++) {
+        int len = rng() % 10;
+
+        if (len == 6) len = 7;
+        inputs.push_back(digits(rng, 8, 99999999).substr(0, len));
+    }
+    return inputs;
+}
+
+// The other formats, which only the format recognizer reads
+static std::vector<std::string> other_formats(std::mt19937 &rng) {
+    std::vector<std::string> inputs;
+
+    for (int i = 0; i < INPUTS; i++) {
+        std::string hours = digits(rng, 2, 23);
+        std::string minutes = digits(rng, 2, 59);
+        std::string secs = digits(rng, 2, 59);
+
+        switch (rng() % 6) {
+            case 0: inputs.push_back(hours + ":" + minutes + ":" + secs); break;
+            case 1: inputs.push_back(hours + ":" + minutes); break;
+            case 2: inputs.push_back("@" + hours + minutes + secs); break;
+            case 3: inputs.push_back(std::to_string(rng() % 86400) + "s"); break;
+            case 4: inputs.push_back(std::to_string(rng() % 1440) + "m" + std::to_string(rng() % 60) + "s"); break;
+            default: inputs.push_back(std::to_string(rng() % 24) + "h" + std::to_string(rng() % 60) + "m"); break;
+        }
+    }
+    return inputs;
+}
+
+// The streaming parser fed one character at a time, like the UART task does
+static int time_parse_stream(const char *time) {
+    struct time_stream_t ctx;
+
+    time_parse_init(&ctx);
+    for (const char *c = time; *c != '\0'; c++) time_parse_feed(&ctx, *c);
+    return time_parse_finish(&ctx);
+}
+
+static double run(parse_fn parse, const std::vector<std::string> &inputs, int rounds, long *checksum) {
+    long sum = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int r = 0; r < rounds; r++) {
+        for (const std::string &input : inputs) sum += parse(input.c_str());
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    *checksum = sum;
+    return (double)inputs.size() * rounds / elapsed.count();
+}
+
+int main(int argc, char **argv) {
+    const int rounds = argc > 1 ? std::atoi(argv[1]) : 2000;
+    std::mt19937 rng(1234);
+    int mismatches = 0;
+
+    struct {
+        const char *name;
+        std::vector<std::string> inputs;
+    } sets[] = {
+        { "valid", valid(rng) },
+        { "out of range", out_of_range(rng) },
+        { "bad syntax", bad_syntax(rng) },
+        { "bad length", bad_length(rng) },
+    };
+
+    for (auto &set : sets) {
+        for (const std::string &input : set.inputs) {
+            int expected = time_parse_scalar(input.c_str());
+
+            if (time_parse(input.c_str()) != expected || time_parse_stream(input.c_str()) != expected) {
+                std::printf("mismatch on \"%s\": %d, stream %d, scalar %d\n", input.c_str(), time_parse(input.c_str()),
+                    time_parse_stream(input.c_str()), expected);
+                mismatches++;
+            }
+        }
+
+        long scalar_sum;
+        long swar_sum;
+        long stream_sum;
+        double scalar = run(time_parse_scalar, set.inputs, rounds, &scalar_sum);
+        double swar = run(time_parse, set.inputs, rounds, &swar_sum);
+        double stream = run(time_parse_stream, set.inputs, rounds, &stream_sum);
+
+        std::printf("%-12s scalar %7.1f M parses/s, swar %7.1f M parses/s, %.2fx, stream %7.1f M parses/s, %.2fx\n",
+            set.name, scalar / 1e6, swar / 1e6, swar / scalar, stream / 1e6, stream / scalar);
+
+        if (scalar_sum != swar_sum || scalar_sum != stream_sum) mismatches++;
+    }
+
+    // No reference for the other formats, the whole string and the streaming parser must agree and find no errors
+    std::vector<std::string> formats = other_formats(rng);
+
+    for (const std::string &input : formats) {
+        if (time_parse(input.c_str()) < 0 || time_parse(input.c_str()) != time_parse_stream(input.c_str())) {
+            std::printf("mismatch on \"%s\": %d, stream %d\n", input.c_str(), time_parse(input.c_str()),
+                time_parse_stream(input.c_str()));
+            mismatches++;
+        }
+    }
+
+    long whole_sum;
+    long stream_sum;
+    double whole = run(time_parse, formats, rounds, &whole_sum);
+    double stream = run(time_parse_stream, formats, rounds, &stream_sum);
+
+    std::printf("%-12s whole string %7.1f M parses/s, stream %7.1f M parses/s\n", "formats", whole / 1e6, stream / 1e6);
+
+    return mismatches != 0;
+}
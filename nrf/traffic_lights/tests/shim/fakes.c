@@ -0,0 +1,116 @@
+/* Fake led backend and UART receive side of the host builds. */
+
+#include <stdlib.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+
+#include "fakes.h"
+#include "shim.h"
+#include "ledbackend.h"
+#include "topology.h"
+#include "uartrx.h"
+
+static enum Color colors[TOPOLOGY_HEADS];
+static struct fake_led_change_t changes[FAKE_LED_LOG_SIZE];
+static size_t change_count;
+static bool hardware_blink;
+
+static char *input;
+static size_t input_len;
+static size_t input_pos;
+
+atomic_t uart_rx_dropped = ATOMIC_INIT(0);
+
+static void log_change(uint32_t head, enum Color color, bool blinking)
+{
+    if (change_count < FAKE_LED_LOG_SIZE) {
+        changes[change_count] = (struct fake_led_change_t){ k_uptime_get(), head, color, blinking };
+    }
+
+    change_count++;
+}
+
+bool led_backend_init(void)
+{
+    return true;
+}
+
+void led_backend_set(uint32_t head, enum Color color)
+{
+    colors[head] = color;
+    log_change(head, color, false);
+}
+
+bool led_backend_blink(enum Color color, uint32_t on_ms, uint32_t off_ms)
+{
+    if (!hardware_blink) {
+        return false;
+    }
+
+    for (uint32_t head = 0; head < TOPOLOGY_HEADS; head++) {
+        colors[head] = color;
+        log_change(head, color, true);
+    }
+
+    return true;
+}
+
+enum Color fake_led_color(uint32_t head)
+{
+    return colors[head];
+}
+
+size_t fake_led_changes(const struct fake_led_change_t **out)
+{
+    *out = changes;
+    return MIN(change_count, FAKE_LED_LOG_SIZE);
+}
+
+void fake_led_clear(void)
+{
+    change_count = 0;
+}
+
+void fake_led_hardware_blink(bool supported)
+{
+    hardware_blink = supported;
+}
+
+bool uart_rx_init(const struct device *dev)
+{
+    return true;
+}
+
+void uart_rx_getc(char *c)
+{
+    if (input_pos == input_len) {
+        shim_thread_block();
+    }
+
+    *c = input[input_pos++];
+}
+
+void uart_rx_discard(void)
+{
+    input_pos = input_len;
+}
+
+void fake_uart_input(const char *data, size_t len)
+{
+    size_t left = input_len - input_pos;
+    char *buf = malloc(left + len + 1);
+
+    if (buf == NULL) {
+        abort();
+    }
+
+    if (left > 0) {
+        memcpy(buf, input + input_pos, left);
+    }
+    memcpy(buf + left, data, len);
+    free(input);
+    input = buf;
+    input_len = left + len;
+    input_pos = 0;
+}
@@ -0,0 +1,47 @@
+#ifndef FAKES_H
+#define FAKES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ledctl.h"
+
+/*
+    Fake drivers of the host builds, in place of led_gpio.c and uartrx.c. The led backend keeps the color of every head
+    and a log of the changes, the UART receive side hands out the bytes a test gave it and then blocks for good.
+*/
+
+// Changes kept in the led log, later ones are counted but not kept
+#define FAKE_LED_LOG_SIZE 4096
+
+struct fake_led_change_t {
+    // Simulated uptime of the change
+    int64_t ms;
+    uint32_t head;
+    enum Color color;
+    // Blinking in hardware instead of steadily on
+    bool blinking;
+};
+
+enum Color fake_led_color(uint32_t head);
+
+// Changes since the last clear, returns how many there were
+size_t fake_led_changes(const struct fake_led_change_t **changes);
+void fake_led_clear(void);
+
+// Whether `led_backend_blink` blinks in hardware, like the PWM backend, or leaves it to the engine
+void fake_led_hardware_blink(bool supported);
+
+// Bytes for `uart_rx_getc` to return, after the ones that have not been read yet
+void fake_uart_input(const char *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FAKES_H
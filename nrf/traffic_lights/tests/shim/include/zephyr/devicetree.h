@@ -0,0 +1,9 @@
+#ifndef SHIM_ZEPHYR_DEVICETREE_H
+#define SHIM_ZEPHYR_DEVICETREE_H
+
+// The host has no devicetree: no traffic lights heads node, so the topology is the single default head
+#define DT_HAS_COMPAT_STATUS_OKAY(compat) 0
+#define DT_CHOSEN(prop) prop
+#define DT_ALIAS(alias) alias
+
+#endif // SHIM_ZEPHYR_DEVICETREE_H
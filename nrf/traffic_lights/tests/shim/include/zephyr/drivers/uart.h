@@ -0,0 +1,17 @@
+#ifndef SHIM_ZEPHYR_DRIVERS_UART_H
+#define SHIM_ZEPHYR_DRIVERS_UART_H
+
+#include <zephyr/device.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Appends to the same console output as printk
+void uart_poll_out(const struct device *dev, unsigned char out_char);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHIM_ZEPHYR_DRIVERS_UART_H
@@ -0,0 +1,36 @@
+#ifndef SHIM_ZEPHYR_INIT_H
+#define SHIM_ZEPHYR_INIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum shim_init_level {
+    SHIM_INIT_PRE_KERNEL_1,
+    SHIM_INIT_PRE_KERNEL_2,
+    SHIM_INIT_POST_KERNEL,
+    SHIM_INIT_APPLICATION,
+};
+
+struct shim_init_entry {
+    int (*init_fn)(void);
+    enum shim_init_level level;
+    int priority;
+    struct shim_init_entry *next;
+};
+
+void shim_init_register(struct shim_init_entry *entry);
+
+// Registered when the program loads, run in level and priority order by `shim_boot`
+#define SYS_INIT(init_fn, level, prio) \
+    static void __attribute__((constructor)) shim_register_##init_fn(void) \
+    { \
+        static struct shim_init_entry entry = { init_fn, SHIM_INIT_##level, prio, 0 }; \
+        shim_init_register(&entry); \
+    }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHIM_ZEPHYR_INIT_H
@@ -0,0 +1,211 @@
+/* Host stand-in for the part of the Zephyr kernel API the firmware uses. There are no threads: work items, delayed work
+ * and timers run on the test thread against a simulated clock when the test lets time pass, and a blocking call lets
+ * the simulated system run until what it waits for happens. See shim.h for the side the tests drive.
+ */
+
+#ifndef SHIM_ZEPHYR_KERNEL_H
+#define SHIM_ZEPHYR_KERNEL_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <zephyr/init.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Timeouts in microseconds of the simulated clock, relative to now unless `abs` is set
+typedef struct {
+    int64_t us;
+    bool abs;
+} k_timeout_t;
+
+#define K_FOREVER ((k_timeout_t){ INT64_MAX, false })
+#define K_NO_WAIT ((k_timeout_t){ 0, false })
+#define K_USEC(t) ((k_timeout_t){ (int64_t)(t), false })
+#define K_MSEC(t) ((k_timeout_t){ (int64_t)(t) * 1000, false })
+#define K_SECONDS(t) ((k_timeout_t){ (int64_t)(t) * 1000000, false })
+#define K_TIMEOUT_ABS_MS(t) ((k_timeout_t){ (int64_t)(t) * 1000, true })
+#define K_TIMEOUT_EQ(a, b) ((a).us == (b).us && (a).abs == (b).abs)
+
+// Clock. Kernel cycles are microseconds.
+int64_t k_uptime_get(void);
+uint32_t k_cycle_get_32(void);
+uint64_t k_cycle_get_64(void);
+
+static inline uint32_t k_uptime_get_32(void)
+{
+    return (uint32_t)k_uptime_get();
+}
+
+static inline uint32_t k_cyc_to_us_floor32(uint32_t cycles)
+{
+    return cycles;
+}
+
+static inline uint64_t k_cyc_to_us_floor64(uint64_t cycles)
+{
+    return cycles;
+}
+
+static inline uint32_t k_cyc_to_ms_floor32(uint32_t cycles)
+{
+    return cycles / 1000;
+}
+
+static inline uint64_t k_cyc_to_ms_floor64(uint64_t cycles)
+{
+    return cycles / 1000;
+}
+
+static inline uint64_t k_cyc_to_ns_floor64(uint64_t cycles)
+{
+    return cycles * 1000;
+}
+
+// Threads only exist as entry functions, a test runs one with `shim_thread_run`
+typedef void (*k_thread_entry_t)(void *p1, void *p2, void *p3);
+typedef struct k_thread *k_tid_t;
+
+#define K_THREAD_DEFINE(name, stack_size, entry, p1, p2, p3, prio, options, delay) const k_tid_t name = NULL
+#define K_THREAD_STACK_DEFINE(name, size) char name[size]
+#define K_THREAD_STACK_SIZEOF(name) sizeof(name)
+
+// Work queues. Every queue runs on the test thread, in the order the work was submitted.
+struct k_work;
+typedef void (*k_work_handler_t)(struct k_work *work);
+
+struct k_work {
+    k_work_handler_t handler;
+    struct k_work *next;
+    bool queued;
+};
+
+struct k_work_delayable {
+    struct k_work work;
+    int64_t deadline_us;
+    bool scheduled;
+    bool registered;
+    struct k_work_delayable *next_registered;
+};
+
+struct k_work_q {
+    const char *name;
+    bool started;
+};
+
+struct k_work_queue_config {
+    const char *name;
+    bool no_yield;
+    bool essential;
+};
+
+#define K_WORK_DEFINE(name, work_handler) struct k_work name = { .handler = (work_handler) }
+#define K_WORK_DELAYABLE_DEFINE(name, work_handler) struct k_work_delayable name = { .work = { .handler = (work_handler) } }
+
+void k_work_init(struct k_work *work, k_work_handler_t handler);
+int k_work_submit_to_queue(struct k_work_q *queue, struct k_work *work);
+int k_work_submit(struct k_work *work);
+void k_work_init_delayable(struct k_work_delayable *dwork, k_work_handler_t handler);
+int k_work_schedule_for_queue(struct k_work_q *queue, struct k_work_delayable *dwork, k_timeout_t delay);
+int k_work_schedule(struct k_work_delayable *dwork, k_timeout_t delay);
+int k_work_reschedule_for_queue(struct k_work_q *queue, struct k_work_delayable *dwork, k_timeout_t delay);
+int k_work_reschedule(struct k_work_delayable *dwork, k_timeout_t delay);
+int k_work_cancel_delayable(struct k_work_delayable *dwork);
+bool k_work_delayable_is_pending(const struct k_work_delayable *dwork);
+struct k_work_delayable *k_work_delayable_from_work(struct k_work *work);
+void k_work_queue_init(struct k_work_q *queue);
+void k_work_queue_start(struct k_work_q *queue, void *stack, size_t stack_size, int prio,
+    const struct k_work_queue_config *cfg);
+
+// Spinlocks. With a single thread they only catch taking a lock twice.
+struct k_spinlock {
+    bool locked;
+};
+
+typedef int k_spinlock_key_t;
+
+k_spinlock_key_t k_spin_lock(struct k_spinlock *lock);
+void k_spin_unlock(struct k_spinlock *lock, k_spinlock_key_t key);
+
+// Semaphores
+struct k_sem {
+    unsigned int count;
+    unsigned int limit;
+};
+
+#define K_SEM_DEFINE(name, initial_count, count_limit) struct k_sem name = { (initial_count), (count_limit) }
+
+int k_sem_init(struct k_sem *sem, unsigned int initial_count, unsigned int limit);
+void k_sem_give(struct k_sem *sem);
+int k_sem_take(struct k_sem *sem, k_timeout_t timeout);
+void k_sem_reset(struct k_sem *sem);
+unsigned int k_sem_count_get(struct k_sem *sem);
+
+// FIFOs keep their list in the first word of every item, like Zephyr
+struct k_fifo {
+    void *head;
+    void *tail;
+};
+
+#define K_FIFO_DEFINE(name) struct k_fifo name = { NULL, NULL }
+
+void k_fifo_put(struct k_fifo *fifo, void *data);
+void *k_fifo_get(struct k_fifo *fifo, k_timeout_t timeout);
+bool k_fifo_is_empty(struct k_fifo *fifo);
+
+// Memory slabs of fixed size blocks
+struct k_mem_slab {
+    char *buffer;
+    size_t block_size;
+    uint32_t num_blocks;
+    uint32_t num_used;
+    void *free_list;
+    bool ready;
+};
+
+#define K_MEM_SLAB_DEFINE(name, slab_block_size, slab_num_blocks, slab_align) \
+    static char __aligned(slab_align) name##_buffer[ROUND_UP(slab_block_size, slab_align) * (slab_num_blocks)]; \
+    struct k_mem_slab name = { name##_buffer, ROUND_UP(slab_block_size, slab_align), (slab_num_blocks), 0, NULL, false }
+
+int k_mem_slab_alloc(struct k_mem_slab *slab, void **mem, k_timeout_t timeout);
+void k_mem_slab_free(struct k_mem_slab *slab, void *mem);
+uint32_t k_mem_slab_num_free_get(struct k_mem_slab *slab);
+uint32_t k_mem_slab_num_used_get(struct k_mem_slab *slab);
+
+// Timers expire on the simulated clock like delayed work
+struct k_timer;
+typedef void (*k_timer_expiry_t)(struct k_timer *timer);
+typedef void (*k_timer_stop_t)(struct k_timer *timer);
+
+struct k_timer {
+    k_timer_expiry_t expiry_fn;
+    k_timer_stop_t stop_fn;
+    int64_t deadline_us;
+    int64_t period_us;
+    uint32_t status;
+    bool running;
+    bool registered;
+    struct k_timer *next_registered;
+};
+
+#define K_TIMER_DEFINE(name, expiry, stop) struct k_timer name = { .expiry_fn = (expiry), .stop_fn = (stop) }
+
+void k_timer_init(struct k_timer *timer, k_timer_expiry_t expiry_fn, k_timer_stop_t stop_fn);
+void k_timer_start(struct k_timer *timer, k_timeout_t duration, k_timeout_t period);
+void k_timer_stop(struct k_timer *timer);
+uint32_t k_timer_status_get(struct k_timer *timer);
+uint32_t k_timer_remaining_get(struct k_timer *timer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHIM_ZEPHYR_KERNEL_H
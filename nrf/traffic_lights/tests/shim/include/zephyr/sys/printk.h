@@ -0,0 +1,18 @@
+#ifndef SHIM_ZEPHYR_SYS_PRINTK_H
+#define SHIM_ZEPHYR_SYS_PRINTK_H
+
+#include <stdarg.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Formats like printf into the console output that the tests read back, see shim.h
+void printk(const char *fmt, ...);
+void vprintk(const char *fmt, va_list args);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHIM_ZEPHYR_SYS_PRINTK_H
@@ -0,0 +1,39 @@
+#ifndef SHIM_ZEPHYR_SYS_UTIL_H
+#define SHIM_ZEPHYR_SYS_UTIL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+#define BUILD_ASSERT(cond, ...) static_assert(cond, "" __VA_ARGS__)
+#else
+#define BUILD_ASSERT(cond, ...) _Static_assert(cond, "" __VA_ARGS__)
+#endif
+
+#define BIT(n) (1UL << (n))
+#define BIT_MASK(n) (BIT(n) - 1UL)
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#define ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+#define ROUND_UP(x, align) ((((x) + (align) - 1) / (align)) * (align))
+#define CONTAINER_OF(ptr, type, field) ((type *)(((char *)(ptr)) - offsetof(type, field)))
+
+#define __aligned(x) __attribute__((aligned(x)))
+#define __packed __attribute__((packed))
+#define __unused __attribute__((unused))
+
+// FOR_EACH of up to eight arguments, enough for the debug messages
+#define Z_SHIM_DEBRACKET(...) __VA_ARGS__
+#define Z_SHIM_FE_1(F, sep, x) F(x)
+#define Z_SHIM_FE_2(F, sep, x, ...) F(x) Z_SHIM_DEBRACKET sep Z_SHIM_FE_1(F, sep, __VA_ARGS__)
+#define Z_SHIM_FE_3(F, sep, x, ...) F(x) Z_SHIM_DEBRACKET sep Z_SHIM_FE_2(F, sep, __VA_ARGS__)
+#define Z_SHIM_FE_4(F, sep, x, ...) F(x) Z_SHIM_DEBRACKET sep Z_SHIM_FE_3(F, sep, __VA_ARGS__)
+#define Z_SHIM_FE_5(F, sep, x, ...) F(x) Z_SHIM_DEBRACKET sep Z_SHIM_FE_4(F, sep, __VA_ARGS__)
+#define Z_SHIM_FE_6(F, sep, x, ...) F(x) Z_SHIM_DEBRACKET sep Z_SHIM_FE_5(F, sep, __VA_ARGS__)
+#define Z_SHIM_FE_7(F, sep, x, ...) F(x) Z_SHIM_DEBRACKET sep Z_SHIM_FE_6(F, sep, __VA_ARGS__)
+#define Z_SHIM_FE_8(F, sep, x, ...) F(x) Z_SHIM_DEBRACKET sep Z_SHIM_FE_7(F, sep, __VA_ARGS__)
+#define Z_SHIM_FE_PICK(_1, _2, _3, _4, _5, _6, _7, _8, name, ...) name
+#define FOR_EACH(F, sep, ...) \
+    Z_SHIM_FE_PICK(__VA_ARGS__, Z_SHIM_FE_8, Z_SHIM_FE_7, Z_SHIM_FE_6, Z_SHIM_FE_5, Z_SHIM_FE_4, Z_SHIM_FE_3, \
+        Z_SHIM_FE_2, Z_SHIM_FE_1)(F, sep, __VA_ARGS__)
+
+#endif // SHIM_ZEPHYR_SYS_UTIL_H
@@ -0,0 +1,46 @@
+#ifndef SHIM_ZEPHYR_TIMING_TIMING_H
+#define SHIM_ZEPHYR_TIMING_TIMING_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Timing cycles are microseconds of the simulated clock, like the kernel cycles
+typedef uint64_t timing_t;
+
+static inline void timing_init(void)
+{
+}
+
+static inline void timing_start(void)
+{
+}
+
+static inline void timing_stop(void)
+{
+}
+
+timing_t timing_counter_get(void);
+
+static inline uint64_t timing_cycles_get(volatile timing_t *const start, volatile timing_t *const end)
+{
+    return *end - *start;
+}
+
+static inline uint64_t timing_cycles_to_ns(uint64_t cycles)
+{
+    return cycles * 1000;
+}
+
+static inline uint32_t timing_freq_get_mhz(void)
+{
+    return 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHIM_ZEPHYR_TIMING_TIMING_H
@@ -0,0 +1,683 @@
+/* Host implementation of the Zephyr shim. One simulated clock in microseconds drives the work queues and timers, and
+ * the console output is collected in memory for the tests to read.
+ */
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/timing/timing.h>
+
+#include "shim.h"
+
+#define NO_DEADLINE INT64_MAX
+
+static int64_t now_us;
+
+// Submitted work in order, and every delayed work item and timer that has ever been started
+static struct k_work *work_head;
+static struct k_work *work_tail;
+static struct k_work_delayable *delayables;
+static struct k_timer *timers;
+
+// What a test runs once when a timer is about to be stopped
+static struct k_timer *stop_timer;
+static void (*stop_fn)(void);
+
+static struct shim_init_entry *inits;
+static bool booted;
+
+// Where a blocked thread returns to, NULL when the test thread itself is running
+static jmp_buf *thread_exit;
+
+static char *output;
+static size_t output_len;
+static size_t output_size;
+
+const struct device shim_uart_device = { "uart" };
+
+static void fail(const char *message)
+{
+    fprintf(stderr, "zephyr shim: %s\n", message);
+    abort();
+}
+
+// Clock
+
+int64_t shim_now_us(void)
+{
+    return now_us;
+}
+
+int64_t k_uptime_get(void)
+{
+    return now_us / 1000;
+}
+
+uint32_t k_cycle_get_32(void)
+{
+    return (uint32_t)now_us;
+}
+
+uint64_t k_cycle_get_64(void)
+{
+    return (uint64_t)now_us;
+}
+
+timing_t timing_counter_get(void)
+{
+    return (timing_t)now_us;
+}
+
+static int64_t deadline_of(k_timeout_t timeout)
+{
+    if (timeout.abs) {
+        return timeout.us;
+    }
+
+    return timeout.us == INT64_MAX ? NO_DEADLINE : now_us + timeout.us;
+}
+
+// Scheduler
+
+static int64_t next_deadline(void)
+{
+    int64_t next = NO_DEADLINE;
+
+    for (struct k_work_delayable *dwork = delayables; dwork != NULL; dwork = dwork->next_registered) {
+        if (dwork->scheduled) {
+            next = MIN(next, dwork->deadline_us);
+        }
+    }
+
+    for (struct k_timer *timer = timers; timer != NULL; timer = timer->next_registered) {
+        if (timer->running) {
+            next = MIN(next, timer->deadline_us);
+        }
+    }
+
+    return next;
+}
+
+// Run one piece of work that is due, submitted work first and then the earliest deadline. Returns false if none is.
+static bool run_one(void)
+{
+    if (work_head != NULL) {
+        struct k_work *work = work_head;
+
+        work_head = work->next;
+        if (work_head == NULL) {
+            work_tail = NULL;
+        }
+
+        work->queued = false;
+        work->handler(work);
+        return true;
+    }
+
+    struct k_work_delayable *due_work = NULL;
+    struct k_timer *due_timer = NULL;
+    int64_t due = now_us;
+
+    for (struct k_work_delayable *dwork = delayables; dwork != NULL; dwork = dwork->next_registered) {
+        if (dwork->scheduled && dwork->deadline_us <= due && (due_work == NULL || dwork->deadline_us < due)) {
+            due_work = dwork;
+            due = dwork->deadline_us;
+        }
+    }
+
+    for (struct k_timer *timer = timers; timer != NULL; timer = timer->next_registered) {
+        if (timer->running && timer->deadline_us <= due && (due_timer == NULL || timer->deadline_us < due)) {
+            due_timer = timer;
+            due = timer->deadline_us;
+        }
+    }
+
+    // A timer due at the same time as a work item runs after it
+    if (due_timer != NULL && (due_work == NULL || due_timer->deadline_us < due_work->deadline_us)) {
+        if (due_timer->period_us > 0) {
+            due_timer->deadline_us += due_timer->period_us;
+        } else {
+            due_timer->running = false;
+        }
+
+        due_timer->status++;
+        if (due_timer->expiry_fn != NULL) {
+            due_timer->expiry_fn(due_timer);
+        }
+        return true;
+    }
+
+    if (due_work != NULL) {
+        due_work->scheduled = false;
+        due_work->work.handler(&due_work->work);
+        return true;
+    }
+
+    return false;
+}
+
+void shim_run(void)
+{
+    while (run_one()) {
+    }
+}
+
+static void advance_to(int64_t end)
+{
+    shim_run();
+
+    for (int64_t next = next_deadline(); next <= end; next = next_deadline()) {
+        now_us = MAX(now_us, next);
+        shim_run();
+    }
+
+    now_us = MAX(now_us, end);
+    shim_run();
+}
+
+void shim_advance_ms(int64_t ms)
+{
+    advance_to(now_us + ms * 1000);
+}
+
+bool shim_advance_next(void)
+{
+    shim_run();
+
+    int64_t next = next_deadline();
+
+    if (next == NO_DEADLINE) {
+        return false;
+    }
+
+    now_us = MAX(now_us, next);
+    shim_run();
+    return true;
+}
+
+/*
+    Let the simulated system run until `ready` holds or the timeout passes. A thread waiting forever gives up when there
+    is nothing left on the clock that could wake it up.
+*/
+static bool wait_until(bool (*ready)(void *), void *arg, k_timeout_t timeout)
+{
+    if (ready(arg)) {
+        return true;
+    }
+
+    if (K_TIMEOUT_EQ(timeout, K_NO_WAIT)) {
+        return false;
+    }
+
+    bool forever = K_TIMEOUT_EQ(timeout, K_FOREVER);
+    int64_t end = forever ? now_us + (int64_t)SHIM_WAIT_LIMIT_MS * 1000 : deadline_of(timeout);
+
+    shim_run();
+
+    while (!ready(arg)) {
+        int64_t next = next_deadline();
+
+        if (next > end) {
+            if (forever) {
+                shim_thread_block();
+            }
+
+            advance_to(end);
+            return ready(arg);
+        }
+
+        now_us = MAX(now_us, next);
+        shim_run();
+    }
+
+    return true;
+}
+
+// Init and threads
+
+void shim_init_register(struct shim_init_entry *entry)
+{
+    struct shim_init_entry **at = &inits;
+
+    // Keep the list sorted, entries of the same level and priority in the order they were registered
+    while (*at != NULL && ((*at)->level < entry->level ||
+        ((*at)->level == entry->level && (*at)->priority <= entry->priority))) {
+        at = &(*at)->next;
+    }
+
+    entry->next = *at;
+    *at = entry;
+}
+
+int shim_boot(void)
+{
+    int first_error = 0;
+
+    if (booted) {
+        return 0;
+    }
+
+    booted = true;
+
+    for (struct shim_init_entry *entry = inits; entry != NULL; entry = entry->next) {
+        int ret = entry->init_fn();
+
+        if (ret != 0 && first_error == 0) {
+            first_error = ret;
+        }
+    }
+
+    return first_error;
+}
+
+void shim_thread_run(k_thread_entry_t entry)
+{
+    jmp_buf exit;
+    jmp_buf *volatile outer = thread_exit;
+
+    thread_exit = &exit;
+
+    if (setjmp(exit) == 0) {
+        entry(NULL, NULL, NULL);
+    }
+
+    thread_exit = outer;
+}
+
+void shim_thread_block(void)
+{
+    if (thread_exit == NULL) {
+        fail("the test thread would block forever");
+    }
+
+    longjmp(*thread_exit, 1);
+}
+
+// Work queues
+
+void k_work_init(struct k_work *work, k_work_handler_t handler)
+{
+    memset(work, 0, sizeof(*work));
+    work->handler = handler;
+}
+
+int k_work_submit_to_queue(struct k_work_q *queue, struct k_work *work)
+{
+    if (work->queued) {
+        return 0;
+    }
+
+    work->queued = true;
+    work->next = NULL;
+
+    if (work_tail != NULL) {
+        work_tail->next = work;
+    } else {
+        work_head = work;
+    }
+    work_tail = work;
+    return 1;
+}
+
+int k_work_submit(struct k_work *work)
+{
+    return k_work_submit_to_queue(NULL, work);
+}
+
+void k_work_init_delayable(struct k_work_delayable *dwork, k_work_handler_t handler)
+{
+    memset(dwork, 0, sizeof(*dwork));
+    dwork->work.handler = handler;
+}
+
+int k_work_reschedule_for_queue(struct k_work_q *queue, struct k_work_delayable *dwork, k_timeout_t delay)
+{
+    if (!dwork->registered) {
+        dwork->registered = true;
+        dwork->next_registered = delayables;
+        delayables = dwork;
+    }
+
+    dwork->deadline_us = deadline_of(delay);
+    dwork->scheduled = dwork->deadline_us != NO_DEADLINE;
+    return 1;
+}
+
+int k_work_reschedule(struct k_work_delayable *dwork, k_timeout_t delay)
+{
+    return k_work_reschedule_for_queue(NULL, dwork, delay);
+}
+
+int k_work_schedule_for_queue(struct k_work_q *queue, struct k_work_delayable *dwork, k_timeout_t delay)
+{
+    if (dwork->scheduled) {
+        return 0;
+    }
+
+    return k_work_reschedule_for_queue(queue, dwork, delay);
+}
+
+int k_work_schedule(struct k_work_delayable *dwork, k_timeout_t delay)
+{
+    return k_work_schedule_for_queue(NULL, dwork, delay);
+}
+
+int k_work_cancel_delayable(struct k_work_delayable *dwork)
+{
+    dwork->scheduled = false;
+    return 0;
+}
+
+bool k_work_delayable_is_pending(const struct k_work_delayable *dwork)
+{
+    return dwork->scheduled;
+}
+
+struct k_work_delayable *k_work_delayable_from_work(struct k_work *work)
+{
+    return CONTAINER_OF(work, struct k_work_delayable, work);
+}
+
+void k_work_queue_init(struct k_work_q *queue)
+{
+    memset(queue, 0, sizeof(*queue));
+}
+
+void k_work_queue_start(struct k_work_q *queue, void *stack, size_t stack_size, int prio,
+    const struct k_work_queue_config *cfg)
+{
+    queue->name = cfg != NULL ? cfg->name : NULL;
+    queue->started = true;
+}
+
+// Spinlocks
+
+k_spinlock_key_t k_spin_lock(struct k_spinlock *lock)
+{
+    if (lock->locked) {
+        fail("spinlock taken twice");
+    }
+
+    lock->locked = true;
+    return 0;
+}
+
+void k_spin_unlock(struct k_spinlock *lock, k_spinlock_key_t key)
+{
+    lock->locked = false;
+}
+
+// Semaphores
+
+int k_sem_init(struct k_sem *sem, unsigned int initial_count, unsigned int limit)
+{
+    sem->count = initial_count;
+    sem->limit = limit;
+    return 0;
+}
+
+void k_sem_give(struct k_sem *sem)
+{
+    if (sem->count < sem->limit) {
+        sem->count++;
+    }
+}
+
+static bool sem_ready(void *arg)
+{
+    return ((struct k_sem *)arg)->count > 0;
+}
+
+int k_sem_take(struct k_sem *sem, k_timeout_t timeout)
+{
+    if (!wait_until(sem_ready, sem, timeout)) {
+        return K_TIMEOUT_EQ(timeout, K_NO_WAIT) ? -EBUSY : -EAGAIN;
+    }
+
+    sem->count--;
+    return 0;
+}
+
+void k_sem_reset(struct k_sem *sem)
+{
+    sem->count = 0;
+}
+
+unsigned int k_sem_count_get(struct k_sem *sem)
+{
+    return sem->count;
+}
+
+// FIFOs
+
+void k_fifo_put(struct k_fifo *fifo, void *data)
+{
+    *(void **)data = NULL;
+
+    if (fifo->tail != NULL) {
+        *(void **)fifo->tail = data;
+    } else {
+        fifo->head = data;
+    }
+    fifo->tail = data;
+}
+
+static bool fifo_ready(void *arg)
+{
+    return ((struct k_fifo *)arg)->head != NULL;
+}
+
+void *k_fifo_get(struct k_fifo *fifo, k_timeout_t timeout)
+{
+    if (!wait_until(fifo_ready, fifo, timeout)) {
+        return NULL;
+    }
+
+    void *data = fifo->head;
+
+    fifo->head = *(void **)data;
+    if (fifo->head == NULL) {
+        fifo->tail = NULL;
+    }
+
+    return data;
+}
+
+bool k_fifo_is_empty(struct k_fifo *fifo)
+{
+    return fifo->head == NULL;
+}
+
+// Memory slabs
+
+static void slab_prepare(struct k_mem_slab *slab)
+{
+    if (slab->ready) {
+        return;
+    }
+
+    slab->ready = true;
+    slab->free_list = NULL;
+
+    for (uint32_t i = slab->num_blocks; i > 0; i--) {
+        void *block = slab->buffer + (i - 1) * slab->block_size;
+
+        *(void **)block = slab->free_list;
+        slab->free_list = block;
+    }
+}
+
+static bool slab_ready(void *arg)
+{
+    return ((struct k_mem_slab *)arg)->free_list != NULL;
+}
+
+int k_mem_slab_alloc(struct k_mem_slab *slab, void **mem, k_timeout_t timeout)
+{
+    slab_prepare(slab);
+
+    if (!wait_until(slab_ready, slab, timeout)) {
+        *mem = NULL;
+        return K_TIMEOUT_EQ(timeout, K_NO_WAIT) ? -ENOMEM : -EAGAIN;
+    }
+
+    *mem = slab->free_list;
+    slab->free_list = *(void **)*mem;
+    slab->num_used++;
+    return 0;
+}
+
+void k_mem_slab_free(struct k_mem_slab *slab, void *mem)
+{
+    char *block = mem;
+
+    if (block < slab->buffer || block >= slab->buffer + slab->num_blocks * slab->block_size ||
+        (size_t)(block - slab->buffer) % slab->block_size != 0) {
+        fail("freeing a block that is not from the slab");
+    }
+
+    *(void **)mem = slab->free_list;
+    slab->free_list = mem;
+    slab->num_used--;
+}
+
+uint32_t k_mem_slab_num_free_get(struct k_mem_slab *slab)
+{
+    slab_prepare(slab);
+    return slab->num_blocks - slab->num_used;
+}
+
+uint32_t k_mem_slab_num_used_get(struct k_mem_slab *slab)
+{
+    return slab->num_used;
+}
+
+// Timers
+
+void k_timer_init(struct k_timer *timer, k_timer_expiry_t expiry_fn, k_timer_stop_t stop_fn)
+{
+    memset(timer, 0, sizeof(*timer));
+    timer->expiry_fn = expiry_fn;
+    timer->stop_fn = stop_fn;
+}
+
+void k_timer_start(struct k_timer *timer, k_timeout_t duration, k_timeout_t period)
+{
+    if (!timer->registered) {
+        timer->registered = true;
+        timer->next_registered = timers;
+        timers = timer;
+    }
+
+    timer->deadline_us = deadline_of(duration);
+    timer->period_us = K_TIMEOUT_EQ(period, K_FOREVER) ? 0 : period.us;
+    timer->status = 0;
+    timer->running = timer->deadline_us != NO_DEADLINE;
+}
+
+void shim_before_timer_stop(struct k_timer *timer, void (*fn)(void))
+{
+    stop_timer = timer;
+    stop_fn = fn;
+}
+
+void k_timer_stop(struct k_timer *timer)
+{
+    if (timer == stop_timer) {
+        void (*fn)(void) = stop_fn;
+
+        stop_timer = NULL;
+        stop_fn = NULL;
+        fn();
+    }
+
+    bool was_running = timer->running;
+
+    timer->running = false;
+
+    if (was_running && timer->stop_fn != NULL) {
+        timer->stop_fn(timer);
+    }
+}
+
+uint32_t k_timer_status_get(struct k_timer *timer)
+{
+    uint32_t status = timer->status;
+
+    timer->status = 0;
+    return status;
+}
+
+uint32_t k_timer_remaining_get(struct k_timer *timer)
+{
+    if (!timer->running) {
+        return 0;
+    }
+
+    return (uint32_t)((timer->deadline_us - now_us) / 1000);
+}
+
+// Console
+
+static void output_append(const char *data, size_t len)
+{
+    if (output_len + len + 1 > output_size) {
+        output_size = MAX(output_size * 2, output_len + len + 1);
+        output = realloc(output, output_size);
+
+        if (output == NULL) {
+            fail("out of memory for the console output");
+        }
+    }
+
+    memcpy(output + output_len, data, len);
+    output_len += len;
+    output[output_len] = '\0';
+}
+
+void vprintk(const char *fmt, va_list args)
+{
+    char line[256];
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+
+    if (len > 0) {
+        output_append(line, MIN((size_t)len, sizeof(line) - 1));
+    }
+}
+
+void printk(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    vprintk(fmt, args);
+    va_end(args);
+}
+
+void uart_poll_out(const struct device *dev, unsigned char out_char)
+{
+    output_append((const char *)&out_char, 1);
+}
+
+const char *shim_output(void)
+{
+    return output != NULL ? output : "";
+}
+
+size_t shim_output_len(void)
+{
+    return output_len;
+}
+
+void shim_output_clear(void)
+{
+    output_len = 0;
+
+    if (output != NULL) {
+        output[0] = '\0';
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef SHIM_H
+#define SHIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/kernel.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+    Control of the host Zephyr shim. The simulated clock starts at zero and only moves when a test lets it: everything
+    that comes due on the way runs in deadline order, work submitted to a queue first. A blocking call with a timeout
+    moves the clock the same way until it is satisfied. A thread that would block forever with nothing left on the
+    clock, or for more than SHIM_WAIT_LIMIT_MS, gives up and control returns to the test.
+*/
+
+#define SHIM_WAIT_LIMIT_MS (60 * 60 * 1000)
+
+// Run the SYS_INIT functions in level and priority order, once. Returns the first error of one of them or 0.
+int shim_boot(void);
+
+// Run the submitted work and everything that is due without moving the clock
+void shim_run(void);
+
+// Let `ms` of simulated time pass
+void shim_advance_ms(int64_t ms);
+
+// Let time pass up to the next deadline and run what is due then. Returns false if nothing is scheduled.
+bool shim_advance_next(void);
+
+int64_t shim_now_us(void);
+
+/*
+    Run a thread entry on the test thread until it returns or blocks for good, like a UART task that has read all of its
+    input. A thread is started from the top every time, its locals are gone after it blocks.
+*/
+void shim_thread_run(k_thread_entry_t entry);
+
+// Block the running thread for good, from a fake driver that has nothing more to give
+void shim_thread_block(void);
+
+/*
+    Run `fn` once right before the next k_timer_stop of `timer` takes effect, like an interrupt that comes in between the
+    last check of a thread and the stop.
+*/
+void shim_before_timer_stop(struct k_timer *timer, void (*fn)(void));
+
+// Everything printed with printk and sent with uart_poll_out, with a zero after it. The length counts binary zeros.
+const char *shim_output(void);
+size_t shim_output_len(void);
+void shim_output_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHIM_H
@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+#include "../../src/alarmheap.h"
+
+class AlarmHeapTest : public ::testing::Test {
+protected:
+    static constexpr uint32_t Capacity = 64;
+
+    struct alarm_t alarms[Capacity];
+    uint16_t order[Capacity];
+    struct alarm_heap_t heap;
+
+    void SetUp() override {
+        alarm_heap_init(&heap, alarms, order, Capacity);
+    }
+
+    // Pop every alarm due at `now`, returning their args in the order they went off
+    std::vector<uint8_t> pop_all(int64_t now) {
+        std::vector<uint8_t> args;
+        struct alarm_t out;
+
+        while (alarm_heap_pop_due(&heap, now, &out) >= 0) {
+            args.push_back(out.arg);
+        }
+        return args;
+    }
+};
+
+TEST_F(AlarmHeapTest, TestCaseEmpty) {
+    struct alarm_t out;
+    int64_t next;
+
+    ASSERT_FALSE(alarm_heap_next(&heap, &next));
+    ASSERT_EQ(alarm_heap_pop_due(&heap, INT64_MAX, &out), -1);
+    ASSERT_FALSE(alarm_heap_cancel(&heap, 0));
+    ASSERT_FALSE(alarm_heap_cancel(&heap, -1));
+}
+
+TEST_F(AlarmHeapTest, TestCaseEarliestFirst) {
+    const int64_t deadlines[] = { 500, 100, 900, 300, 700 };
+    int64_t next;
+
+    for (uint8_t i = 0; i < 5; i++) {
+        ASSERT_GE(alarm_heap_add(&heap, deadlines[i], 0, i), 0);
+    }
+
+    ASSERT_TRUE(alarm_heap_next(&heap, &next));
+    ASSERT_EQ(next, 100);
+
+    // Only what is due goes off
+    ASSERT_EQ(pop_all(99), std::vector<uint8_t>{});
+    ASSERT_EQ(pop_all(500), (std::vector<uint8_t>{ 1, 3, 0 }));
+    ASSERT_TRUE(alarm_heap_next(&heap, &next));
+    ASSERT_EQ(next, 700);
+    ASSERT_EQ(pop_all(1000), (std::vector<uint8_t>{ 4, 2 }));
+    ASSERT_FALSE(alarm_heap_next(&heap, &next));
+}
+
+TEST_F(AlarmHeapTest, TestCaseSameDeadlineInOrderAdded) {
+    for (uint8_t i = 0; i < 10; i++) {
+        alarm_heap_add(&heap, 100, 0, i);
+    }
+
+    ASSERT_EQ(pop_all(100), (std::vector<uint8_t>{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }));
+}
+
+TEST_F(AlarmHeapTest, TestCaseActionAndArgAreKept) {
+    struct alarm_t out;
+    int32_t id = alarm_heap_add(&heap, 10, 2, 7);
+
+    ASSERT_EQ(alarm_heap_pop_due(&heap, 10, &out), id);
+    ASSERT_EQ(out.deadline, 10);
+    ASSERT_EQ(out.action, 2);
+    ASSERT_EQ(out.arg, 7);
+}
+
+TEST_F(AlarmHeapTest, TestCaseCancel) {
+    int32_t first = alarm_heap_add(&heap, 100, 0, 0);
+    int32_t second = alarm_heap_add(&heap, 200, 0, 1);
+    int64_t next;
+
+    ASSERT_TRUE(alarm_heap_cancel(&heap, first));
+    ASSERT_FALSE(alarm_heap_cancel(&heap, first));
+    ASSERT_TRUE(alarm_heap_next(&heap, &next));
+    ASSERT_EQ(next, 200);
+    ASSERT_EQ(pop_all(1000), std::vector<uint8_t>{ 1 });
+    // Gone off already
+    ASSERT_FALSE(alarm_heap_cancel(&heap, second));
+}
+
+TEST_F(AlarmHeapTest, TestCaseOldIdDoesNotCancelTheNextAlarmOfTheSlot) {
+    int32_t old = alarm_heap_add(&heap, 100, 0, 0);
+
+    ASSERT_TRUE(alarm_heap_cancel(&heap, old));
+
+    int32_t id = alarm_heap_add(&heap, 100, 0, 1);
+
+    ASSERT_NE(id, old);
+    ASSERT_EQ((uint32_t)id % Capacity, (uint32_t)old % Capacity);
+    ASSERT_FALSE(alarm_heap_cancel(&heap, old));
+    ASSERT_TRUE(alarm_heap_cancel(&heap, id));
+}
+
+TEST_F(AlarmHeapTest, TestCaseIdsStayPositive) {
+    // The largest heap wraps the reuse count of a slot soonest
+    std::vector<struct alarm_t> many(ALARM_HEAP_MAX);
+    std::vector<uint16_t> many_order(ALARM_HEAP_MAX);
+    struct alarm_heap_t big;
+    int32_t first = -1;
+    bool wrapped = false;
+
+    alarm_heap_init(&big, many.data(), many_order.data(), ALARM_HEAP_MAX);
+
+    // A lone alarm always takes the same slot
+    for (uint32_t i = 0; i < 2 * big.gen_limit; i++) {
+        int32_t id = alarm_heap_add(&big, 0, 0, 0);
+
+        ASSERT_GE(id, 0);
+        ASSERT_TRUE(alarm_heap_cancel(&big, id));
+        wrapped |= i > 0 && id == first;
+        first = i == 0 ? id : first;
+    }
+    ASSERT_TRUE(wrapped);
+}
+
+TEST_F(AlarmHeapTest, TestCaseFull) {
+    for (uint32_t i = 0; i < Capacity; i++) {
+        ASSERT_GE(alarm_heap_add(&heap, i, 0, 0), 0);
+    }
+    ASSERT_EQ(alarm_heap_add(&heap, 0, 0, 0), ALARM_FULL);
+
+    // A slot is free again once an alarm goes off
+    struct alarm_t out;
+    ASSERT_GE(alarm_heap_pop_due(&heap, 0, &out), 0);
+    ASSERT_GE(alarm_heap_add(&heap, 0, 0, 0), 0);
+}
+
+TEST_F(AlarmHeapTest, TestCaseRandomAgainstMap) {
+    // Model keyed by deadline and order added, which is the order the alarms go off in
+    std::map<std::pair<int64_t, uint32_t>, int32_t> model;
+    std::map<int32_t, std::pair<int64_t, uint32_t>> ids;
+    std::mt19937 rng(1);
+    uint32_t added = 0;
+    int64_t now = 0;
+
+    for (int step = 0; step < 100000; step++) {
+        uint32_t op = rng() % 4;
+
+        if (op < 2 && model.size() < Capacity) {
+            int64_t deadline = now + rng() % 1000;
+            int32_t id = alarm_heap_add(&heap, deadline, 0, 0);
+
+            ASSERT_GE(id, 0);
+            model[{ deadline, added }] = id;
+            ids[id] = { deadline, added };
+            added++;
+        } else if (op == 2 && !ids.empty()) {
+            auto it = std::next(ids.begin(), rng() % ids.size());
+
+            ASSERT_TRUE(alarm_heap_cancel(&heap, it->first));
+            model.erase(it->second);
+            ids.erase(it);
+        } else {
+            struct alarm_t out;
+
+            now += rng() % 100;
+            for (int32_t id; (id = alarm_heap_pop_due(&heap, now, &out)) >= 0;) {
+                ASSERT_FALSE(model.empty());
+                ASSERT_EQ(id, model.begin()->second);
+                ASSERT_EQ(out.deadline, model.begin()->first.first);
+                ids.erase(id);
+                model.erase(model.begin());
+            }
+            ASSERT_TRUE(model.empty() || model.begin()->first.first > now);
+        }
+
+        int64_t next;
+        ASSERT_EQ(alarm_heap_next(&heap, &next), !model.empty());
+        if (!model.empty()) {
+            ASSERT_EQ(next, model.begin()->first.first);
+        }
+    }
+}
@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+#include "../../src/cmdbus.h"
+
+// Events of the test, only their coalescing flags matter to the bus
+enum { EV_PLAIN, EV_SAME, EV_FLIP, EV_COUNT };
+
+static const uint8_t flags[EV_COUNT] = { 0, CMD_IDEMPOTENT, CMD_TOGGLE };
+
+static struct command_t command(uint8_t event, uint8_t source, void *done = nullptr) {
+    struct command_t cmd = {};
+    cmd.event = event;
+    cmd.source = source;
+    cmd.done = done;
+    return cmd;
+}
+
+class CmdBusTest : public ::testing::Test {
+protected:
+    struct cmd_bus_t bus;
+
+    void SetUp() override {
+        cmd_bus_init(&bus, flags, EV_COUNT);
+    }
+};
+
+TEST_F(CmdBusTest, TestCaseFifoWithinSource) {
+    for (uint32_t i = 0; i < CMD_BUS_DEPTH; i++) {
+        struct command_t cmd = command(EV_PLAIN, CMD_SRC_UART);
+        cmd.stamp = i;
+        ASSERT_EQ(cmd_bus_push(&bus, &cmd), CMD_QUEUED);
+    }
+
+    struct command_t out;
+    for (uint32_t i = 0; i < CMD_BUS_DEPTH; i++) {
+        ASSERT_TRUE(cmd_bus_pop(&bus, &out));
+        ASSERT_EQ(out.stamp, i);
+    }
+    ASSERT_FALSE(cmd_bus_pop(&bus, &out));
+}
+
+TEST_F(CmdBusTest, TestCaseHigherPriorityFirst) {
+    struct command_t dispatcher = command(EV_PLAIN, CMD_SRC_DISPATCHER);
+    struct command_t uart = command(EV_PLAIN, CMD_SRC_UART);
+    struct command_t timer = command(EV_PLAIN, CMD_SRC_TIMER);
+    struct command_t button = command(EV_PLAIN, CMD_SRC_BUTTON);
+
+    cmd_bus_push(&bus, &dispatcher);
+    cmd_bus_push(&bus, &uart);
+    cmd_bus_push(&bus, &timer);
+    cmd_bus_push(&bus, &button);
+    ASSERT_EQ(cmd_bus_depth(&bus), 4u);
+
+    struct command_t out;
+    const uint8_t expected[] = { CMD_SRC_BUTTON, CMD_SRC_TIMER, CMD_SRC_UART, CMD_SRC_DISPATCHER };
+    for (uint8_t source : expected) {
+        ASSERT_TRUE(cmd_bus_pop(&bus, &out));
+        ASSERT_EQ(out.source, source);
+    }
+}
+
+TEST_F(CmdBusTest, TestCaseFullPriorityDoesNotBlockOthers) {
+    struct command_t uart = command(EV_PLAIN, CMD_SRC_UART);
+    struct command_t button = command(EV_PLAIN, CMD_SRC_BUTTON);
+
+    for (int i = 0; i < CMD_BUS_DEPTH; i++) {
+        ASSERT_EQ(cmd_bus_push(&bus, &uart), CMD_QUEUED);
+    }
+
+    ASSERT_EQ(cmd_bus_push(&bus, &uart), CMD_FULL);
+    ASSERT_EQ(cmd_bus_push(&bus, &button), CMD_QUEUED);
+    ASSERT_EQ(bus.dropped, 1u);
+    ASSERT_EQ(bus.peak_depth, (uint32_t)CMD_BUS_DEPTH + 1);
+}
+
+TEST_F(CmdBusTest, TestCaseIdempotentMerged) {
+    struct command_t same = command(EV_SAME, CMD_SRC_UART);
+    struct command_t plain = command(EV_PLAIN, CMD_SRC_UART);
+
+    ASSERT_EQ(cmd_bus_push(&bus, &same), CMD_QUEUED);
+    ASSERT_EQ(cmd_bus_push(&bus, &same), CMD_COALESCED);
+    ASSERT_EQ(cmd_bus_push(&bus, &plain), CMD_QUEUED);
+    ASSERT_EQ(cmd_bus_depth(&bus), 2u);
+    ASSERT_EQ(bus.coalesced, 1u);
+}
+
+TEST_F(CmdBusTest, TestCaseIdempotentKeptAcrossOthers) {
+    struct command_t same = command(EV_SAME, CMD_SRC_TIMER);
+    struct command_t plain = command(EV_PLAIN, CMD_SRC_TIMER);
+
+    // The second copy has to undo what the command in between did
+    ASSERT_EQ(cmd_bus_push(&bus, &same), CMD_QUEUED);
+    ASSERT_EQ(cmd_bus_push(&bus, &plain), CMD_QUEUED);
+    ASSERT_EQ(cmd_bus_push(&bus, &same), CMD_QUEUED);
+    ASSERT_EQ(cmd_bus_depth(&bus), 3u);
+    ASSERT_EQ(bus.coalesced, 0u);
+
+    struct command_t out;
+    for (uint8_t event : { EV_SAME, EV_PLAIN, EV_SAME }) {
+        ASSERT_TRUE(cmd_bus_pop(&bus, &out));
+        ASSERT_EQ(out.event, event);
+    }
+}
+
+TEST_F(CmdBusTest, TestCaseTogglePairCancels) {
+    struct command_t flip = command(EV_FLIP, CMD_SRC_BUTTON);
+    struct command_t plain = command(EV_PLAIN, CMD_SRC_BUTTON);
+
+    ASSERT_EQ(cmd_bus_push(&bus, &flip), CMD_QUEUED);
+    ASSERT_EQ(cmd_bus_push(&bus, &flip), CMD_COALESCED);
+    ASSERT_EQ(cmd_bus_depth(&bus), 0u);
+
+    // Something in between keeps both toggles
+    ASSERT_EQ(cmd_bus_push(&bus, &flip), CMD_QUEUED);
+    ASSERT_EQ(cmd_bus_push(&bus, &plain), CMD_QUEUED);
+    ASSERT_EQ(cmd_bus_push(&bus, &flip), CMD_QUEUED);
+    ASSERT_EQ(cmd_bus_depth(&bus), 3u);
+}
+
+TEST_F(CmdBusTest, TestCaseWaitedCommandsNotCoalesced) {
+    int waiter;
+    struct command_t same = command(EV_SAME, CMD_SRC_SYSTEM);
+    struct command_t waited = command(EV_SAME, CMD_SRC_SYSTEM, &waiter);
+
+    ASSERT_EQ(cmd_bus_push(&bus, &same), CMD_QUEUED);
+    ASSERT_EQ(cmd_bus_push(&bus, &waited), CMD_QUEUED);
+
+    struct command_t flip = command(EV_FLIP, CMD_SRC_SYSTEM, &waiter);
+    ASSERT_EQ(cmd_bus_push(&bus, &flip), CMD_QUEUED);
+    ASSERT_EQ(cmd_bus_push(&bus, &flip), CMD_QUEUED);
+    ASSERT_EQ(cmd_bus_depth(&bus), 4u);
+}
+
+TEST_F(CmdBusTest, TestCaseWrapsAround) {
+    struct command_t out;
+
+    for (uint32_t i = 0; i < 5 * CMD_BUS_DEPTH; i++) {
+        struct command_t cmd = command(EV_PLAIN, CMD_SRC_TIMER);
+        cmd.stamp = i;
+        ASSERT_EQ(cmd_bus_push(&bus, &cmd), CMD_QUEUED);
+        ASSERT_TRUE(cmd_bus_pop(&bus, &out));
+        ASSERT_EQ(out.stamp, i);
+    }
+}
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include <string>
+#include "../shim/shim.h"
+
+extern "C" {
+#include "../../src/ledctl.h"
+#include "../../src/debug.h"
+
+void debug_task(void *, void *, void *);
+extern struct k_timer debug_latency_timer;
+}
+
+// The debug queue of debug.c on the shim, with the debug task run by the test whenever it would be woken up
+
+class DebugTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        ASSERT_EQ(shim_boot(), 0);
+        // Nothing else on the clock, so that the debug task gives up as soon as it has printed
+        ASSERT_EQ(ledctl_post(LED_EV_PAUSE, CMD_SRC_SYSTEM, NULL), 0);
+        shim_run();
+    }
+
+    void SetUp() override {
+        print_debug_messages = true;
+        shim_thread_run(debug_task);
+        shim_output_clear();
+    }
+
+    void TearDown() override {
+        print_debug_messages = false;
+    }
+
+    std::string output() {
+        return std::string(shim_output(), shim_output_len());
+    }
+
+    // Let the longest allowed latency pass and give the debug task the time it would get
+    void wait_latency() {
+        shim_advance_ms(CONFIG_TRAFFIC_LIGHTS_DEBUG_MAX_LATENCY_MS);
+        shim_thread_run(debug_task);
+    }
+};
+
+static void post_from_interrupt(void) {
+    debug("interrupt");
+}
+
+TEST_F(DebugTest, TestCaseLoneMessagesWithinLatency) {
+    for (int i = 0; i < 10; i++) {
+        debug("lone %d", i);
+
+        wait_latency();
+        ASSERT_NE(output().find("lone " + std::to_string(i) + "\n"), std::string::npos) << output();
+        shim_output_clear();
+    }
+}
+
+TEST_F(DebugTest, TestCaseMessageWhileTimerIsStopped) {
+    for (int i = 0; i < 10; i++) {
+        debug("lone %d", i);
+
+        // A message scheduled while the debug task stops the timer is printed in the same batch
+        shim_before_timer_stop(&debug_latency_timer, post_from_interrupt);
+        wait_latency();
+        ASSERT_NE(output().find("lone " + std::to_string(i) + "\n"), std::string::npos) << output();
+        ASSERT_NE(output().find("interrupt\n"), std::string::npos) << output();
+        shim_output_clear();
+    }
+}
+
+TEST_F(DebugTest, TestCaseQueueCountersInStatistics) {
+    uint32_t dropped = atomic_get(&debug_dropped);
+
+    // Overfill the ring before the debug task gets to run
+    for (int i = 0; i < CONFIG_TRAFFIC_LIGHTS_DEBUG_RING_SIZE + 3; i++) {
+        debug("full %d", i);
+    }
+    shim_thread_run(debug_task);
+    ASSERT_NE(output().find("full 31\n"), std::string::npos);
+    ASSERT_EQ(output().find("full 32\n"), std::string::npos);
+    shim_output_clear();
+
+    stats_print_csv();
+    std::string line = "debug_queue," + std::to_string(dropped + 3) + "," +
+        std::to_string(CONFIG_TRAFFIC_LIGHTS_DEBUG_RING_SIZE) + "," +
+        std::to_string(atomic_get(&debug_mean_latency_us)) + "\n";
+    ASSERT_NE(output().find(line), std::string::npos) << output();
+}
@@ -0,0 +1,427 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "../shim/shim.h"
+#include "../shim/fakes.h"
+#include "../../src/robolink.h"
+#include "../../src/timeparser.h"
+
+extern "C" {
+#include "../../src/ledctl.h"
+#include "../../src/dispatcher.h"
+#include "../../src/alarm.h"
+#include "../../src/debug.h"
+
+extern volatile bool robomode;
+extern struct k_mem_slab dispatcher_slab;
+}
+
+// The UART and dispatcher tasks of dispatcher.c run on the shim, fed by the fake UART and driving the real led engine
+
+class DispatcherTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        ASSERT_EQ(shim_boot(), 0);
+    }
+
+    void SetUp() override {
+        robomode = false;
+        print_debug_messages = false;
+        ledctl_set_hold_ms(LED_HOLD_TIME_MS);
+        // Out of blinking that an earlier test may have left on
+        ASSERT_EQ(ledctl_post(LED_EV_PAUSE, CMD_SRC_SYSTEM, NULL), 0);
+        shim_run();
+        shim_output_clear();
+    }
+
+    void TearDown() override {
+        // Run what is left in the dispatcher queue, so that the next test starts with free slots
+        shim_thread_run(dispatcher_task);
+        ASSERT_EQ(k_mem_slab_num_used_get(&dispatcher_slab), 0u);
+    }
+
+    // Type text on the UART and let the UART task handle all of it
+    void type(const std::string &text) {
+        fake_uart_input(text.data(), text.size());
+        shim_thread_run(uart_task);
+        shim_run();
+    }
+
+    std::string output() {
+        return std::string(shim_output(), shim_output_len());
+    }
+
+    void send(uint8_t id, uint8_t command, const std::string &payload) {
+        struct rl_frame_t frame = {};
+        uint8_t encoded[RL_ENCODED_MAX];
+
+        frame.id = id;
+        frame.command = command;
+        frame.len = (uint8_t)payload.size();
+        memcpy(frame.payload, payload.data(), payload.size());
+        type(std::string((const char *)encoded, rl_encode(&frame, encoded)));
+    }
+
+    // Frames sent back since the output was last cleared
+    std::vector<struct rl_frame_t> responses() {
+        struct rl_decoder_t dec;
+        struct rl_frame_t frame;
+        std::vector<struct rl_frame_t> frames;
+
+        rl_decoder_init(&dec);
+        for (size_t i = 0; i < shim_output_len(); i++) {
+            if (rl_decode_feed(&dec, (uint8_t)shim_output()[i], &frame) == RL_FRAME) {
+                frames.push_back(frame);
+            }
+        }
+        return frames;
+    }
+
+    // Id of the alarm the last time line set up
+    int alarm_id() {
+        std::string out = output();
+        size_t at = out.rfind("Alarm ");
+
+        return at == std::string::npos ? -1 : atoi(out.c_str() + at + 6);
+    }
+
+    static int32_t result(const struct rl_frame_t &frame) {
+        return (int32_t)(frame.payload[1] | frame.payload[2] << 8 | frame.payload[3] << 16 | (uint32_t)frame.payload[4] << 24);
+    }
+};
+
+TEST_F(DispatcherTest, TestCaseHoldTimeLine) {
+    type("A250\n");
+    ASSERT_NE(output().find("Hold time set to 250 ms"), std::string::npos);
+    ASSERT_EQ(ledctl_hold_ms(), 250u);
+
+    for (const char *line : { "A0\n", "A65536\n", "A12x\n", "A\n" }) {
+        shim_output_clear();
+        type(line);
+        ASSERT_NE(output().find("Invalid hold time"), std::string::npos) << line;
+        ASSERT_EQ(ledctl_hold_ms(), 250u);
+    }
+}
+
+TEST_F(DispatcherTest, TestCaseTimeLineStartsTimer) {
+    type("000005\n");
+    ASSERT_NE(output().find("Setting up timer with 5 seconds"), std::string::npos);
+
+    shim_advance_ms(4999);
+    ASSERT_NE(LED_WORD_GET_MODE(atomic_get(&led_word)), Blink);
+    shim_advance_ms(1);
+    ASSERT_EQ(LED_WORD_GET_MODE(atomic_get(&led_word)), Blink);
+}
+
+TEST_F(DispatcherTest, TestCaseDelayLine) {
+    type("1m30s\n");
+    ASSERT_NE(output().find("Setting up timer with 90 seconds"), std::string::npos);
+
+    shim_advance_ms(89999);
+    ASSERT_NE(LED_WORD_GET_MODE(atomic_get(&led_word)), Blink);
+    shim_advance_ms(1);
+    ASSERT_EQ(LED_WORD_GET_MODE(atomic_get(&led_word)), Blink);
+}
+
+TEST_F(DispatcherTest, TestCaseTimeOfDayLine) {
+    // Ten seconds from now on the clock of the device, which starts at boot
+    int seconds = (int)(k_uptime_get() / 1000 + 10) % 86400;
+    int64_t delay = (seconds * 1000LL - k_uptime_get() % 86400000 + 86400000) % 86400000;
+    char line[32];
+
+    snprintf(line, sizeof(line), "@%02d:%02d:%02d\n", seconds / 3600, seconds / 60 % 60, seconds % 60);
+    type(line);
+    ASSERT_NE(output().find("Setting up timer at " + std::string(line + 1, 8)), std::string::npos) << output();
+
+    shim_advance_ms(delay - 1);
+    ASSERT_NE(LED_WORD_GET_MODE(atomic_get(&led_word)), Blink);
+    shim_advance_ms(1);
+    ASSERT_EQ(LED_WORD_GET_MODE(atomic_get(&led_word)), Blink);
+    ASSERT_EQ(k_uptime_get() / 1000 % 86400, seconds);
+}
+
+TEST_F(DispatcherTest, TestCaseAlarmResumesAuto) {
+    type("000002,a\n");
+    ASSERT_NE(alarm_id(), -1);
+
+    shim_advance_ms(1999);
+    ASSERT_EQ(LED_WORD_GET_MODE(atomic_get(&led_word)), Manual);
+    shim_advance_ms(1);
+    ASSERT_EQ(LED_WORD_GET_MODE(atomic_get(&led_word)), Auto);
+}
+
+TEST_F(DispatcherTest, TestCaseAlarmsDueTogetherRunInOrder) {
+    // All three go off in the same expiry, the last one decides
+    type("000001,b\n");
+    type("000001,a\n");
+    type("000001,b\n");
+    shim_advance_ms(1000);
+    ASSERT_EQ(LED_WORD_GET_MODE(atomic_get(&led_word)), Blink);
+
+    type("000001,a\n");
+    type("000001,b\n");
+    type("000001,a\n");
+    shim_advance_ms(1000);
+    ASSERT_EQ(LED_WORD_GET_MODE(atomic_get(&led_word)), Auto);
+}
+
+TEST_F(DispatcherTest, TestCaseAlarmRunsStoredSequence) {
+    type("#1R100G200\n");
+    ASSERT_NE(output().find("Sequence 1 stored"), std::string::npos);
+    // Stored, not run
+    ASSERT_EQ(k_mem_slab_num_used_get(&dispatcher_slab), 0u);
+
+    type("000001,1\n");
+    shim_advance_ms(999);
+    ASSERT_EQ(k_mem_slab_num_used_get(&dispatcher_slab), 0u);
+    shim_advance_ms(1);
+    ASSERT_EQ(k_mem_slab_num_used_get(&dispatcher_slab), 1u);
+
+    const struct fake_led_change_t *changes;
+
+    fake_led_clear();
+    shim_thread_run(dispatcher_task);
+    ASSERT_EQ(fake_led_changes(&changes), 2u);
+    ASSERT_EQ(changes[0].color, Red);
+    ASSERT_EQ(changes[1].color, Green);
+}
+
+TEST_F(DispatcherTest, TestCaseCancelAlarm) {
+    type("000002\n");
+    int id = alarm_id();
+    ASSERT_GE(id, 0);
+
+    shim_output_clear();
+    type("C" + std::to_string(id) + "\n");
+    ASSERT_NE(output().find("Alarm " + std::to_string(id) + " cancelled"), std::string::npos);
+
+    shim_advance_ms(2000);
+    ASSERT_EQ(LED_WORD_GET_MODE(atomic_get(&led_word)), Manual);
+
+    for (std::string line : { "C" + std::to_string(id) + "\n", std::string("C\n"), std::string("C1x\n"),
+             std::string("C99999999999\n") }) {
+        shim_output_clear();
+        type(line);
+        ASSERT_NE(output().find("No such alarm"), std::string::npos) << line;
+    }
+}
+
+TEST_F(DispatcherTest, TestCaseInvalidAlarmLines) {
+    type("000001,x\n");
+    ASSERT_NE(output().find("Invalid alarm action"), std::string::npos);
+
+    shim_output_clear();
+    type("000001,b1\n");
+    ASSERT_NE(output().find("Invalid alarm action"), std::string::npos);
+
+    // There is no stored sequence of that number
+    shim_output_clear();
+    type("000001,9\n");
+    ASSERT_NE(output().find("Failed to set up the alarm: " + std::to_string(-EINVAL)), std::string::npos);
+
+    for (const char *line : { "#9RG\n", "#RG\n" }) {
+        shim_output_clear();
+        type(line);
+        ASSERT_NE(output().find("Invalid sequence number"), std::string::npos) << line;
+    }
+    ASSERT_EQ(k_mem_slab_num_used_get(&dispatcher_slab), 0u);
+}
+
+TEST_F(DispatcherTest, TestCaseManyAlarmsGoOffOnTime) {
+    struct alarm_stats_t before, after;
+
+    alarm_stats_get(&before);
+    ASSERT_EQ(before.pending, 0u);
+
+    // Added out of order, each at its own second
+    for (int i = 0; i < CONFIG_TRAFFIC_LIGHTS_ALARMS; i++) {
+        char line[16];
+
+        snprintf(line, sizeof(line), "%ds,a\n", (i * 7) % CONFIG_TRAFFIC_LIGHTS_ALARMS + 1);
+        type(line);
+    }
+    ASSERT_EQ(output().find("Failed"), std::string::npos);
+
+    shim_output_clear();
+    type("1s\n");
+    ASSERT_NE(output().find("Failed to set up the alarm: " + std::to_string(-ENOMEM)), std::string::npos);
+
+    alarm_stats_get(&after);
+    ASSERT_EQ(after.pending, (uint32_t)CONFIG_TRAFFIC_LIGHTS_ALARMS);
+
+    for (int i = 1; i <= CONFIG_TRAFFIC_LIGHTS_ALARMS; i++) {
+        shim_advance_ms(1000);
+        alarm_stats_get(&after);
+        ASSERT_EQ(after.dispatched - before.dispatched, (uint32_t)i);
+    }
+
+    ASSERT_EQ(after.pending, 0u);
+    ASSERT_EQ(after.late, before.late);
+}
+
+TEST_F(DispatcherTest, TestCaseInvalidTime) {
+    type("0000xx\n");
+
+    char expected[64];
+    snprintf(expected, sizeof(expected), "Got error %08x", ERR_TIME(FLAG_TIME_SYNTAX | FLAG_TIME_VALUE_SECOND));
+    ASSERT_NE(output().find(expected), std::string::npos);
+}
+
+TEST_F(DispatcherTest, TestCaseOverlongTime) {
+    // Far more than any time, it used to run over the line buffer on the stack
+    type(std::string(500, '1') + "\n");
+
+    char expected[64];
+    snprintf(expected, sizeof(expected), "Got error %08x", ERR_TIME(FLAG_TIME_LEN));
+    ASSERT_NE(output().find(expected), std::string::npos);
+
+    // The next line is parsed on its own
+    shim_output_clear();
+    type("000001\n");
+    ASSERT_NE(output().find("Setting up timer with 1 seconds"), std::string::npos);
+    shim_advance_ms(1000);
+}
+
+TEST_F(DispatcherTest, TestCaseSequenceLine) {
+    const struct fake_led_change_t *changes;
+
+    type("R100G200\n");
+    ASSERT_EQ(k_mem_slab_num_used_get(&dispatcher_slab), 1u);
+
+    // The dispatcher runs the sequence to its end on the engine and then waits for the next one
+    fake_led_clear();
+    int64_t start = k_uptime_get();
+    shim_thread_run(dispatcher_task);
+
+    ASSERT_EQ(k_uptime_get() - start, 300);
+    ASSERT_EQ(fake_led_changes(&changes), 2u);
+    ASSERT_EQ(changes[0].color, Red);
+    ASSERT_EQ(changes[1].color, Green);
+    ASSERT_EQ(changes[1].ms - changes[0].ms, 100);
+    ASSERT_EQ(k_mem_slab_num_used_get(&dispatcher_slab), 0u);
+}
+
+TEST_F(DispatcherTest, TestCaseFullQueuePushesBack) {
+    for (int i = 0; i < CONFIG_TRAFFIC_LIGHTS_DISPATCHER_SLOTS; i++) {
+        type("RG\n");
+    }
+    ASSERT_EQ(output().find("Busy"), std::string::npos);
+
+    type("RG\n");
+    ASSERT_NE(output().find("Busy, sequence dropped"), std::string::npos);
+}
+
+TEST_F(DispatcherTest, TestCaseRoboPing) {
+    type(std::string(1, '\0'));
+    ASSERT_TRUE(robomode);
+
+    send(1, RL_CMD_PING, "sync");
+    auto frames = responses();
+
+    ASSERT_EQ(frames.size(), 1u);
+    ASSERT_EQ(frames[0].id, 1);
+    ASSERT_EQ(frames[0].command, RL_CMD_PING | RL_RESPONSE);
+    ASSERT_EQ(frames[0].payload[0], RL_STATUS_OK);
+    ASSERT_EQ(std::string((const char *)&frames[0].payload[RL_RESULT_SIZE], frames[0].len - RL_RESULT_SIZE), "sync");
+}
+
+TEST_F(DispatcherTest, TestCaseRoboTimes) {
+    type(std::string(1, '\0'));
+    send(1, RL_CMD_TIME, "001000");
+    send(2, RL_CMD_TIME, "0010xx");
+    send(3, RL_CMD_TIME, "0010000");
+    send(4, RL_CMD_TIME, "@00:10");
+    auto frames = responses();
+
+    ASSERT_EQ(frames.size(), 4u);
+    ASSERT_EQ(frames[0].payload[0], RL_STATUS_OK);
+    ASSERT_EQ(result(frames[0]), 600);
+    ASSERT_EQ(frames[1].payload[0], RL_STATUS_ERROR);
+    ASSERT_EQ(result(frames[1]), ERR_TIME(FLAG_TIME_SYNTAX | FLAG_TIME_VALUE_SECOND));
+    ASSERT_EQ(result(frames[2]), ERR_TIME(FLAG_TIME_LEN));
+    // A time of day has the same seconds as the delay, and says so in the data
+    ASSERT_EQ(frames[3].payload[0], RL_STATUS_OK);
+    ASSERT_EQ(result(frames[3]), 600);
+    ASSERT_EQ(frames[0].len, RL_RESULT_SIZE + 4);
+    ASSERT_EQ(frames[0].payload[RL_RESULT_SIZE], 0);
+    ASSERT_EQ(frames[3].len, RL_RESULT_SIZE + 4);
+    ASSERT_EQ(frames[3].payload[RL_RESULT_SIZE], 1);
+}
+
+TEST_F(DispatcherTest, TestCaseRoboSequence) {
+    type(std::string(1, '\0'));
+    send(1, RL_CMD_SEQUENCE, "RX");
+    send(2, RL_CMD_SEQUENCE, "RG");
+    auto frames = responses();
+
+    ASSERT_EQ(frames.size(), 2u);
+    ASSERT_EQ(frames[0].payload[0], RL_STATUS_ERROR);
+    ASSERT_EQ(frames[1].payload[0], RL_STATUS_OK);
+    ASSERT_EQ(k_mem_slab_num_used_get(&dispatcher_slab), 1u);
+}
+
+TEST_F(DispatcherTest, TestCaseRoboSequenceWithLineBreak) {
+    type(std::string(1, '\0'));
+    send(1, RL_CMD_SEQUENCE, "RG\n");
+    send(2, RL_CMD_SEQUENCE, "YG\r\n");
+    // Only the last line break is the client's, one inside the sequence still ends it early
+    send(3, RL_CMD_SEQUENCE, "R\nG\n");
+    auto frames = responses();
+
+    ASSERT_EQ(frames.size(), 3u);
+    ASSERT_EQ(frames[0].payload[0], RL_STATUS_OK);
+    ASSERT_EQ(frames[1].payload[0], RL_STATUS_OK);
+    ASSERT_EQ(frames[2].payload[0], RL_STATUS_ERROR);
+    ASSERT_EQ(k_mem_slab_num_used_get(&dispatcher_slab), 2u);
+}
+
+TEST_F(DispatcherTest, TestCaseRoboBadFrameIsCounted) {
+    struct rl_frame_t frame = {};
+    uint8_t encoded[RL_ENCODED_MAX];
+
+    type(std::string(1, '\0'));
+    send(1, RL_CMD_STATS, "");
+    uint32_t bad = responses().at(0).payload[RL_RESULT_SIZE + 4 * RL_STAT_BAD_FRAMES];
+
+    // A broken frame gets no answer
+    frame.command = RL_CMD_PING;
+    size_t len = rl_encode(&frame, encoded);
+    encoded[2] ^= 0x10;
+    shim_output_clear();
+    type(std::string((const char *)encoded, len));
+    ASSERT_TRUE(responses().empty());
+
+    send(2, RL_CMD_STATS, "");
+    auto frames = responses();
+    ASSERT_EQ(frames.size(), 1u);
+    ASSERT_EQ(frames[0].len, RL_RESULT_SIZE + 4 * RL_STAT_COUNT);
+    ASSERT_EQ(frames[0].payload[RL_RESULT_SIZE + 4 * RL_STAT_BAD_FRAMES], bad + 1);
+}
+
+TEST_F(DispatcherTest, TestCaseRoboUnknownCommand) {
+    type(std::string(1, '\0'));
+    send(1, 0x42, "");
+    auto frames = responses();
+
+    ASSERT_EQ(frames.size(), 1u);
+    ASSERT_EQ(frames[0].payload[0], RL_STATUS_UNKNOWN);
+}
+
+TEST_F(DispatcherTest, TestCaseRoboDebugIsRestoredOnClose) {
+    print_debug_messages = true;
+    type(std::string(1, '\0'));
+    ASSERT_FALSE(print_debug_messages);
+
+    send(1, RL_CMD_DEBUG, "");
+    ASSERT_EQ(result(responses().at(0)), 0);
+    ASSERT_FALSE(print_debug_messages);
+
+    send(2, RL_CMD_CLOSE, "");
+    ASSERT_FALSE(robomode);
+    ASSERT_FALSE(print_debug_messages);
+
+    // Back on the text command line
+    shim_output_clear();
+    type("A300\n");
+    ASSERT_NE(output().find("Hold time set to 300 ms"), std::string::npos);
+}
@@ -0,0 +1,301 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "../shim/shim.h"
+#include "../shim/fakes.h"
+
+extern "C" {
+#include "../../src/ledctl.h"
+#include "../../src/seqparser.h"
+#include "../../src/latency.h"
+#include "../../src/mux.h"
+}
+
+// The real led engine runs on the simulated clock of the shim, with the fake led backend showing its colors
+
+struct shown_t {
+    int64_t ms;
+    enum Color color;
+
+    bool operator==(const shown_t &other) const {
+        return ms == other.ms && color == other.color;
+    }
+};
+
+static std::ostream &operator<<(std::ostream &os, const shown_t &shown) {
+    return os << "{" << shown.ms << ", " << shown.color << "}";
+}
+
+// Colors the only head has shown since the led log was cleared, with times relative to `start`
+static std::vector<shown_t> shown(int64_t start) {
+    const struct fake_led_change_t *changes;
+    size_t count = fake_led_changes(&changes);
+    std::vector<shown_t> out;
+
+    for (size_t i = 0; i < count; i++) {
+        out.push_back({ changes[i].ms - start, changes[i].color });
+    }
+    return out;
+}
+
+static void compile(const char *text, struct led_control_t *ctl) {
+    struct seq_parser_t parser;
+    int ret = SEQ_MORE;
+
+    seq_parser_init(&parser);
+    for (const char *c = text; *c != '\0'; c++) {
+        ret = seq_parser_feed(&parser, *c, ctl);
+    }
+    ASSERT_EQ(ret, SEQ_READY);
+}
+
+class LedCtlTest : public ::testing::Test {
+protected:
+    static bool booted_ready;
+    static enum Color booted_color;
+    int64_t start;
+
+    static void SetUpTestSuite() {
+        ASSERT_EQ(shim_boot(), 0);
+        booted_ready = k_sem_count_get(&threads_ready) == 1;
+        shim_run();
+        booted_color = fake_led_color(0);
+    }
+
+    // Every test starts at the beginning of red of the automatic sequence, wherever the previous one left the engine
+    void SetUp() override {
+        fake_led_hardware_blink(false);
+        ledctl_set_hold_ms(LED_HOLD_TIME_MS);
+        post(LED_EV_BLINK);
+        post(LED_EV_PAUSE);
+        post(LED_EV_MANUAL);
+
+        for (int i = 0; i < 3 && ledctl_color() != Red; i++) {
+            ASSERT_TRUE(shim_advance_next());
+        }
+        ASSERT_EQ(ledctl_color(), Red);
+        ASSERT_FALSE(ledctl_paused());
+
+        fake_led_clear();
+        start = k_uptime_get();
+    }
+
+    void post(enum led_event event, enum cmd_source source = CMD_SRC_BUTTON) {
+        ASSERT_EQ(ledctl_post(event, source, NULL), 0);
+        shim_run();
+    }
+};
+
+bool LedCtlTest::booted_ready;
+enum Color LedCtlTest::booted_color;
+
+TEST_F(LedCtlTest, TestCaseStartsItselfAtBoot) {
+    ASSERT_TRUE(booted_ready);
+    ASSERT_EQ(booted_color, Red);
+}
+
+TEST_F(LedCtlTest, TestCaseAutomaticSequence) {
+    shim_advance_ms(3000);
+
+    ASSERT_EQ(shown(start), (std::vector<shown_t>{ { 1000, Yellow }, { 2000, Green }, { 3000, Red } }));
+    ASSERT_EQ(LED_WORD_GET_MODE(atomic_get(&led_word)), Auto);
+}
+
+TEST_F(LedCtlTest, TestCaseAutomaticSequenceDoesNotDrift) {
+    shim_advance_ms(300 * 1000);
+
+    auto colors = shown(start);
+    ASSERT_EQ(colors.size(), 300u);
+    ASSERT_EQ(colors.back(), (shown_t{ 300 * 1000, Red }));
+}
+
+TEST_F(LedCtlTest, TestCaseHoldTimeAppliesFromNextTransition) {
+    ledctl_set_hold_ms(250);
+    shim_advance_ms(1500);
+
+    ASSERT_EQ(shown(start), (std::vector<shown_t>{ { 1000, Yellow }, { 1250, Green }, { 1500, Red } }));
+}
+
+TEST_F(LedCtlTest, TestCasePauseToggleAndResume) {
+    shim_advance_ms(1000);
+    post(LED_EV_MANUAL);
+    ASSERT_TRUE(ledctl_paused());
+    ASSERT_EQ(ledctl_color(), Yellow);
+
+    // Paused lights hold for good
+    shim_advance_ms(10000);
+    ASSERT_EQ(ledctl_color(), Yellow);
+
+    // Toggling the color that is on turns the lights off
+    post(LED_EV_RED);
+    ASSERT_EQ(ledctl_color(), Red);
+    post(LED_EV_RED);
+    ASSERT_EQ(ledctl_color(), Off);
+
+    // Resuming continues from the color that was on when pausing
+    post(LED_EV_MANUAL);
+    ASSERT_FALSE(ledctl_paused());
+    ASSERT_EQ(ledctl_color(), Yellow);
+    shim_advance_ms(1000);
+    ASSERT_EQ(ledctl_color(), Green);
+}
+
+TEST_F(LedCtlTest, TestCaseTogglesAreIgnoredInAutomaticMode) {
+    post(LED_EV_GREEN);
+    post(LED_EV_OFF);
+
+    ASSERT_EQ(ledctl_color(), Red);
+    ASSERT_TRUE(shown(start).empty());
+}
+
+TEST_F(LedCtlTest, TestCaseSoftwareBlink) {
+    post(LED_EV_BLINK);
+    shim_advance_ms(2000);
+
+    ASSERT_EQ(shown(start), (std::vector<shown_t>{ { 0, Yellow }, { 1000, Off }, { 2000, Yellow } }));
+    ASSERT_EQ(LED_WORD_GET_MODE(atomic_get(&led_word)), Blink);
+
+    // Stopping with yellow on leaves it on under manual control
+    post(LED_EV_BLINK_TOGGLE);
+    ASSERT_EQ(LED_WORD_GET_MODE(atomic_get(&led_word)), Manual);
+    ASSERT_EQ(ledctl_color(), Yellow);
+}
+
+TEST_F(LedCtlTest, TestCaseHardwareBlink) {
+    const struct fake_led_change_t *changes;
+
+    fake_led_hardware_blink(true);
+    post(LED_EV_BLINK);
+    shim_advance_ms(5000);
+
+    // The backend blinks on its own, the engine has no timer running
+    ASSERT_EQ(fake_led_changes(&changes), 1u);
+    ASSERT_TRUE(changes[0].blinking);
+    ASSERT_EQ(LED_WORD_GET_MODE(atomic_get(&led_word)), Blink);
+    ASSERT_FALSE(shim_advance_next());
+}
+
+TEST_F(LedCtlTest, TestCaseSequence) {
+    struct led_control_t ctl;
+    struct k_sem done;
+
+    compile("R100G200\n", &ctl);
+    k_sem_init(&done, 0, 1);
+    ASSERT_EQ(ledctl_run_sequence(&ctl, &done, timing_counter_get()), 0);
+
+    shim_advance_ms(299);
+    ASSERT_EQ(k_sem_count_get(&done), 0u);
+    shim_advance_ms(1);
+    ASSERT_EQ(k_sem_count_get(&done), 1u);
+
+    ASSERT_EQ(shown(start), (std::vector<shown_t>{ { 0, Red }, { 100, Green } }));
+    ASSERT_TRUE(ledctl_paused());
+}
+
+TEST_F(LedCtlTest, TestCaseSequenceWaitsForButton) {
+    struct led_control_t ctl;
+    struct k_sem done;
+
+    compile("R200WG300\n", &ctl);
+    k_sem_init(&done, 0, 1);
+    ASSERT_EQ(ledctl_run_sequence(&ctl, &done, timing_counter_get()), 0);
+
+    shim_advance_ms(10000);
+    ASSERT_EQ(ledctl_color(), Red);
+    ASSERT_EQ(k_sem_count_get(&done), 0u);
+
+    // The hold times after the wait count from the press
+    post(LED_EV_MANUAL);
+    ASSERT_EQ(ledctl_color(), Green);
+    shim_advance_ms(300);
+    ASSERT_EQ(k_sem_count_get(&done), 1u);
+}
+
+TEST_F(LedCtlTest, TestCaseEventStopsSequence) {
+    struct led_control_t ctl;
+    struct k_sem done;
+
+    compile("(RG)*\n", &ctl);
+    k_sem_init(&done, 0, 1);
+    ASSERT_EQ(ledctl_run_sequence(&ctl, &done, timing_counter_get()), 0);
+    shim_advance_ms(5500);
+    ASSERT_EQ(k_sem_count_get(&done), 0u);
+
+    post(LED_EV_PAUSE, CMD_SRC_UART);
+    ASSERT_EQ(k_sem_count_get(&done), 1u);
+
+    size_t count = shown(start).size();
+    shim_advance_ms(5000);
+    ASSERT_EQ(shown(start).size(), count);
+}
+
+TEST_F(LedCtlTest, TestCaseDoublePressStopsSequence) {
+    struct led_control_t ctl;
+    struct k_sem done;
+
+    compile("(RG)*\n", &ctl);
+    k_sem_init(&done, 0, 1);
+    ASSERT_EQ(ledctl_run_sequence(&ctl, &done, timing_counter_get()), 0);
+    shim_advance_ms(5500);
+
+    // Two presses before the engine gets to them. The first stops the sequence and resumes, the second pauses.
+    ASSERT_EQ(ledctl_post(LED_EV_MANUAL, CMD_SRC_BUTTON, NULL), 0);
+    ASSERT_EQ(ledctl_post(LED_EV_MANUAL, CMD_SRC_BUTTON, NULL), 0);
+    shim_run();
+    ASSERT_EQ(k_sem_count_get(&done), 1u);
+    ASSERT_TRUE(ledctl_paused());
+
+    size_t count = shown(start).size();
+    shim_advance_ms(5000);
+    ASSERT_EQ(shown(start).size(), count);
+}
+
+TEST_F(LedCtlTest, TestCaseDoublePressAtWait) {
+    struct led_control_t ctl;
+    struct k_sem done;
+
+    compile("R200WG300\n", &ctl);
+    k_sem_init(&done, 0, 1);
+    ASSERT_EQ(ledctl_run_sequence(&ctl, &done, timing_counter_get()), 0);
+    shim_advance_ms(1000);
+
+    // The first press continues the sequence, the second one stops it and resumes
+    ASSERT_EQ(ledctl_post(LED_EV_MANUAL, CMD_SRC_BUTTON, NULL), 0);
+    ASSERT_EQ(ledctl_post(LED_EV_MANUAL, CMD_SRC_BUTTON, NULL), 0);
+    shim_run();
+    ASSERT_EQ(k_sem_count_get(&done), 1u);
+    ASSERT_FALSE(ledctl_paused());
+
+    // Without a sequence the same two presses change nothing
+    ASSERT_EQ(ledctl_post(LED_EV_MANUAL, CMD_SRC_BUTTON, NULL), 0);
+    ASSERT_EQ(ledctl_post(LED_EV_MANUAL, CMD_SRC_BUTTON, NULL), 0);
+    shim_run();
+    ASSERT_FALSE(ledctl_paused());
+}
+
+TEST_F(LedCtlTest, TestCaseDoneIsGivenAfterEvent) {
+    struct k_sem done;
+
+    k_sem_init(&done, 0, 1);
+    ASSERT_EQ(ledctl_post(LED_EV_PAUSE, CMD_SRC_SYSTEM, &done), 0);
+    ASSERT_EQ(k_sem_count_get(&done), 0u);
+    shim_run();
+    ASSERT_EQ(k_sem_count_get(&done), 1u);
+    ASSERT_TRUE(ledctl_paused());
+}
+
+TEST_F(LedCtlTest, TestCaseLatencyIsRecorded) {
+    latency_reset();
+
+    // An event that changes nothing has no latency
+    ASSERT_EQ(ledctl_post_from(LED_EV_GREEN, CMD_SRC_BUTTON, LAT_SRC_GREEN, timing_counter_get()), 0);
+    shim_run();
+    ASSERT_EQ(latency_hist(LAT_SRC_GREEN)->count, 0u);
+
+    // A press that arrived 5 ms before the engine got to it
+    ASSERT_EQ(ledctl_post_from(LED_EV_PAUSE, CMD_SRC_BUTTON, LAT_SRC_MANUAL, timing_counter_get() - 5000), 0);
+    shim_run();
+
+    ASSERT_EQ(latency_hist(LAT_SRC_MANUAL)->count, 1u);
+    ASSERT_GE(latency_percentile(LAT_SRC_MANUAL, 50), 5000u);
+    ASSERT_LT(latency_percentile(LAT_SRC_MANUAL, 50), 10000u);
+}
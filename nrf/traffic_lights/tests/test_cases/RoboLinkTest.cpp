@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "../../src/robolink.h"
+
+static struct rl_frame_t frame(uint8_t id, uint8_t command, std::vector<uint8_t> payload) {
+    struct rl_frame_t f = {};
+    f.id = id;
+    f.command = command;
+    f.len = (uint8_t)payload.size();
+    std::copy(payload.begin(), payload.end(), f.payload);
+    return f;
+}
+
+static std::vector<uint8_t> encode(const struct rl_frame_t &f) {
+    uint8_t out[RL_ENCODED_MAX];
+    size_t n = rl_encode(&f, out);
+    return std::vector<uint8_t>(out, out + n);
+}
+
+// Plain COBS encoding of any bytes, to build frames that `rl_encode` would never make
+static std::vector<uint8_t> cobs(const std::vector<uint8_t> &raw) {
+    std::vector<uint8_t> out = { 0, 0 };
+    size_t code_at = 1;
+
+    for (uint8_t byte : raw) {
+        if (byte != 0) out.push_back(byte);
+        if (byte == 0 || out.size() - code_at == 0xff) {
+            out[code_at] = (uint8_t)(out.size() - code_at);
+            code_at = out.size();
+            out.push_back(0);
+        }
+    }
+    out[code_at] = (uint8_t)(out.size() - code_at);
+    out.push_back(0);
+    return out;
+}
+
+class RoboLinkTest : public ::testing::Test {
+protected:
+    struct rl_decoder_t dec;
+
+    void SetUp() override {
+        rl_decoder_init(&dec);
+    }
+
+    // Feed bytes and collect the return codes that are not RL_NONE
+    std::vector<int> feed(const std::vector<uint8_t> &bytes, std::vector<struct rl_frame_t> *frames = nullptr) {
+        std::vector<int> codes;
+        struct rl_frame_t out;
+
+        for (uint8_t byte : bytes) {
+            int ret = rl_decode_feed(&dec, byte, &out);
+            if (ret == RL_NONE) continue;
+            codes.push_back(ret);
+            if (ret == RL_FRAME && frames != nullptr) frames->push_back(out);
+        }
+        return codes;
+    }
+};
+
+TEST_F(RoboLinkTest, TestCaseCrcCheckValue) {
+    // Check value of CRC-16/CCITT-FALSE
+    const uint8_t check[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    ASSERT_EQ(rl_crc16(check, sizeof(check)), 0x29b1);
+}
+
+TEST_F(RoboLinkTest, TestCaseEncodingHasNoZeros) {
+    auto bytes = encode(frame(0, RL_CMD_TIME, { 0, 0, '0', 0 }));
+
+    ASSERT_EQ(bytes.front(), 0);
+    ASSERT_EQ(bytes.back(), 0);
+    for (size_t i = 1; i + 1 < bytes.size(); i++) {
+        ASSERT_NE(bytes[i], 0) << "at " << i;
+    }
+}
+
+TEST_F(RoboLinkTest, TestCaseRoundTrip) {
+    std::vector<struct rl_frame_t> frames;
+    auto sent = frame(7, RL_CMD_SEQUENCE, { 'R', '1', '0', '0', 0, 'G' });
+
+    ASSERT_EQ(feed(encode(sent), &frames), std::vector<int>{ RL_FRAME });
+    ASSERT_EQ(frames[0].id, 7);
+    ASSERT_EQ(frames[0].command, RL_CMD_SEQUENCE);
+    ASSERT_EQ(frames[0].len, 6);
+    ASSERT_EQ(memcmp(frames[0].payload, sent.payload, 6), 0);
+}
+
+TEST_F(RoboLinkTest, TestCaseRoundTripEveryLength) {
+    // Payloads of every length and of every byte value, including runs that need more than one COBS block
+    for (int len = 0; len <= RL_PAYLOAD_MAX; len++) {
+        std::vector<uint8_t> payload(len);
+        for (int i = 0; i < len; i++) payload[i] = (uint8_t)(i * 37 + len);
+
+        std::vector<struct rl_frame_t> frames;
+        ASSERT_EQ(feed(encode(frame((uint8_t)len, RL_CMD_PING, payload)), &frames), std::vector<int>{ RL_FRAME });
+        ASSERT_EQ(frames[0].len, len);
+        ASSERT_EQ(std::vector<uint8_t>(frames[0].payload, frames[0].payload + len), payload);
+    }
+}
+
+TEST_F(RoboLinkTest, TestCasePipelinedFrames) {
+    std::vector<uint8_t> stream;
+    for (uint8_t id = 0; id < 10; id++) {
+        auto bytes = encode(frame(id, RL_CMD_PING, { id }));
+        stream.insert(stream.end(), bytes.begin(), bytes.end());
+    }
+
+    std::vector<struct rl_frame_t> frames;
+    ASSERT_EQ(feed(stream, &frames).size(), 10u);
+    for (uint8_t id = 0; id < 10; id++) {
+        ASSERT_EQ(frames[id].id, id);
+        ASSERT_EQ(frames[id].payload[0], id);
+    }
+}
+
+TEST_F(RoboLinkTest, TestCaseCorruptedCrc) {
+    auto bytes = encode(frame(1, RL_CMD_TIME, { '0', '0', '1', '0', '0', '0' }));
+    bytes[5] ^= 0x04;
+
+    ASSERT_EQ(feed(bytes), std::vector<int>{ RL_ERR_CRC });
+}
+
+TEST_F(RoboLinkTest, TestCaseWrongLength) {
+    // The length byte claims one byte more than was sent, the CRC matches the lie
+    std::vector<uint8_t> raw = { 1, RL_CMD_PING, 4, 1, 2, 3 };
+    uint16_t crc = rl_crc16(raw.data(), raw.size());
+    raw.push_back((uint8_t)crc);
+    raw.push_back((uint8_t)(crc >> 8));
+
+    ASSERT_EQ(feed(cobs(raw)), std::vector<int>{ RL_ERR_LEN });
+}
+
+TEST_F(RoboLinkTest, TestCaseResynchronizes) {
+    std::vector<struct rl_frame_t> frames;
+
+    // Text printed between frames and a truncated frame only break themselves
+    std::vector<uint8_t> stream = { 'D', 'E', 'B', 'U', 'G', '\n' };
+    auto broken = encode(frame(1, RL_CMD_PING, { 1, 2, 3 }));
+    stream.insert(stream.end(), broken.begin(), broken.end() - 3);
+    auto good = encode(frame(2, RL_CMD_PING, { 4 }));
+    stream.insert(stream.end(), good.begin(), good.end());
+
+    auto codes = feed(stream, &frames);
+    ASSERT_EQ(codes.size(), 3u);
+    ASSERT_LT(codes[0], 0);
+    ASSERT_LT(codes[1], 0);
+    ASSERT_EQ(codes[2], RL_FRAME);
+    ASSERT_EQ(frames[0].id, 2);
+}
+
+TEST_F(RoboLinkTest, TestCaseOverlongFrame) {
+    std::vector<uint8_t> stream(RL_PAYLOAD_MAX + RL_OVERHEAD + 10, 0x42);
+    stream.push_back(0);
+
+    ASSERT_EQ(feed(stream), std::vector<int>{ RL_ERR_FRAME });
+    ASSERT_EQ(feed(encode(frame(3, RL_CMD_PING, {}))), std::vector<int>{ RL_FRAME });
+}
+
+TEST_F(RoboLinkTest, TestCaseResponse) {
+    struct rl_frame_t request = frame(9, RL_CMD_TIME, {});
+    struct rl_frame_t response;
+
+    rl_respond(&response, &request, RL_STATUS_ERROR, -4);
+    ASSERT_TRUE(rl_put_u32(&response, 0x01020304));
+
+    ASSERT_EQ(response.id, 9);
+    ASSERT_EQ(response.command, RL_CMD_TIME | RL_RESPONSE);
+    ASSERT_EQ(response.len, RL_RESULT_SIZE + 4);
+    ASSERT_EQ(response.payload[0], RL_STATUS_ERROR);
+    ASSERT_EQ(response.payload[1], 0xfc);
+    ASSERT_EQ(response.payload[4], 0xff);
+    ASSERT_EQ(response.payload[5], 0x04);
+    ASSERT_EQ(response.payload[8], 0x01);
+
+    while (response.len + 4 <= RL_PAYLOAD_MAX) ASSERT_TRUE(rl_put_u32(&response, 0));
+    ASSERT_FALSE(rl_put_u32(&response, 0));
+}
@@ -0,0 +1,220 @@
+#include <gtest/gtest.h>
+#include <string>
+#include "../../src/seqparser.h"
+
+// Feed a whole string to the parser and return the result of the last character
+static int feed(struct seq_parser_t *parser, const char *str, struct led_control_t *out) {
+    int ret = SEQ_MORE;
+
+    for (const char *c = str; *c != '\0'; c++) {
+        ret = seq_parser_feed(parser, *c, out);
+    }
+
+    return ret;
+}
+
+// Run a compiled sequence and list its steps as "R500 W G1000 ...", at most `max_steps` of them
+static std::string run(const struct led_control_t *ctl, int max_steps = 1000) {
+    static const char colors[] = { 'O', 'R', 'Y', 'G' };
+    struct seq_vm_t vm;
+    struct seq_step_t step;
+    std::string steps;
+
+    seq_vm_init(&vm, ctl);
+
+    for (int i = 0; i < max_steps; i++) {
+        int ret = seq_vm_run(&vm, &step);
+
+        if (ret == SEQ_VM_END) break;
+        if (!steps.empty()) steps += ' ';
+
+        if (ret == SEQ_VM_SET) {
+            steps += colors[step.color] + std::to_string(step.hold_ms);
+        } else if (ret == SEQ_VM_WAIT) {
+            steps += 'W';
+        } else {
+            steps += "error";
+            break;
+        }
+    }
+
+    return steps;
+}
+
+static std::string repeat(const std::string &steps, int times) {
+    std::string all;
+
+    for (int i = 0; i < times; i++) {
+        all += (all.empty() ? "" : " ") + steps;
+    }
+
+    return all;
+}
+
+TEST(SeqParserTest, TestCaseDefaultHoldTime) {
+    struct seq_parser_t parser;
+    struct led_control_t ctl;
+    seq_parser_init(&parser);
+
+    ASSERT_EQ(feed(&parser, "RYG\n", &ctl), SEQ_READY);
+    ASSERT_EQ(run(&ctl), "R1000 Y1000 G1000");
+    // One byte per step when the hold time does not change
+    ASSERT_EQ(ctl.len, 3);
+}
+
+TEST(SeqParserTest, TestCaseHoldTimesApplyToPrecedingColors) {
+    struct seq_parser_t parser;
+    struct led_control_t ctl;
+    seq_parser_init(&parser);
+
+    ASSERT_EQ(feed(&parser, "RYG500R200G500Y1000O\n", &ctl), SEQ_READY);
+    ASSERT_EQ(run(&ctl), "R500 Y500 G500 R200 G500 Y1000 O1000");
+
+    ASSERT_EQ(feed(&parser, "R1234G\n", &ctl), SEQ_READY);
+    ASSERT_EQ(run(&ctl), "R1234 G1000");
+}
+
+TEST(SeqParserTest, TestCaseLoop) {
+    struct seq_parser_t parser;
+    struct led_control_t ctl;
+    seq_parser_init(&parser);
+
+    ASSERT_EQ(feed(&parser, "RG250T12\r", &ctl), SEQ_READY);
+    ASSERT_EQ(run(&ctl), repeat("R250 G250", 12));
+
+    // Every round starts with the hold time of the first one
+    ASSERT_EQ(feed(&parser, "RG250YT2\r", &ctl), SEQ_READY);
+    ASSERT_EQ(run(&ctl), repeat("R250 G250 Y1000", 2));
+}
+
+TEST(SeqParserTest, TestCaseNestedGroups) {
+    struct seq_parser_t parser;
+    struct led_control_t ctl;
+    seq_parser_init(&parser);
+
+    ASSERT_EQ(feed(&parser, "R100(G200(Y300O)2)3T2\n", &ctl), SEQ_READY);
+    ASSERT_EQ(run(&ctl), repeat("R100 " + repeat("G200 " + repeat("Y300 O1000", 2), 3), 2));
+
+    // A group run once is the same as no group
+    ASSERT_EQ(feed(&parser, "(RG)1\n", &ctl), SEQ_READY);
+    ASSERT_EQ(run(&ctl), "R1000 G1000");
+}
+
+TEST(SeqParserTest, TestCaseForeverGroup) {
+    struct seq_parser_t parser;
+    struct led_control_t ctl;
+    seq_parser_init(&parser);
+
+    ASSERT_EQ(feed(&parser, "O(R500G)*\n", &ctl), SEQ_READY);
+    ASSERT_EQ(run(&ctl, 7), "O1000 " + repeat("R500 G1000", 3));
+}
+
+TEST(SeqParserTest, TestCaseWait) {
+    struct seq_parser_t parser;
+    struct led_control_t ctl;
+    seq_parser_init(&parser);
+
+    ASSERT_EQ(feed(&parser, "R200W(G300WO)2\n", &ctl), SEQ_READY);
+    ASSERT_EQ(run(&ctl), "R200 W G300 W O1000 G300 W O1000");
+}
+
+TEST(SeqParserTest, TestCaseEmptyLinesAreIgnored) {
+    struct seq_parser_t parser;
+    struct led_control_t ctl;
+    seq_parser_init(&parser);
+
+    ASSERT_EQ(feed(&parser, "\r\n\n", &ctl), SEQ_MORE);
+    // Carriage return and newline pair only produces one sequence
+    ASSERT_EQ(feed(&parser, "Y\r", &ctl), SEQ_READY);
+    ASSERT_EQ(seq_parser_feed(&parser, '\n', &ctl), SEQ_MORE);
+}
+
+TEST(SeqParserTest, TestCaseInvalidSyntaxes) {
+    struct seq_parser_t parser;
+    struct led_control_t ctl;
+    seq_parser_init(&parser);
+
+    ASSERT_EQ(feed(&parser, "RXG\n", &ctl), ERR_SEQ(FLAG_SEQ_SYNTAX));
+    ASSERT_EQ(feed(&parser, "500R\n", &ctl), ERR_SEQ(FLAG_SEQ_SYNTAX));
+    ASSERT_EQ(feed(&parser, "RT2G\n", &ctl), ERR_SEQ(FLAG_SEQ_SYNTAX));
+    ASSERT_EQ(feed(&parser, "T2\n", &ctl), ERR_SEQ(FLAG_SEQ_SYNTAX));
+    ASSERT_EQ(feed(&parser, "(R\n", &ctl), ERR_SEQ(FLAG_SEQ_SYNTAX));
+    ASSERT_EQ(feed(&parser, "R)2\n", &ctl), ERR_SEQ(FLAG_SEQ_SYNTAX));
+    ASSERT_EQ(feed(&parser, "R()2\n", &ctl), ERR_SEQ(FLAG_SEQ_SYNTAX));
+    ASSERT_EQ(feed(&parser, "RW500\n", &ctl), ERR_SEQ(FLAG_SEQ_SYNTAX));
+    ASSERT_EQ(feed(&parser, "R*\n", &ctl), ERR_SEQ(FLAG_SEQ_SYNTAX));
+    ASSERT_EQ(feed(&parser, "(R)2*\n", &ctl), ERR_SEQ(FLAG_SEQ_SYNTAX));
+    ASSERT_EQ(feed(&parser, "(R)T2\n", &ctl), ERR_SEQ(FLAG_SEQ_LOOP));
+}
+
+TEST(SeqParserTest, TestCaseInvalidLoops) {
+    struct seq_parser_t parser;
+    struct led_control_t ctl;
+    seq_parser_init(&parser);
+
+    ASSERT_EQ(feed(&parser, "RT\n", &ctl), ERR_SEQ(FLAG_SEQ_LOOP));
+    ASSERT_EQ(feed(&parser, "RT0\n", &ctl), ERR_SEQ(FLAG_SEQ_LOOP));
+    ASSERT_EQ(feed(&parser, "RT2T3\n", &ctl), ERR_SEQ(FLAG_SEQ_LOOP));
+    ASSERT_EQ(feed(&parser, "(R)\n", &ctl), ERR_SEQ(FLAG_SEQ_LOOP));
+    ASSERT_EQ(feed(&parser, "(R)0\n", &ctl), ERR_SEQ(FLAG_SEQ_LOOP));
+
+    std::string deepest = std::string(SEQ_MAX_DEPTH, '(') + "R";
+    for (int i = 0; i < SEQ_MAX_DEPTH; i++) deepest += ")2";
+
+    ASSERT_EQ(feed(&parser, (deepest + "\n").c_str(), &ctl), SEQ_READY);
+    // The group that is too deep is not opened, so its closing parenthesis does not match either
+    ASSERT_EQ(feed(&parser, ("(" + deepest + ")2\n").c_str(), &ctl), ERR_SEQ(FLAG_SEQ_LOOP | FLAG_SEQ_SYNTAX));
+}
+
+TEST(SeqParserTest, TestCaseLongSequences) {
+    struct seq_parser_t parser;
+    struct led_control_t ctl;
+    seq_parser_init(&parser);
+
+    // Far more than the 20 steps the old fixed tables held, in fewer bytes
+    std::string line;
+    std::string expected;
+    for (int i = 0; i < 20; i++) {
+        line += "RG300";
+        expected += std::string(expected.empty() ? "" : " ") + "R300 G300";
+    }
+
+    ASSERT_EQ(feed(&parser, (line + "\n").c_str(), &ctl), SEQ_READY);
+    ASSERT_EQ(run(&ctl), expected);
+    ASSERT_LE(ctl.len, 41);
+
+    std::string full(SEQ_PROGRAM_SIZE, 'R');
+    ASSERT_EQ(feed(&parser, (full + "\n").c_str(), &ctl), SEQ_READY);
+    ASSERT_EQ(ctl.len, SEQ_PROGRAM_SIZE);
+
+    ASSERT_EQ(feed(&parser, (full + "G\n").c_str(), &ctl), ERR_SEQ(FLAG_SEQ_LEN));
+    // The hold time that does not fit any more is caught too
+    ASSERT_EQ(feed(&parser, (full + "500\n").c_str(), &ctl), ERR_SEQ(FLAG_SEQ_LEN));
+}
+
+TEST(SeqParserTest, TestCaseValueOverflow) {
+    struct seq_parser_t parser;
+    struct led_control_t ctl;
+    seq_parser_init(&parser);
+
+    ASSERT_EQ(feed(&parser, "R65535\n", &ctl), SEQ_READY);
+    ASSERT_EQ(run(&ctl), "R65535");
+
+    ASSERT_EQ(feed(&parser, "R65536\n", &ctl), ERR_SEQ(FLAG_SEQ_VALUE));
+    ASSERT_EQ(feed(&parser, "R99999999999999999999\n", &ctl), ERR_SEQ(FLAG_SEQ_VALUE));
+    ASSERT_EQ(feed(&parser, "X65536\n", &ctl), ERR_SEQ(FLAG_SEQ_SYNTAX | FLAG_SEQ_VALUE));
+}
+
+TEST(SeqParserTest, TestCaseRecoversAfterError) {
+    struct seq_parser_t parser;
+    struct led_control_t ctl;
+    seq_parser_init(&parser);
+
+    ASSERT_EQ(feed(&parser, "R?Y\n", &ctl), ERR_SEQ(FLAG_SEQ_SYNTAX));
+    ASSERT_EQ(feed(&parser, "G300\n", &ctl), SEQ_READY);
+    ASSERT_EQ(run(&ctl), "G300");
+
+    ASSERT_EQ(feed(&parser, "((R\n", &ctl), ERR_SEQ(FLAG_SEQ_SYNTAX));
+    ASSERT_EQ(feed(&parser, "Y\n", &ctl), SEQ_READY);
+    ASSERT_EQ(run(&ctl), "Y1000");
+}
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include <initializer_list>
+#include "../../src/seqvm.h"
+
+static struct led_control_t program(std::initializer_list<uint8_t> code) {
+    struct led_control_t ctl = {};
+
+    for (uint8_t byte : code) ctl.code[ctl.len++] = byte;
+
+    return ctl;
+}
+
+#define SET(color) SEQ_INSN(SEQ_OP_SET, SEQ_COLOR_##color)
+
+TEST(SeqVmTest, TestCaseHoldForms) {
+    struct led_control_t ctl = program({
+        SET(RED), SEQ_INSN(SEQ_OP_HOLD, 5), SET(GREEN), SEQ_INSN(SEQ_OP_HOLD, 0), 0x39, 0x30, SET(OFF)
+    });
+    struct seq_vm_t vm;
+    struct seq_step_t step;
+    seq_vm_init(&vm, &ctl);
+
+    ASSERT_EQ(seq_vm_run(&vm, &step), SEQ_VM_SET);
+    ASSERT_EQ(step.color, SEQ_COLOR_RED);
+    ASSERT_EQ(step.hold_ms, SEQ_DEFAULT_HOLD_MS);
+
+    ASSERT_EQ(seq_vm_run(&vm, &step), SEQ_VM_SET);
+    ASSERT_EQ(step.color, SEQ_COLOR_GREEN);
+    ASSERT_EQ(step.hold_ms, 500);
+
+    ASSERT_EQ(seq_vm_run(&vm, &step), SEQ_VM_SET);
+    ASSERT_EQ(step.color, SEQ_COLOR_OFF);
+    ASSERT_EQ(step.hold_ms, 0x3039);
+
+    ASSERT_TRUE(seq_vm_done(&vm));
+    ASSERT_EQ(seq_vm_run(&vm, &step), SEQ_VM_END);
+}
+
+TEST(SeqVmTest, TestCaseLoopCounterRearms) {
+    // The inner loop runs twice on every one of the three runs of the outer loop
+    struct led_control_t ctl = program({
+        SET(RED), SET(GREEN), SEQ_INSN(SEQ_OP_LOOP, 2), 2, 0, 1, SEQ_INSN(SEQ_OP_LOOP, 1), 3, 0, 0
+    });
+    struct seq_vm_t vm;
+    struct seq_step_t step;
+    int red = 0;
+    int green = 0;
+    seq_vm_init(&vm, &ctl);
+
+    while (seq_vm_run(&vm, &step) == SEQ_VM_SET) {
+        (step.color == SEQ_COLOR_RED ? red : green)++;
+    }
+
+    ASSERT_EQ(red, 3);
+    ASSERT_EQ(green, 6);
+    ASSERT_EQ(seq_vm_run(&vm, &step), SEQ_VM_END);
+}
+
+TEST(SeqVmTest, TestCaseWait) {
+    struct led_control_t ctl = program({ SEQ_INSN(SEQ_OP_WAIT, 4), SET(YELLOW) });
+    struct seq_vm_t vm;
+    struct seq_step_t step;
+    seq_vm_init(&vm, &ctl);
+
+    ASSERT_EQ(seq_vm_run(&vm, &step), SEQ_VM_WAIT);
+    ASSERT_EQ(step.event, 4);
+    ASSERT_EQ(seq_vm_run(&vm, &step), SEQ_VM_SET);
+    ASSERT_EQ(step.color, SEQ_COLOR_YELLOW);
+}
+
+TEST(SeqVmTest, TestCaseBrokenCode) {
+    const struct led_control_t broken[] = {
+        // No such color
+        program({ SEQ_INSN(SEQ_OP_SET, 7) }),
+        // Operands cut short
+        program({ SEQ_INSN(SEQ_OP_HOLD, 0), 1 }),
+        program({ SEQ_INSN(SEQ_OP_LOOP, 0), 2, 0 }),
+        program({ SEQ_INSN(SEQ_OP_JUMP, 0) }),
+        // Loop slot and jump target out of range
+        program({ SEQ_INSN(SEQ_OP_LOOP, SEQ_LOOP_SLOTS), 2, 0, 0 }),
+        program({ SEQ_INSN(SEQ_OP_JUMP, 0), 2 }),
+        // Unknown opcode
+        program({ SEQ_INSN(7, 0) }),
+        // Never reaches a step
+        program({ SEQ_INSN(SEQ_OP_HOLD, 1), SEQ_INSN(SEQ_OP_JUMP, 0), 0 }),
+    };
+
+    for (const struct led_control_t &ctl : broken) {
+        struct seq_vm_t vm;
+        struct seq_step_t step;
+        seq_vm_init(&vm, &ctl);
+
+        ASSERT_EQ(seq_vm_run(&vm, &step), SEQ_VM_ERROR) << "at " << &ctl - broken;
+    }
+
+    struct led_control_t too_long = {};
+    too_long.len = SEQ_PROGRAM_SIZE + 1;
+    struct seq_vm_t vm;
+    struct seq_step_t step;
+    seq_vm_init(&vm, &too_long);
+
+    ASSERT_EQ(seq_vm_run(&vm, &step), SEQ_VM_ERROR);
+}
@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
-#include "../TimeParser.h"
+#include <cstring>
+#include <string>
+#include "../../src/timeparser.h"
 
 TEST(TimeParserTest, TestCaseCorrectTimes) {
     char test_str1[] = "102030";
@@ -75,5 +77,168 @@ TEST(TimeParserTest, TestCaseMultiErrorFlags) {
     ASSERT_EQ(time_parse(test_str5), ERR_TIME(FLAG_TIME_SYNTAX | FLAG_TIME_VALUE_MINUTE | FLAG_TIME_VALUE_HOUR | FLAG_TIME_VALUE_SECOND));
 }
 
+TEST(TimeParserTest, TestCaseMatchesScalarOnEveryTime) {
+    char str[8];
+
+    for (int i = 0; i < 1000000; i++) {
+        snprintf(str, sizeof(str), "%06d", i);
+        ASSERT_EQ(time_parse(str), time_parse_scalar(str)) << str;
+    }
+}
+
+TEST(TimeParserTest, TestCaseMatchesScalarOnEveryByte) {
+    // Every byte value in every position of a valid and of an out of range time, but the ones of the other formats
+    for (const char *base : { "123456", "995999" }) {
+        for (int pos = 0; pos < 6; pos++) {
+            for (int byte = 1; byte < 256; byte++) {
+                if (strchr(":@hms", byte) != NULL) continue;
+
+                std::string str = base;
+                str[pos] = (char)byte;
+                ASSERT_EQ(time_parse(str.c_str()), time_parse_scalar(str.c_str())) << pos << " " << byte;
+            }
+        }
+    }
+}
+
+TEST(TimeParserTest, TestCaseMatchesScalarOnEveryLength) {
+    std::string str;
+
+    for (int len = 0; len <= 12; len++) {
+        ASSERT_EQ(time_parse(str.c_str()), time_parse_scalar(str.c_str())) << len;
+        str += (char)('0' + len % 10);
+    }
+}
+
+TEST(TimeParserTest, TestCaseMatchesScalarOnWrongLengths) {
+    // Every byte value in every position of strings too short and too long, but the ones of the other formats
+    for (const char *base : { "9", "23", "995", "2359", "99599", "1234567", "99599999" }) {
+        for (size_t pos = 0; pos < strlen(base); pos++) {
+            for (int byte = 1; byte < 256; byte++) {
+                if (strchr(":@hms", byte) != NULL) continue;
+
+                std::string str = base;
+                str[pos] = (char)byte;
+                ASSERT_EQ(time_parse(str.c_str()), time_parse_scalar(str.c_str())) << base << " " << pos << " " << byte;
+            }
+        }
+    }
+}
+
+TEST(TimeParserTest, TestCaseClockFormats) {
+    ASSERT_EQ(time_parse("10:20:30"), 37230);
+    ASSERT_EQ(time_parse("00:05:00"), 300);
+    ASSERT_EQ(time_parse("10:20"), 37200);
+    ASSERT_EQ(time_parse("23:59:59"), 86399);
+
+    ASSERT_EQ(time_parse("24:00:00"), ERR_TIME(FLAG_TIME_VALUE_HOUR));
+    ASSERT_EQ(time_parse("00:60"), ERR_TIME(FLAG_TIME_VALUE_MINUTE));
+    ASSERT_EQ(time_parse("99:99:99"), ERR_TIME(FLAG_TIME_VALUE_HOUR | FLAG_TIME_VALUE_MINUTE | FLAG_TIME_VALUE_SECOND));
+}
+
+TEST(TimeParserTest, TestCaseDelayFormats) {
+    ASSERT_EQ(time_parse("90s"), 90);
+    ASSERT_EQ(time_parse("5m"), 300);
+    ASSERT_EQ(time_parse("1h30m"), 5400);
+    ASSERT_EQ(time_parse("1h5m3s"), 3903);
+    ASSERT_EQ(time_parse("2h15s"), 7215);
+    ASSERT_EQ(time_parse("10h30m"), 37800);
+    ASSERT_EQ(time_parse("0s"), 0);
+
+    // The first field holds the whole delay, the ones after it are at most 59
+    ASSERT_EQ(time_parse("1439m59s"), 86399);
+    ASSERT_EQ(time_parse("86399s"), 86399);
+    ASSERT_EQ(time_parse("86400s"), ERR_TIME(FLAG_TIME_VALUE_SECOND));
+    ASSERT_EQ(time_parse("1440m"), ERR_TIME(FLAG_TIME_VALUE_MINUTE));
+    ASSERT_EQ(time_parse("24h"), ERR_TIME(FLAG_TIME_VALUE_HOUR));
+    ASSERT_EQ(time_parse("1h60m"), ERR_TIME(FLAG_TIME_VALUE_MINUTE));
+    ASSERT_EQ(time_parse("90m60s"), ERR_TIME(FLAG_TIME_VALUE_SECOND));
+}
+
+TEST(TimeParserTest, TestCaseTimesOfDay) {
+    ASSERT_EQ(time_parse("@001000"), TIME_ABSOLUTE | 600);
+    ASSERT_EQ(time_parse("@10:20:30"), TIME_ABSOLUTE | 37230);
+    ASSERT_EQ(time_parse("@10:20"), TIME_ABSOLUTE | 37200);
+    ASSERT_EQ(TIME_SECONDS(time_parse("@235959")), 86399);
+
+    ASSERT_EQ(time_parse("@240000"), ERR_TIME(FLAG_TIME_VALUE_HOUR));
+    ASSERT_EQ(time_parse("@23:60"), ERR_TIME(FLAG_TIME_VALUE_MINUTE));
+}
+
+TEST(TimeParserTest, TestCaseNoFormatIsCheckedAsHHMMSS) {
+    // Units out of order, twice or after '@', and clocks with fields of one digit
+    for (const char *str : { "5m1h", "1h2h", "1s5", "@90s", "@1h", "1:30", "10:5", "10:20:3", "h", "@",
+            "1000000s", "1h100m0s" }) {
+        ASSERT_EQ(time_parse(str), time_parse_scalar(str + (str[0] == '@'))) << str;
+        ASSERT_TRUE(-time_parse(str) & FLAG_TIME_LEN) << str;
+    }
+
+    ASSERT_EQ(time_parse("1:30"), ERR_TIME(FLAG_TIME_LEN | FLAG_TIME_SYNTAX | FLAG_TIME_VALUE_HOUR));
+    ASSERT_EQ(time_parse("@90s"), ERR_TIME(FLAG_TIME_LEN | FLAG_TIME_SYNTAX | FLAG_TIME_VALUE_HOUR | FLAG_TIME_VALUE_MINUTE));
+
+    ASSERT_EQ(time_parse("12h:00"), ERR_TIME(FLAG_TIME_SYNTAX | FLAG_TIME_VALUE_MINUTE));
+    ASSERT_EQ(time_parse("@12h:00"), ERR_TIME(FLAG_TIME_SYNTAX | FLAG_TIME_VALUE_MINUTE));
+    ASSERT_EQ(time_parse("@@12000"), ERR_TIME(FLAG_TIME_SYNTAX | FLAG_TIME_VALUE_HOUR));
+    ASSERT_EQ(time_parse("10::20"), ERR_TIME(FLAG_TIME_SYNTAX | FLAG_TIME_VALUE_MINUTE));
+    ASSERT_EQ(time_parse("1m2m3m"), ERR_TIME(FLAG_TIME_SYNTAX | FLAG_TIME_VALUE_HOUR | FLAG_TIME_VALUE_MINUTE | FLAG_TIME_VALUE_SECOND));
+}
+
+static int stream(const std::string &str) {
+    struct time_stream_t ctx;
+
+    time_parse_init(&ctx);
+    for (char c : str) {
+        time_parse_feed(&ctx, c);
+    }
+    return time_parse_finish(&ctx);
+}
+
+TEST(TimeParserTest, TestCaseStreamMatchesWholeString) {
+    for (const char *str : { "102030", "000500", "--2001", "0010HH", "240000", "995959", "25-905", "xx60pp", "",
+            "60", "2001", "0010700", "-999999", "22110020" }) {
+        ASSERT_EQ(stream(str), time_parse(str)) << str;
+    }
+
+    for (const char *str : { "10:20:30", "10:20", "90s", "1h30m", "86400s", "@001000", "@10:20", "@240000", "5m1h" }) {
+        ASSERT_EQ(stream(str), time_parse(str)) << str;
+    }
+
+    for (int i = 0; i < 1000000; i += 7) {
+        char str[8];
+        snprintf(str, sizeof(str), "%06d", i);
+        ASSERT_EQ(stream(str), time_parse(str)) << str;
+    }
+
+    for (const char *base : { "123456", "995999" }) {
+        for (int pos = 0; pos < 6; pos++) {
+            for (int byte = 1; byte < 256; byte++) {
+                std::string str = base;
+                str[pos] = (char)byte;
+                ASSERT_EQ(stream(str), time_parse(str.c_str())) << pos << " " << byte;
+            }
+        }
+    }
+}
+
+TEST(TimeParserTest, TestCaseStreamOfAnyLength) {
+    // However long the input, the fields are still checked
+    ASSERT_EQ(stream(std::string(1000, '1')), ERR_TIME(FLAG_TIME_LEN));
+    ASSERT_EQ(stream(std::string(256 + 6, '0')), ERR_TIME(FLAG_TIME_LEN));
+    ASSERT_EQ(stream("0010000" + std::string(300, 'x')), ERR_TIME(FLAG_TIME_LEN | FLAG_TIME_SYNTAX));
+    ASSERT_EQ(stream("006000" + std::string(300, '0')), ERR_TIME(FLAG_TIME_LEN | FLAG_TIME_VALUE_MINUTE));
+}
+
+TEST(TimeParserTest, TestCaseStreamAnswersAtEveryPoint) {
+    struct time_stream_t ctx;
+    std::string fed;
+
+    time_parse_init(&ctx);
+    for (char c : std::string("@1h30m0010005")) {
+        time_parse_feed(&ctx, c);
+        fed += c;
+        ASSERT_EQ(time_parse_finish(&ctx), time_parse(fed.c_str())) << fed;
+    }
+}
+
 // https://google.github.io/googletest/reference/testing.html
 // https://google.github.io/googletest/reference/assertions.html
@@ -0,0 +1,141 @@
+/* Fills the alarm engine with alarms at random deadlines over a few seconds, cancels some of them and measures how late
+ * the rest go off. The alarms run a stored sequence and the dispatcher is replaced by a stub that counts them.
+ */
+
+#include <errno.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <zephyr/timing/timing.h>
+
+#include "alarm.h"
+#include "dispatcher.h"
+#include "ledctl.h"
+#include "mux.h"
+
+#define SPREAD_MS 5000
+#define FIRST_MS 100
+// Every this many alarms one is cancelled
+#define CANCEL_EVERY 8
+// One tick of rounding the deadline to the clock, and the millisecond the uptime is truncated to
+#define MAX_LATE_MS (1000 / CONFIG_SYS_CLOCK_TICKS_PER_SEC + 1)
+
+static atomic_t submitted;
+static atomic_t bad_sequences;
+static int64_t last_submit;
+static atomic_t out_of_order;
+
+int dispatcher_submit(const struct led_control_t *ledctl, enum cmd_source source, timing_t received,
+    k_timeout_t timeout)
+{
+    int64_t now = k_uptime_get();
+
+    if (ledctl->len != 1 || source != CMD_SRC_TIMER) {
+        atomic_inc(&bad_sequences);
+    }
+
+    // Alarms go off in deadline order, so the time they do never goes back
+    if (now < last_submit) {
+        atomic_inc(&out_of_order);
+    }
+    last_submit = now;
+
+    atomic_inc(&submitted);
+    return 0;
+}
+
+static void *setup(void)
+{
+    struct led_control_t seq = { .len = 1, .code = { SEQ_INSN(SEQ_OP_SET, SEQ_COLOR_RED) } };
+
+    zassert_ok(k_sem_take(&threads_ready, K_FOREVER));
+    zassert_ok(alarm_store_sequence(0, &seq));
+
+    return NULL;
+}
+
+static void before(void *fixture)
+{
+    atomic_set(&submitted, 0);
+    atomic_set(&bad_sequences, 0);
+    atomic_set(&out_of_order, 0);
+    last_submit = 0;
+    alarm_stats_reset();
+}
+
+ZTEST(alarm_accuracy, test_thousands_of_alarms)
+{
+    static int ids[CONFIG_TRAFFIC_LIGHTS_ALARMS];
+    struct alarm_stats_t stats;
+    int64_t start = k_uptime_get();
+    uint32_t seed = 0x9e3779b9u;
+    int cancelled = 0;
+
+    for (int i = 0; i < CONFIG_TRAFFIC_LIGHTS_ALARMS; i++) {
+        // xorshift32
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+
+        ids[i] = alarm_add(start + FIRST_MS + seed % SPREAD_MS, ALARM_SEQUENCE, 0);
+        zassert_true(ids[i] >= 0, "Alarm %d failed with %d", i, ids[i]);
+    }
+
+    zassert_equal(alarm_add(start + FIRST_MS, ALARM_SEQUENCE, 0), -ENOMEM);
+
+    for (int i = 0; i < CONFIG_TRAFFIC_LIGHTS_ALARMS; i += CANCEL_EVERY) {
+        zassert_ok(alarm_cancel(ids[i]));
+        zassert_equal(alarm_cancel(ids[i]), -ENOENT);
+        cancelled++;
+    }
+
+    alarm_stats_get(&stats);
+    zassert_equal(stats.pending, CONFIG_TRAFFIC_LIGHTS_ALARMS - cancelled);
+    zassert_equal(stats.dispatched, 0);
+
+    k_msleep(FIRST_MS + SPREAD_MS + 100);
+
+    alarm_stats_get(&stats);
+    TC_PRINT("%u alarms, %u late, at most %u ms and %llu ms in total\n", stats.dispatched, stats.late,
+        stats.max_late_ms, stats.total_late_ms);
+
+    zassert_equal(stats.pending, 0);
+    zassert_equal(stats.dispatched, CONFIG_TRAFFIC_LIGHTS_ALARMS - cancelled);
+    zassert_equal(atomic_get(&submitted), stats.dispatched);
+    zassert_equal(atomic_get(&bad_sequences), 0);
+    zassert_equal(atomic_get(&out_of_order), 0);
+    zassert_true(stats.max_late_ms <= MAX_LATE_MS, "An alarm went off %u ms late", stats.max_late_ms);
+}
+
+ZTEST(alarm_accuracy, test_passed_deadline_goes_off_now)
+{
+    struct alarm_stats_t stats;
+
+    zassert_true(alarm_add(k_uptime_get() - 1000, ALARM_SEQUENCE, 0) >= 0);
+    k_msleep(MAX_LATE_MS);
+
+    alarm_stats_get(&stats);
+    zassert_equal(stats.dispatched, 1);
+    zassert_equal(atomic_get(&submitted), 1);
+}
+
+ZTEST(alarm_accuracy, test_cancel_earliest_rearms_for_the_next)
+{
+    struct alarm_stats_t stats;
+    int64_t start = k_uptime_get();
+    int first = alarm_add(start + 100, ALARM_SEQUENCE, 0);
+
+    zassert_true(first >= 0);
+    zassert_true(alarm_add(start + 200, ALARM_SEQUENCE, 0) >= 0);
+    zassert_ok(alarm_cancel(first));
+
+    k_msleep(150);
+    zassert_equal(atomic_get(&submitted), 0);
+    k_msleep(50 + MAX_LATE_MS);
+
+    alarm_stats_get(&stats);
+    zassert_equal(stats.dispatched, 1);
+    zassert_true(stats.max_late_ms <= MAX_LATE_MS);
+}
+
+ZTEST_SUITE(alarm_accuracy, NULL, setup, before, NULL, NULL);
@@ -0,0 +1,71 @@
+/* Nothing in this test starts the led engine. It must come up on its own before the test runs, show red right away,
+ * time the first led from reset and run the automatic sequence. A boot that waits for main or sleeps on the way
+ * shows up as a missing or late first led.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <zephyr/timing/timing.h>
+
+#include "ledctl.h"
+#include "mux.h"
+#include "debug.h"
+
+// Time the engine gets to handle its start event
+#define SETTLE_MS 10
+// Longest acceptable time from reset to the first led, the old handshake took more than 300 ms
+#define FIRST_LED_BUDGET_US 20000
+
+static const struct gpio_dt_spec red = GPIO_DT_SPEC_GET(DT_ALIAS(led0), gpios);
+static const struct gpio_dt_spec green = GPIO_DT_SPEC_GET(DT_ALIAS(led1), gpios);
+
+static void *setup(void)
+{
+    // Given before main if the engine started, not by anything in this test
+    zassert_ok(k_sem_take(&threads_ready, K_NO_WAIT));
+    k_msleep(SETTLE_MS);
+
+    return NULL;
+}
+
+ZTEST(boot, test_1_engine_starts_itself)
+{
+    atomic_val_t word = atomic_get(&led_word);
+
+    zassert_equal(LED_WORD_GET_MODE(word), Auto);
+    zassert_equal(LED_WORD_GET_COLOR(word), Red);
+    zassert_false(LED_WORD_IS_PAUSED(word));
+
+    zassert_equal(gpio_emul_output_get(red.port, red.pin), 1);
+    zassert_equal(gpio_emul_output_get(green.port, green.pin), 0);
+}
+
+ZTEST(boot, test_2_first_led_is_timed)
+{
+    const struct timing_stat_t *first_led = &statistics.boot.first_led;
+
+    zassert_equal(first_led->count, 1, "The first led must be timed exactly once");
+
+    uint32_t reset_to_led_us = statistics.boot.reset_to_init_us +
+        (uint32_t)(timing_cycles_to_ns(first_led->max_cycles) / 1000);
+
+    TC_PRINT("First led %u us after reset\n", reset_to_led_us);
+    zassert_true(reset_to_led_us < FIRST_LED_BUDGET_US, "First led took %u us", reset_to_led_us);
+}
+
+ZTEST(boot, test_3_auto_sequence_runs)
+{
+    // The first hold time counts from the start event, this lands in the middle of yellow
+    k_msleep(ledctl_hold_ms());
+
+    zassert_equal(ledctl_color(), Yellow);
+    zassert_equal(gpio_emul_output_get(red.port, red.pin), 1);
+    zassert_equal(gpio_emul_output_get(green.port, green.pin), 1);
+
+    // Lighting yellow is not the first led any more
+    zassert_equal(statistics.boot.first_led.count, 1);
+}
+
+ZTEST_SUITE(boot, NULL, setup, NULL, NULL, NULL);
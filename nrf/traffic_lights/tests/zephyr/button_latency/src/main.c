@@ -0,0 +1,134 @@
+/* Presses the buttons through the GPIO emulator and checks that the latency from the button interrupt to the leds
+ * changing stays within a bound. The buttons are active low, so a press drives the emulated input low.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <zephyr/timing/timing.h>
+
+#include "ledctl.h"
+#include "buttons.h"
+#include "latency.h"
+#include "mux.h"
+#include "debug.h"
+
+// Presses per button
+#define PRESSES 100
+// How long a button is held down and how long to wait before the next press
+#define HOLD_MS 20
+#define RELEASE_MS 250
+// p99 from the interrupt to the leds must stay below this
+#define P99_BOUND_US 1000
+// Longest time a button interrupt may take
+#define ISR_BOUND_US 20
+
+static const struct gpio_dt_spec buttons[] = {
+    GPIO_DT_SPEC_GET(DT_ALIAS(sw0), gpios),
+    GPIO_DT_SPEC_GET(DT_ALIAS(sw1), gpios),
+    GPIO_DT_SPEC_GET(DT_ALIAS(sw2), gpios),
+    GPIO_DT_SPEC_GET(DT_ALIAS(sw3), gpios),
+    GPIO_DT_SPEC_GET(DT_ALIAS(sw4), gpios),
+};
+
+static void press(const struct gpio_dt_spec *button)
+{
+    gpio_emul_input_set(button->port, button->pin, 0);
+    k_msleep(HOLD_MS);
+    gpio_emul_input_set(button->port, button->pin, 1);
+    k_msleep(RELEASE_MS);
+}
+
+static void *setup(void)
+{
+    // Release the buttons before their interrupts are enabled, so that the pull-ups do not look like presses
+    for (int i = 0; i < ARRAY_SIZE(buttons); i++) {
+        zassert_ok(gpio_pin_configure_dt(&buttons[i], GPIO_INPUT | GPIO_PULL_UP));
+        zassert_ok(gpio_emul_input_set(buttons[i].port, buttons[i].pin, 1));
+    }
+
+    zassert_true(init_buttons());
+
+    // The engine runs the automatic sequence since boot
+    zassert_ok(k_sem_take(&threads_ready, K_FOREVER));
+
+    // The color toggles only act in manual mode
+    press(&buttons[0]);
+    zassert_true(ledctl_paused());
+
+    return NULL;
+}
+
+ZTEST(button_latency, test_color_toggle_p99)
+{
+    static const enum latency_source sources[] = { LAT_SRC_RED, LAT_SRC_YELLOW, LAT_SRC_GREEN };
+    uint64_t bound = (uint64_t)P99_BOUND_US * timing_freq_get() / 1000000;
+
+    latency_reset();
+
+    for (int i = 0; i < PRESSES; i++) {
+        for (int b = 0; b < ARRAY_SIZE(sources); b++) {
+            press(&buttons[1 + b]);
+        }
+    }
+
+    latency_print_csv();
+
+    for (int b = 0; b < ARRAY_SIZE(sources); b++) {
+        const struct latency_hist_t *hist = latency_hist(sources[b]);
+
+        zassert_equal(hist->count, PRESSES, "source %d recorded %u presses", sources[b], hist->count);
+        zassert_true(latency_percentile(sources[b], 99) <= bound, "source %d p99 %llu cycles over %llu",
+            sources[b], latency_percentile(sources[b], 99), bound);
+    }
+}
+
+// A press that bounces acts once and its bounces are counted as ripple
+ZTEST(button_latency, test_bouncing_press)
+{
+    const struct gpio_dt_spec *red = &buttons[1];
+    uint32_t pushed = statistics.btns.button_red_toggle.pushed;
+
+    latency_reset();
+
+    // Five edges down, held for longer than the debounce time, and five up. The edges are 100 us apart.
+    for (int level = 0, edge = 0; edge < 10; edge++) {
+        gpio_emul_input_set(red->port, red->pin, level);
+        level = !level;
+        k_usleep(edge == 4 ? 50 * 1000 : 100);
+    }
+    k_msleep(RELEASE_MS);
+
+    zassert_equal(latency_hist(LAT_SRC_RED)->count, 1);
+    zassert_equal(statistics.btns.button_red_toggle.pushed, pushed + 1);
+    zassert_true(statistics.btns.button_red_toggle.typical_ripple > 1);
+}
+
+// The interrupts only push the edge into a ring, so their time does not depend on what the press does
+ZTEST(button_latency, test_isr_bounded)
+{
+    const struct btn_stat_t *stats[] = {
+        &statistics.btns.button_manual_toggle,
+        &statistics.btns.button_red_toggle,
+        &statistics.btns.button_yellow_toggle,
+        &statistics.btns.button_green_toggle,
+        &statistics.btns.button_yellow_blink_toggle,
+    };
+    uint64_t bound = (uint64_t)ISR_BOUND_US * timing_freq_get() / 1000000;
+
+    // Every button twice, so that the manual button leaves the engine paused
+    for (int i = 0; i < 2 * ARRAY_SIZE(buttons); i++) {
+        press(&buttons[i % ARRAY_SIZE(buttons)]);
+    }
+
+    zassert_equal(atomic_get(&button_edges_dropped), 0);
+
+    for (int i = 0; i < ARRAY_SIZE(buttons); i++) {
+        zassert_true(stats[i]->isr.count > 0, "button %d never interrupted", i);
+        zassert_true(stats[i]->isr.max_cycles <= bound, "button %d interrupt took %u cycles, bound %llu",
+            i, stats[i]->isr.max_cycles, bound);
+    }
+}
+
+ZTEST_SUITE(button_latency, NULL, setup, NULL, NULL, NULL);
@@ -0,0 +1,161 @@
+/* Mutator threads post random events to the led engine at different priorities while checker threads load the packed
+ * led state in a tight loop. Every snapshot must be a state the engine can actually be in, and once the engine is idle
+ * the leds must show the color of the last snapshot.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <zephyr/timing/timing.h>
+
+#include "ledctl.h"
+#include "mux.h"
+
+#define MUTATORS 3
+#define CHECKERS 2
+#define POSTS_PER_MUTATOR 5000
+#define STACK_SIZE 1024
+
+static const struct gpio_dt_spec red_led = GPIO_DT_SPEC_GET(DT_ALIAS(led0), gpios);
+static const struct gpio_dt_spec green_led = GPIO_DT_SPEC_GET(DT_ALIAS(led1), gpios);
+
+K_THREAD_STACK_ARRAY_DEFINE(mutator_stacks, MUTATORS, STACK_SIZE);
+K_THREAD_STACK_ARRAY_DEFINE(checker_stacks, CHECKERS, STACK_SIZE);
+static struct k_thread mutators[MUTATORS];
+static struct k_thread checkers[CHECKERS];
+
+static atomic_t mutators_running;
+static atomic_t snapshots;
+static atomic_t violations;
+static atomic_val_t bad_word;
+
+// Events a person, the UART and the timer could send
+static const enum led_event events[] = {
+    LED_EV_MANUAL, LED_EV_PAUSE, LED_EV_RED, LED_EV_YELLOW, LED_EV_GREEN, LED_EV_OFF, LED_EV_BLINK,
+    LED_EV_BLINK_TOGGLE,
+};
+
+static const enum cmd_source sources[MUTATORS] = { CMD_SRC_BUTTON, CMD_SRC_UART, CMD_SRC_TIMER };
+
+static bool valid(atomic_val_t word)
+{
+    enum State mode = LED_WORD_GET_MODE(word);
+    enum Color color = LED_WORD_GET_COLOR(word);
+
+    if (word & ~(LED_WORD_MODE_MASK | LED_WORD_COLOR_MASK | LED_WORD_SAVED_MASK | LED_WORD_PAUSED)) {
+        return false;
+    }
+
+    // Paused exactly when not running the automatic sequence
+    if (LED_WORD_IS_PAUSED(word) != (mode != Auto)) {
+        return false;
+    }
+
+    // The automatic sequence only saves colors it shows
+    if (LED_WORD_GET_SAVED(word) == Off) {
+        return false;
+    }
+
+    switch (mode) {
+        case Auto:
+            return color != Off;
+        case Manual:
+            return true;
+        case Blink:
+            return color == Yellow || color == Off;
+        default:
+            return false;
+    }
+}
+
+static void mutator(void *p1, void *p2, void *p3)
+{
+    enum cmd_source source = (enum cmd_source)(uintptr_t)p1;
+    uint32_t seed = 0x9e3779b9u * (source + 1);
+
+    for (int i = 0; i < POSTS_PER_MUTATOR; i++) {
+        // xorshift32
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+
+        ledctl_post(events[seed % ARRAY_SIZE(events)], source, NULL);
+
+        if (seed & 0x100) {
+            k_yield();
+        } else {
+            k_usleep(seed % 200);
+        }
+    }
+
+    atomic_dec(&mutators_running);
+}
+
+static void checker(void *p1, void *p2, void *p3)
+{
+    while (atomic_get(&mutators_running) > 0) {
+        atomic_val_t word = atomic_get(&led_word);
+
+        if (!valid(word)) {
+            atomic_inc(&violations);
+            bad_word = word;
+        }
+
+        atomic_inc(&snapshots);
+        k_yield();
+    }
+}
+
+static void *setup(void)
+{
+    // The engine runs the automatic sequence since boot
+    zassert_ok(k_sem_take(&threads_ready, K_FOREVER));
+
+    return NULL;
+}
+
+ZTEST(led_state_stress, test_concurrent_mutators)
+{
+    atomic_set(&mutators_running, MUTATORS);
+
+    for (int i = 0; i < CHECKERS; i++) {
+        k_thread_create(&checkers[i], checker_stacks[i], STACK_SIZE, checker, NULL, NULL, NULL,
+            K_PRIO_PREEMPT(5 + i), 0, K_NO_WAIT);
+    }
+
+    for (int i = 0; i < MUTATORS; i++) {
+        k_thread_create(&mutators[i], mutator_stacks[i], STACK_SIZE, mutator, (void *)(uintptr_t)sources[i], NULL,
+            NULL, K_PRIO_PREEMPT(3 + i), 0, K_NO_WAIT);
+    }
+
+    for (int i = 0; i < MUTATORS; i++) {
+        k_thread_join(&mutators[i], K_FOREVER);
+    }
+    for (int i = 0; i < CHECKERS; i++) {
+        k_thread_join(&checkers[i], K_FOREVER);
+    }
+
+    zassert_equal(atomic_get(&violations), 0, "%ld invalid snapshots, last 0x%lx", atomic_get(&violations),
+        bad_word);
+    zassert_true(atomic_get(&snapshots) > 0);
+
+    /*
+        Stop blinking and the automatic sequence so that the leds stay put, then compare them with the state. The pause
+        goes in at the lowest priority, so every command the mutators left in the bus has been handled before it.
+    */
+    struct k_sem done;
+    k_sem_init(&done, 0, 1);
+    ledctl_post(LED_EV_PAUSE, CMD_SRC_DISPATCHER, &done);
+    zassert_ok(k_sem_take(&done, K_SECONDS(1)));
+    ledctl_post(LED_EV_OFF, CMD_SRC_SYSTEM, &done);
+    zassert_ok(k_sem_take(&done, K_SECONDS(1)));
+
+    atomic_val_t word = atomic_get(&led_word);
+    zassert_true(valid(word));
+    zassert_equal(LED_WORD_GET_COLOR(word), Off);
+    zassert_equal(gpio_emul_output_get(red_led.port, red_led.pin), 0);
+    zassert_equal(gpio_emul_output_get(green_led.port, green_led.pin), 0);
+}
+
+ZTEST_SUITE(led_state_stress, NULL, setup, NULL, NULL, NULL);
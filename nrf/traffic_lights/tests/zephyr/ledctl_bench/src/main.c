@@ -0,0 +1,108 @@
+/* Context switches and latency per led transition. The same manual toggle workload is run through a replica of the
+ * old three thread design, where every color had its own thread waiting on a condition variable under one mutex, and
+ * through the led engine. Run with `west build -b native_sim -t run`.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/timing/timing.h>
+#include <zephyr/tracing/tracing.h>
+
+#include "ledctl.h"
+#include "mux.h"
+
+#define TRANSITIONS 1000
+#define LEGACY_PRIORITY 2
+
+static atomic_t switches = ATOMIC_INIT(0);
+
+// Called by the tracing subsystem every time a thread is switched in
+void sys_trace_thread_switched_in_user(void)
+{
+    atomic_inc(&switches);
+}
+
+/*
+    Replica of the old design: one thread per color, all waiting for their own condition variable under `lmux`.
+*/
+K_MUTEX_DEFINE(lmux);
+K_CONDVAR_DEFINE(rsig);
+K_CONDVAR_DEFINE(gsig);
+K_CONDVAR_DEFINE(sig_ok);
+K_SEM_DEFINE(legacy_ready, 0, 2);
+
+static void legacy_color(void *sig, void *, void *)
+{
+    k_sem_give(&legacy_ready);
+
+    while (1) {
+        k_mutex_lock(&lmux, K_FOREVER);
+        if (k_condvar_wait(sig, &lmux, K_FOREVER) == 0) {
+            k_condvar_signal(&sig_ok);
+        }
+        k_mutex_unlock(&lmux);
+        k_yield();
+    }
+}
+
+K_THREAD_DEFINE(legacy_red, 512, legacy_color, &rsig, NULL, NULL, LEGACY_PRIORITY, 0, 0);
+K_THREAD_DEFINE(legacy_green, 512, legacy_color, &gsig, NULL, NULL, LEGACY_PRIORITY, 0, 0);
+
+static void report(const char *name, uint64_t cycles, atomic_val_t switched)
+{
+    printk("%s: %d transitions, %d.%02d context switches and %llu ns per transition\n", name, TRANSITIONS,
+        (int)(switched / TRANSITIONS), (int)(switched * 100 / TRANSITIONS % 100),
+        timing_cycles_to_ns(cycles) / TRANSITIONS);
+}
+
+static void bench_legacy(void)
+{
+    k_sem_take(&legacy_ready, K_FOREVER);
+    k_sem_take(&legacy_ready, K_FOREVER);
+    k_msleep(10);
+
+    atomic_clear(&switches);
+    timing_t start = timing_counter_get();
+
+    for (int i = 0; i < TRANSITIONS; i++) {
+        k_mutex_lock(&lmux, K_FOREVER);
+        k_condvar_signal((i & 1) ? &gsig : &rsig);
+        k_condvar_wait(&sig_ok, &lmux, K_FOREVER);
+        k_mutex_unlock(&lmux);
+    }
+
+    report("three threads", timing_counter_get() - start, atomic_get(&switches));
+}
+
+static void bench_engine(void)
+{
+    struct k_sem done;
+
+    k_sem_init(&done, 0, 1);
+    // The engine has started the automatic sequence on its own, get it to manual mode where every color event is a
+    // transition
+    ledctl_post(LED_EV_PAUSE, CMD_SRC_SYSTEM, &done);
+    k_sem_take(&done, K_FOREVER);
+
+    atomic_clear(&switches);
+    timing_t start = timing_counter_get();
+
+    for (int i = 0; i < TRANSITIONS; i++) {
+        ledctl_post((i & 1) ? LED_EV_GREEN : LED_EV_RED, CMD_SRC_SYSTEM, &done);
+        k_sem_take(&done, K_FOREVER);
+    }
+
+    report("led engine", timing_counter_get() - start, atomic_get(&switches));
+}
+
+int main(void)
+{
+    if (k_sem_take(&threads_ready, K_NO_WAIT) != 0) {
+        printk("Failed to initialize leds\n");
+        return 0;
+    }
+
+    bench_legacy();
+    bench_engine();
+
+    return 0;
+}
@@ -0,0 +1,129 @@
+/* Stores the configuration in the simulated flash and restores it like a reboot would. A stored record must bring back
+ * the hold time, the debug flag and the boot sequence, a record with a broken CRC must leave the defaults in place and
+ * every restore must be timed in the boot statistics.
+ */
+
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/timing/timing.h>
+
+#include "ledctl.h"
+#include "persist.h"
+#include "seqvm.h"
+#include "debug.h"
+
+// Large enough for the stored record
+#define RECORD_MAX 128
+
+static const struct led_control_t sequence = {
+    .len = 4,
+    .code = { SEQ_INSN(SEQ_OP_SET, SEQ_COLOR_GREEN), SEQ_INSN(SEQ_OP_HOLD, 5),
+              SEQ_INSN(SEQ_OP_SET, SEQ_COLOR_RED), SEQ_INSN(SEQ_OP_HOLD, 5) },
+};
+
+struct raw_record_t {
+    uint8_t data[RECORD_MAX];
+    size_t len;
+};
+
+static int read_raw(const char *key, size_t len, settings_read_cb read_cb, void *cb_arg, void *param)
+{
+    struct raw_record_t *raw = param;
+
+    if (key == NULL || strcmp(key, "cfg") != 0 || len > sizeof(raw->data)) {
+        return 0;
+    }
+
+    raw->len = read_cb(cb_arg, raw->data, len);
+    return 0;
+}
+
+// Put the defaults back, as a fresh boot would have them
+static void reset_defaults(void)
+{
+    ledctl_set_hold_ms(LED_HOLD_TIME_MS);
+    print_debug_messages = false;
+}
+
+static void before(void *fixture)
+{
+    persist_forget();
+    reset_defaults();
+}
+
+ZTEST(persist, test_round_trip)
+{
+    ledctl_set_hold_ms(2500);
+    print_debug_messages = true;
+    persist_set_sequence(&sequence);
+    zassert_ok(persist_save());
+
+    reset_defaults();
+    zassert_true(persist_restore());
+
+    zassert_equal(ledctl_hold_ms(), 2500);
+    zassert_true(persist_debug_messages(false));
+
+    const struct led_control_t *boot = persist_boot_sequence();
+
+    zassert_not_null(boot);
+    zassert_equal(boot->len, sequence.len);
+    zassert_mem_equal(boot->code, sequence.code, sequence.len);
+}
+
+ZTEST(persist, test_forget_restores_defaults)
+{
+    ledctl_set_hold_ms(700);
+    persist_set_sequence(&sequence);
+    zassert_ok(persist_save());
+    zassert_ok(persist_forget());
+
+    reset_defaults();
+    zassert_true(persist_restore());
+
+    zassert_equal(ledctl_hold_ms(), LED_HOLD_TIME_MS);
+    zassert_false(persist_debug_messages(false));
+    zassert_is_null(persist_boot_sequence());
+}
+
+ZTEST(persist, test_corrupted_record_is_ignored)
+{
+    struct raw_record_t raw = { 0 };
+
+    ledctl_set_hold_ms(3000);
+    persist_set_sequence(&sequence);
+    zassert_ok(persist_save());
+
+    // Flip one bit of the hold time, the CRC no longer matches
+    zassert_ok(settings_load_subtree_direct("tl", read_raw, &raw));
+    zassert_true(raw.len > 4);
+    raw.data[2] ^= 0x01;
+    zassert_ok(settings_save_one("tl/cfg", raw.data, raw.len));
+
+    reset_defaults();
+    zassert_true(persist_restore());
+
+    zassert_equal(ledctl_hold_ms(), LED_HOLD_TIME_MS);
+    zassert_is_null(persist_boot_sequence());
+}
+
+ZTEST(persist, test_restore_is_timed)
+{
+    uint32_t count = statistics.boot.restore.count;
+
+    // The restore at boot has been recorded too
+    zassert_true(count >= 1);
+
+    zassert_true(persist_restore());
+    zassert_equal(statistics.boot.restore.count, count + 1);
+    zassert_true(statistics.boot.restore.max_cycles >= statistics.boot.restore.min_cycles);
+
+    uint32_t restore_us = (uint32_t)(timing_cycles_to_ns(statistics.boot.restore.max_cycles) / 1000);
+
+    TC_PRINT("Restore took at most %u us\n", restore_us);
+}
+
+ZTEST_SUITE(persist, NULL, NULL, before, NULL, NULL);
@@ -0,0 +1,130 @@
+/* Runs the led engine on the three heads of topology.overlay and reads every head back through the GPIO emulator. The
+ * automatic sequence must hand green from phase to phase without ever letting north and east go together, manual
+ * colors must only show on the active phase and blinking must show on every head.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <zephyr/timing/timing.h>
+
+#include "ledctl.h"
+#include "topology.h"
+#include "mux.h"
+
+// How often the heads are sampled and how many hold times the automatic sequence is watched for
+#define SAMPLE_MS 50
+#define WATCHED_HOLDS 12
+
+struct head_t {
+    struct gpio_dt_spec red;
+    struct gpio_dt_spec green;
+    uint32_t phases;
+};
+
+#define HEAD(label, ph) { \
+        .red = GPIO_DT_SPEC_GET(DT_NODELABEL(label), red_gpios), \
+        .green = GPIO_DT_SPEC_GET(DT_NODELABEL(label), green_gpios), \
+        .phases = (ph), \
+    }
+
+static const struct head_t heads[] = {
+    HEAD(north, BIT(0)),
+    HEAD(east, BIT(1)),
+    HEAD(turn, BIT(0) | BIT(1)),
+};
+
+BUILD_ASSERT(ARRAY_SIZE(heads) == TOPOLOGY_HEADS);
+BUILD_ASSERT(TOPOLOGY_PHASES == 2);
+
+static enum Color head_color(const struct head_t *head)
+{
+    bool red = gpio_emul_output_get(head->red.port, head->red.pin) > 0;
+    bool green = gpio_emul_output_get(head->green.port, head->green.pin) > 0;
+
+    return red && green ? Yellow : red ? Red : green ? Green : Off;
+}
+
+static bool going(const struct head_t *head)
+{
+    enum Color color = head_color(head);
+
+    return color == Yellow || color == Green;
+}
+
+static void post(enum led_event event)
+{
+    struct k_sem done;
+
+    k_sem_init(&done, 0, 1);
+    zassert_ok(ledctl_post(event, CMD_SRC_SYSTEM, &done));
+    zassert_ok(k_sem_take(&done, K_SECONDS(1)));
+}
+
+static void *setup(void)
+{
+    // The engine runs the automatic sequence since boot
+    zassert_ok(k_sem_take(&threads_ready, K_FOREVER));
+
+    return NULL;
+}
+
+ZTEST(topology, test_auto_hands_over_phases)
+{
+    uint32_t green_seen = 0;
+
+    // Pause and resume to start from a known state whatever the other tests left behind
+    post(LED_EV_PAUSE);
+    post(LED_EV_MANUAL);
+    zassert_false(ledctl_paused());
+
+    for (int t = 0; t < WATCHED_HOLDS * LED_HOLD_TIME_MS; t += SAMPLE_MS) {
+        zassert_false(going(&heads[0]) && going(&heads[1]), "North and east going together at %d ms", t);
+
+        for (int i = 0; i < ARRAY_SIZE(heads); i++) {
+            if (head_color(&heads[i]) == Green) {
+                green_seen |= BIT(i);
+            }
+        }
+
+        k_msleep(SAMPLE_MS);
+    }
+
+    zassert_equal(green_seen, BIT_MASK(ARRAY_SIZE(heads)), "Only heads 0x%x turned green", green_seen);
+    zassert_equal(atomic_get(&topology_conflicts), 0);
+}
+
+ZTEST(topology, test_manual_color_on_active_phase)
+{
+    post(LED_EV_PAUSE);
+    post(LED_EV_OFF);
+    post(LED_EV_GREEN);
+
+    uint32_t phase = BIT(topology_phase());
+
+    for (int i = 0; i < ARRAY_SIZE(heads); i++) {
+        enum Color expected = heads[i].phases & phase ? Green : Red;
+
+        zassert_equal(head_color(&heads[i]), expected, "Head %d shows %d", i, head_color(&heads[i]));
+    }
+
+    post(LED_EV_OFF);
+
+    for (int i = 0; i < ARRAY_SIZE(heads); i++) {
+        zassert_equal(head_color(&heads[i]), Off, "Head %d is not off", i);
+    }
+}
+
+ZTEST(topology, test_blink_on_every_head)
+{
+    post(LED_EV_BLINK);
+
+    for (int i = 0; i < ARRAY_SIZE(heads); i++) {
+        zassert_equal(head_color(&heads[i]), Yellow, "Head %d is not blinking", i);
+    }
+
+    post(LED_EV_PAUSE);
+}
+
+ZTEST_SUITE(topology, NULL, setup, NULL, NULL, NULL);